@@ -152,6 +152,9 @@ case "$1" in
             verifyjoinsplit)
                 zcash_rpc zcbenchmark verifyjoinsplit 1000 "\"$RAWJOINSPLIT\""
                 ;;
+            verifyblockjoinsplits)
+                zcash_rpc_slow zcbenchmark verifyblockjoinsplits 1 "${@:3}"
+                ;;
             solveequihash)
                 zcash_rpc_slow zcbenchmark solveequihash 50 "${@:3}"
                 ;;
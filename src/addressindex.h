@@ -0,0 +1,150 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ADDRESSINDEX_H
+#define BITCOIN_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+/** Kinds of addresses outputs are indexed by */
+enum AddressIndexType {
+    ADDRESS_INDEX_NONE = 0,
+    ADDRESS_INDEX_PUBKEYHASH = 1,
+    ADDRESS_INDEX_SCRIPTHASH = 2,
+};
+
+/**
+ * Key of a change to the balance of an address: an output paying it, or an input spending one of
+ * its outputs. Heights and positions are stored big-endian, so that the changes to an address are
+ * sorted by the order they happened in the chain.
+ */
+struct CAddressIndexKey
+{
+    uint8_t addressType;
+    uint160 addressHash;
+    int nHeight;
+    //! position of the transaction in the block, certificates coming after transactions
+    unsigned int nTxIndex;
+    uint256 txid;
+    //! index of the input if fSpending, of the output otherwise
+    unsigned int n;
+    bool fSpending;
+
+    CAddressIndexKey(): addressType(ADDRESS_INDEX_NONE), nHeight(0), nTxIndex(0), n(0), fSpending(false) {}
+    CAddressIndexKey(uint8_t addressTypeIn, const uint160& addressHashIn, int nHeightIn, unsigned int nTxIndexIn,
+                     const uint256& txidIn, unsigned int nIn, bool fSpendingIn):
+        addressType(addressTypeIn), addressHash(addressHashIn), nHeight(nHeightIn), nTxIndex(nTxIndexIn),
+        txid(txidIn), n(nIn), fSpending(fSpendingIn) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 66;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata8(s, addressType);
+        addressHash.Serialize(s, nType, nVersion);
+        ser_writedata32be(s, nHeight);
+        ser_writedata32be(s, nTxIndex);
+        txid.Serialize(s, nType, nVersion);
+        ser_writedata32(s, n);
+        ser_writedata8(s, fSpending);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        addressType = ser_readdata8(s);
+        addressHash.Unserialize(s, nType, nVersion);
+        nHeight = ser_readdata32be(s);
+        nTxIndex = ser_readdata32be(s);
+        txid.Unserialize(s, nType, nVersion);
+        n = ser_readdata32(s);
+        fSpending = ser_readdata8(s);
+    }
+};
+
+/** Prefix of the keys of the changes to an address, optionally from a given height on */
+struct CAddressIndexIteratorKey
+{
+    uint8_t addressType;
+    uint160 addressHash;
+    int nHeight;
+    bool fHeight;
+
+    CAddressIndexIteratorKey(uint8_t addressTypeIn, const uint160& addressHashIn):
+        addressType(addressTypeIn), addressHash(addressHashIn), nHeight(0), fHeight(false) {}
+    CAddressIndexIteratorKey(uint8_t addressTypeIn, const uint160& addressHashIn, int nHeightIn):
+        addressType(addressTypeIn), addressHash(addressHashIn), nHeight(nHeightIn), fHeight(true) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return fHeight ? 25 : 21;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata8(s, addressType);
+        addressHash.Serialize(s, nType, nVersion);
+        if (fHeight)
+            ser_writedata32be(s, nHeight);
+    }
+};
+
+/** Key of an unspent output paying an address */
+struct CAddressUnspentKey
+{
+    uint8_t addressType;
+    uint160 addressHash;
+    uint256 txid;
+    unsigned int n;
+
+    CAddressUnspentKey(): addressType(ADDRESS_INDEX_NONE), n(0) {}
+    CAddressUnspentKey(uint8_t addressTypeIn, const uint160& addressHashIn, const uint256& txidIn, unsigned int nIn):
+        addressType(addressTypeIn), addressHash(addressHashIn), txid(txidIn), n(nIn) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 57;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata8(s, addressType);
+        addressHash.Serialize(s, nType, nVersion);
+        txid.Serialize(s, nType, nVersion);
+        ser_writedata32(s, n);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        addressType = ser_readdata8(s);
+        addressHash.Unserialize(s, nType, nVersion);
+        txid.Unserialize(s, nType, nVersion);
+        n = ser_readdata32(s);
+    }
+};
+
+/** An unspent output paying an address; a null value erases its key from the index */
+struct CAddressUnspentValue
+{
+    CAmount nValue;
+    CScript script;
+    int nHeight;
+    //! for backward transfers of certificates, the height they can be spent from; 0 otherwise
+    int nBwtMaturityHeight;
+
+    CAddressUnspentValue(): nValue(-1), nHeight(0), nBwtMaturityHeight(0) {}
+    CAddressUnspentValue(CAmount nValueIn, const CScript& scriptIn, int nHeightIn, int nBwtMaturityHeightIn):
+        nValue(nValueIn), script(scriptIn), nHeight(nHeightIn), nBwtMaturityHeight(nBwtMaturityHeightIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nValue);
+        READWRITE(script);
+        READWRITE(nHeight);
+        READWRITE(nBwtMaturityHeight);
+    }
+
+    bool IsNull() const { return nValue == -1; }
+};
+
+#endif // BITCOIN_ADDRESSINDEX_H
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amqppublishnotifier.h"
+#include "blockcache.h"
 #include "main.h"
 #include "util.h"
 
@@ -154,14 +155,13 @@ bool AMQPPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex)) {
+        std::shared_ptr<const CBlock> pblock = GetCachedBlock(pindex);
+        if(!pblock) {
             LogPrint("amqp", "amqp: Can't read block from disk");
             return false;
         }
 
-        ss << block;
+        ss << *pblock;
     }
 
     return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
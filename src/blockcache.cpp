@@ -0,0 +1,129 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "core_memusage.h"
+#include "main.h"
+#include "util.h"
+
+#include <list>
+#include <map>
+
+#include <boost/thread.hpp>
+
+size_t nBlockCacheUsage = (size_t) DEFAULT_MAX_BLOCK_CACHE_SIZE << 20;
+
+namespace {
+
+/** Blocks by hash, evicted in least recently used order once their memory usage exceeds the limit */
+class CBlockCache
+{
+private:
+    typedef std::list<std::pair<uint256, std::shared_ptr<const CBlock> > > BlockList;
+
+    //! most recently used first
+    BlockList listBlocks;
+    std::map<uint256, BlockList::iterator> mapBlocks;
+    //! memory used by the blocks of listBlocks
+    size_t nUsage;
+    boost::mutex cs_blockcache;
+
+    static size_t Usage(const CBlock& block)
+    {
+        return sizeof(CBlock) + RecursiveDynamicUsage(block);
+    }
+
+public:
+    CBlockCache(): nUsage(0) {}
+
+    std::shared_ptr<const CBlock> Get(const uint256& hash)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_blockcache);
+        std::map<uint256, BlockList::iterator>::iterator it = mapBlocks.find(hash);
+        if (it == mapBlocks.end())
+            return std::shared_ptr<const CBlock>();
+        listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+        return it->second->second;
+    }
+
+    void Set(const std::shared_ptr<const CBlock>& pblock)
+    {
+        const size_t nMaxUsage = nBlockCacheUsage;
+        const size_t nBlockUsage = Usage(*pblock);
+        if (nBlockUsage > nMaxUsage)
+            return;
+        const uint256 hash = pblock->GetHash();
+
+        boost::unique_lock<boost::mutex> lock(cs_blockcache);
+        if (mapBlocks.count(hash))
+            return;
+        while (!listBlocks.empty() && nUsage + nBlockUsage > nMaxUsage) {
+            nUsage -= Usage(*listBlocks.back().second);
+            mapBlocks.erase(listBlocks.back().first);
+            listBlocks.pop_back();
+        }
+        listBlocks.push_front(std::make_pair(hash, pblock));
+        mapBlocks[hash] = listBlocks.begin();
+        nUsage += nBlockUsage;
+    }
+};
+
+CBlockCache& GetBlockCache()
+{
+    static CBlockCache blockCache;
+    return blockCache;
+}
+
+}
+
+std::shared_ptr<const CBlock> GetCachedBlock(const uint256& hash, const CDiskBlockPos& pos, bool fCache)
+{
+    std::shared_ptr<const CBlock> pblock = GetBlockCache().Get(hash);
+    if (pblock)
+        return pblock;
+
+    std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+    if (!ReadBlockFromDisk(*pblockRead, pos))
+        return std::shared_ptr<const CBlock>();
+    if (pblockRead->GetHash() != hash) {
+        error("%s: GetHash() doesn't match index for %s at %s", __func__, hash.ToString(), pos.ToString());
+        return std::shared_ptr<const CBlock>();
+    }
+    if (fCache)
+        GetBlockCache().Set(pblockRead);
+    return pblockRead;
+}
+
+std::shared_ptr<const CBlock> GetCachedBlock(const CBlockIndex* pindex, bool fCache)
+{
+    std::shared_ptr<const CBlock> pblock = GetBlockCache().Get(pindex->GetBlockHash());
+    if (pblock)
+        return pblock;
+
+    // the position of a block never changes once it has been stored, only copying it needs cs_main
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        pos = pindex->GetBlockPos();
+    }
+    return GetCachedBlock(pindex->GetBlockHash(), pos, fCache);
+}
+
+void CacheBlock(const CBlock& block)
+{
+    if (nBlockCacheUsage > 0)
+        GetBlockCache().Set(std::make_shared<const CBlock>(block));
+}
+
+std::shared_ptr<const CBlock> GetBlockToConnect(const CBlockIndex* pindex)
+{
+    return GetCachedBlock(pindex, !IsInitialBlockDownload());
+}
+
+void CacheConnectedBlock(const CBlock& block)
+{
+    if (!IsInitialBlockDownload())
+        CacheBlock(block);
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCACHE_H
+#define BITCOIN_BLOCKCACHE_H
+
+#include <memory>
+
+class CBlock;
+class CBlockIndex;
+struct CDiskBlockPos;
+class uint256;
+
+/** Default for -maxblockcachesize, the memory (in MiB) the recently used blocks cache can use */
+static const unsigned int DEFAULT_MAX_BLOCK_CACHE_SIZE = 32;
+
+/** Memory (in bytes) the recently used blocks cache can use, 0 to disable it; set from -maxblockcachesize at init */
+extern size_t nBlockCacheUsage;
+
+/**
+ * Cache of the most recently used deserialized blocks, so that the RPC, REST, websocket, ZMQ and
+ * AMQP handlers fetching the same blocks (usually the new tip) only read them from disk once.
+ * Blocks are shared, and never modified once cached.
+ */
+
+/**
+ * Returns the block of pindex from the cache, or else reads it from disk, caching it unless fCache
+ * is false (for callers scanning many blocks once); NULL if it cannot be read.
+ */
+std::shared_ptr<const CBlock> GetCachedBlock(const CBlockIndex* pindex, bool fCache = true);
+/** As above, for a block whose position on disk was copied beforehand */
+std::shared_ptr<const CBlock> GetCachedBlock(const uint256& hash, const CDiskBlockPos& pos, bool fCache = true);
+
+/** Records a copy of a block which was just connected, if the cache is enabled */
+void CacheBlock(const CBlock& block);
+
+/**
+ * As GetCachedBlock and CacheBlock, for the blocks connected to the tip: they are only cached once
+ * the initial block download is over, as nothing fetches them again while catching up.
+ */
+std::shared_ptr<const CBlock> GetBlockToConnect(const CBlockIndex* pindex);
+void CacheConnectedBlock(const CBlock& block);
+
+#endif // BITCOIN_BLOCKCACHE_H
@@ -6,6 +6,10 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include <boost/foreach.hpp>
@@ -16,6 +20,77 @@
 template <typename T>
 class CCheckQueueControl;
 
+/** What the worker threads shared by several check queues need from each of them */
+class CCheckQueueBase
+{
+public:
+    virtual ~CCheckQueueBase() {}
+
+    //! Give a new worker a deque of its own, returning its slot
+    virtual unsigned int RegisterWorker() = 0;
+
+    //! Run one batch of verifications as the worker of nSlot; return false if there was none
+    virtual bool Work(unsigned int nSlot) = 0;
+
+    virtual bool HasWork() const = 0;
+};
+
+/**
+ * Worker threads shared by several check queues, so that the verifications of different kinds
+ * queued at the same time (scripts and proofs of a block) run on a single set of threads instead
+ * of competing with one another: a worker takes a batch from every queue in turn, and sleeps when
+ * none of them has any.
+ */
+class CCheckQueueWorkers
+{
+private:
+    template <typename T>
+    friend class CCheckQueue;
+
+    //! Mutex used to sleep and wake up, shared with the queues
+    boost::mutex mutex;
+
+    //! Worker threads block on this when out of work
+    boost::condition_variable condWorker;
+
+    //! The number of workers sleeping on condWorker
+    int nIdle;
+
+    std::vector<CCheckQueueBase*> vQueues;
+
+    bool HasWork() const
+    {
+        for (const CCheckQueueBase* pqueue : vQueues)
+            if (pqueue->HasWork())
+                return true;
+        return false;
+    }
+
+public:
+    CCheckQueueWorkers() : nIdle(0) {}
+
+    //! Worker thread, to be started once all the queues are created
+    void Thread()
+    {
+        std::vector<unsigned int> vSlots;
+        for (CCheckQueueBase* pqueue : vQueues)
+            vSlots.push_back(pqueue->RegisterWorker());
+        while (true) {
+            bool fWorked = false;
+            for (size_t i = 0; i < vQueues.size(); i++)
+                fWorked = vQueues[i]->Work(vSlots[i]) || fWorked;
+            if (fWorked)
+                continue;
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!HasWork()) {
+                nIdle++;
+                condWorker.wait(lock);
+                nIdle--;
+            }
+        }
+    }
+};
+
 /** 
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -25,12 +100,42 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * The verifications are spread over one deque per worker, each with its own
+  * lock, so that workers do not contend on a single lock: a worker takes
+  * batches from the back of its own deque and, once that is empty, steals
+  * half of another deque from its front. A single mutex is only taken to
+  * sleep and to wake up, when there is nothing left to take.
+  *
+  * The workers are either threads of its own, or shared with other queues (see CCheckQueueWorkers).
   */
 template <typename T>
-class CCheckQueue
+class CCheckQueue : public CCheckQueueBase
 {
 private:
-    //! Mutex to protect the inner state
+    //! The verifications queued for one worker, which the other workers can steal
+    struct Slot
+    {
+        boost::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    //! Workers beyond this number share the deques of the others
+    enum : unsigned int { MAX_SLOTS = 64 };
+
+    //! Slot 0 belongs to the master, the others to the workers in the order they start
+    std::unique_ptr<Slot> slots[MAX_SLOTS];
+
+    //! The number of slots in use
+    std::atomic<unsigned int> nSlots;
+
+    //! The number of worker threads started, the master excluded
+    unsigned int nWorkers;
+
+    //! Slot the master queues the next verifications to
+    unsigned int nNextSlot;
+
+    //! Mutex used to sleep and wake up
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,103 +144,157 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
-
-    //! The number of workers (including the master) that are idle.
+    //! The number of workers (the master excluded) sleeping on condWorker
     int nIdle;
 
-    //! The total number of workers (including the master).
-    int nTotal;
-
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
-    //! Whether we're shutting down.
-    bool fQuit;
+    //! Number of verifications still in the deques (transiently negative while they are being added)
+    std::atomic<int> nQueued;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! The workers shared with other queues, if any
+    CCheckQueueWorkers* pworkers;
+
+    boost::mutex& Mutex() { return pworkers ? pworkers->mutex : mutex; }
+
+    //! Run a batch of verifications, unless some verification already failed
+    void Run(std::vector<T>& vChecks, bool fMaster)
+    {
+        unsigned int nNow = vChecks.size();
+        bool fOk = fAllOk;
+        BOOST_FOREACH (T& check, vChecks)
+            if (fOk)
+                fOk = check();
+        vChecks.clear();
+        if (!fOk)
+            fAllOk = false;
+        if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+            // We processed the last element; inform the master it can exit and return the result
+            boost::unique_lock<boost::mutex> lock(Mutex());
+            condMaster.notify_one();
+        }
+    }
+
+    //! Move up to nMax verifications out of a deque, from its back (its owner) or its front (a thief)
+    unsigned int Take(Slot& slot, std::vector<T>& vChecks, unsigned int nMax, bool fOwner)
+    {
+        boost::unique_lock<boost::mutex> lock(slot.mutex);
+        unsigned int nNow = std::min<size_t>(nMax, fOwner ? slot.checks.size() : (slot.checks.size() + 1) / 2);
+        for (unsigned int i = 0; i < nNow; i++) {
+            vChecks.push_back(T());
+            if (fOwner) {
+                vChecks.back().swap(slot.checks.back());
+                slot.checks.pop_back();
+            } else {
+                vChecks.back().swap(slot.checks.front());
+                slot.checks.pop_front();
+            }
+        }
+        return nNow;
+    }
+
+    //! Fill vChecks with the next batch to work on, from the own deque first; return false if none was found
+    bool TakeWork(unsigned int nSlot, std::vector<T>& vChecks)
+    {
+        if (nQueued <= 0)
+            return false;
+        unsigned int nSlotsNow = nSlots;
+        // Aim for increasingly smaller batches so that all workers finish approximately simultaneously,
+        // but never smaller than 1 or larger than nBatchSize.
+        unsigned int nMax = std::max(1U, std::min(nBatchSize, (unsigned int)std::max(0, (int)nQueued) / (2 * nSlotsNow)));
+        unsigned int nNow = Take(*slots[nSlot], vChecks, nMax, true);
+        for (unsigned int i = 1; nNow == 0 && i < nSlotsNow; i++)
+            nNow = Take(*slots[(nSlot + i) % nSlotsNow], vChecks, nMax, false);
+        nQueued -= nNow;
+        return nNow != 0;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        unsigned int nSlot = fMaster ? 0 : RegisterWorker();
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
+            if (!TakeWork(nSlot, vChecks)) {
+                boost::unique_lock<boost::mutex> lock(Mutex());
+                if (fMaster) {
+                    if (nTodo == 0) {
+                        // return the current status, and reset it for new work later
                         bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
+                        fAllOk = true;
                         return fRet;
                     }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
-                }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
+                    // only the master adds work, so nothing new is coming: wait for the last batches
+                    if (nQueued <= 0)
+                        condMaster.wait(lock);
+                } else {
+                    while (nQueued <= 0) {
+                        nIdle++;
+                        condWorker.wait(lock); // wait
+                        nIdle--;
+                    }
                 }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
-            // execute work
-            BOOST_FOREACH (T& check, vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
+
+            Run(vChecks, fMaster);
         } while (true);
     }
 
 public:
-    //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    //! Create a new check queue, whose workers are shared with other queues if pworkersIn is not NULL
+    CCheckQueue(unsigned int nBatchSizeIn, CCheckQueueWorkers* pworkersIn = NULL) : nSlots(1), nWorkers(0), nNextSlot(0), nIdle(0), fAllOk(true), nTodo(0), nQueued(0), nBatchSize(nBatchSizeIn), pworkers(pworkersIn)
+    {
+        slots[0].reset(new Slot());
+        if (pworkers)
+            pworkers->vQueues.push_back(this);
+    }
 
-    //! Worker thread
+    //! Worker thread, for queues which do not share their workers
     void Thread()
     {
+        assert(!pworkers);
         Loop();
     }
 
+    unsigned int RegisterWorker() override
+    {
+        boost::unique_lock<boost::mutex> lock(Mutex());
+        unsigned int nSlot = ++nWorkers;
+        if (nSlot < MAX_SLOTS) {
+            slots[nSlot].reset(new Slot());
+            nSlots = nSlot + 1;
+            return nSlot;
+        }
+        return nSlot % MAX_SLOTS;
+    }
+
+    bool Work(unsigned int nSlot) override
+    {
+        std::vector<T> vChecks;
+        if (!TakeWork(nSlot, vChecks))
+            return false;
+        Run(vChecks, false);
+        return true;
+    }
+
+    bool HasWork() const override
+    {
+        return nQueued > 0;
+    }
+
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
@@ -145,16 +304,32 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        BOOST_FOREACH (T& check, vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
         nTodo += vChecks.size();
+
+        // deal the checks out to the deques in chunks, so that every worker finds some in its own
+        unsigned int nSlotsNow = nSlots;
+        unsigned int nChunk = std::max(1U, std::min(nBatchSize, (unsigned int)vChecks.size() / nSlotsNow));
+        for (size_t i = 0; i < vChecks.size(); i += nChunk) {
+            Slot& slot = *slots[nNextSlot];
+            nNextSlot = (nNextSlot + 1) % nSlotsNow;
+            boost::unique_lock<boost::mutex> lock(slot.mutex);
+            for (size_t j = i; j < std::min(vChecks.size(), i + nChunk); j++) {
+                slot.checks.push_back(T());
+                vChecks[j].swap(slot.checks.back());
+            }
+        }
+        nQueued += vChecks.size();
+
+        boost::unique_lock<boost::mutex> lock(Mutex());
+        boost::condition_variable& cond = pworkers ? pworkers->condWorker : condWorker;
+        if ((pworkers ? pworkers->nIdle : nIdle) == 0)
+            return;
         if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+            cond.notify_one();
+        else
+            cond.notify_all();
     }
 
     ~CCheckQueue()
@@ -163,8 +338,8 @@ public:
 
     bool IsIdle()
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        return (nTotal == nIdle && nTodo == 0 && fAllOk == true);
+        boost::unique_lock<boost::mutex> lock(Mutex());
+        return (nTodo == 0 && nQueued == 0 && fAllOk == true);
     }
 
 };
@@ -4,6 +4,7 @@
 
 #include "coins.h"
 
+#include "checkqueue.h"
 #include "memusage.h"
 #include "random.h"
 #include "version.h"
@@ -220,40 +221,93 @@ bool CCoinsViewBacked::GetStats(CCoinsStats &stats)
 
 CCoinsKeyHasher::CCoinsKeyHasher() : salt(GetRandHash()) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), cachedCoinsUsage(0) { }
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), cachedCoinsUsage(0), currentGeneration(0), fBaseScIdsLoaded(false) { }
 
 CCoinsViewCache::~CCoinsViewCache()
 {
     assert(!hasModifier);
 }
 
+void CCoinsViewCache::SetBackend(CCoinsView &viewIn) {
+    CCoinsViewBacked::SetBackend(viewIn);
+    baseScIds.clear();
+    fBaseScIdsLoaded = false;
+}
+
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) +
            memusage::DynamicUsage(cacheAnchors) +
            memusage::DynamicUsage(cacheNullifiers) +
            memusage::DynamicUsage(cacheSidechains) +
            memusage::DynamicUsage(cacheSidechainEvents) +
+           memusage::DynamicUsage(baseScIds) +
            cachedCoinsUsage;
 }
 
 CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const {
     CCoinsMap::iterator it = cacheCoins.find(txid);
-    if (it != cacheCoins.end())
+    if (it != cacheCoins.end()) {
+        it->second.generation = currentGeneration;
         return it;
+    }
     CCoins tmp;
     if (!base->GetCoins(txid, tmp))
         return cacheCoins.end();
     CCoinsMap::iterator ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry())).first;
+    ret->second.generation = currentGeneration;
     tmp.swap(ret->second.coins);
     if (ret->second.coins.IsPruned()) {
         // The parent only has an empty entry for this txid; we can consider our
         // version as fresh.
         ret->second.flags = CCoinsCacheEntry::FRESH;
+    } else {
+        ret->second.ResetBaseUnspent();
     }
     cachedCoinsUsage += ret->second.coins.DynamicMemoryUsage();
     return ret;
 }
 
+void CCoinsViewCache::Prefetch(const std::vector<uint256> &txids, CCheckQueue<CCoinsFetchCheck> *pqueue) {
+    if (pqueue == NULL)
+        return;
+
+    std::vector<uint256> vMissing;
+    vMissing.reserve(txids.size());
+    std::set<uint256> setSeen;
+    for (const uint256& txid: txids) {
+        if (cacheCoins.count(txid) == 0 && setSeen.insert(txid).second)
+            vMissing.push_back(txid);
+    }
+    if (vMissing.empty())
+        return;
+
+    std::vector<CCoins> vCoins(vMissing.size());
+    std::vector<char> vFound(vMissing.size(), 0);
+    {
+        CCheckQueueControl<CCoinsFetchCheck> control(pqueue);
+        std::vector<CCoinsFetchCheck> vChecks;
+        vChecks.reserve(vMissing.size());
+        for (size_t i = 0; i < vMissing.size(); i++)
+            vChecks.push_back(CCoinsFetchCheck(base, vMissing[i], &vCoins[i], &vFound[i]));
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    // same bookkeeping as FetchCoins, done here serially
+    for (size_t i = 0; i < vMissing.size(); i++) {
+        if (!vFound[i])
+            continue;
+        CCoinsMap::iterator ret = cacheCoins.insert(std::make_pair(vMissing[i], CCoinsCacheEntry())).first;
+        ret->second.generation = currentGeneration;
+        vCoins[i].swap(ret->second.coins);
+        if (ret->second.coins.IsPruned())
+            ret->second.flags = CCoinsCacheEntry::FRESH;
+        else
+            ret->second.ResetBaseUnspent();
+        cachedCoinsUsage += ret->second.coins.DynamicMemoryUsage();
+    }
+}
+
 CSidechainsMap::const_iterator CCoinsViewCache::FetchSidechains(const uint256& scId) const {
     CSidechainsMap::iterator candidateIt = cacheSidechains.find(scId);
     if (candidateIt != cacheSidechains.end())
@@ -447,12 +501,15 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
         } else if (ret.first->second.coins.IsPruned()) {
             // The parent view only has a pruned entry for this; mark it as fresh.
             ret.first->second.flags = CCoinsCacheEntry::FRESH;
+        } else {
+            ret.first->second.ResetBaseUnspent();
         }
     } else {
         cachedCoinUsage = ret.first->second.coins.DynamicMemoryUsage();
     }
     // Assume that whenever ModifyCoins is called, the entry will be modified.
     ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
+    ret.first->second.generation = currentGeneration;
     return CCoinsModifier(*this, ret.first, cachedCoinUsage);
 }
 
@@ -489,6 +546,7 @@ uint256 CCoinsViewCache::GetBestAnchor() const {
 
 void CCoinsViewCache::SetBestBlock(const uint256 &hashBlockIn) {
     hashBlock = hashBlockIn;
+    ++currentGeneration;
 }
 
 bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
@@ -499,6 +557,9 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
                                  CSidechainsMap& mapSidechains,
                                  CSidechainEventsMap& mapSidechainEvents) {
     assert(!hasModifier);
+    // blocks are connected and disconnected through a child view, flushed here
+    if (hashBlockIn != hashBlock)
+        ++currentGeneration;
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) { // Ignore non-dirty entries (optimization).
             CCoinsMap::iterator itUs = cacheCoins.find(it->first);
@@ -513,6 +574,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
                     entry.coins.swap(it->second.coins);
                     cachedCoinsUsage += entry.coins.DynamicMemoryUsage();
                     entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+                    entry.generation = currentGeneration;
                 }
             } else {
                 if ((itUs->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned()) {
@@ -527,6 +589,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
                     itUs->second.coins.swap(it->second.coins);
                     cachedCoinsUsage += itUs->second.coins.DynamicMemoryUsage();
                     itUs->second.flags |= CCoinsCacheEntry::DIRTY;
+                    itUs->second.generation = currentGeneration;
                 }
             }
         }
@@ -661,7 +724,13 @@ bool CCoinsViewCache::GetSidechain(const uint256 & scId, CSidechain& targetScInf
 
 void CCoinsViewCache::GetScIds(std::set<uint256>& scIdsList) const
 {
-    base->GetScIds(scIdsList);
+    if (!fBaseScIdsLoaded)
+    {
+        baseScIds.clear();
+        base->GetScIds(baseScIds);
+        fBaseScIdsLoaded = true;
+    }
+    scIdsList = baseScIds;
 
     // Note that some of the values above may have been erased in current cache.
     // Also new id may be in current cache but not in persisted
@@ -814,6 +883,9 @@ bool CCoinsViewCache::RevertTxOutputs(const CTransaction& tx, int nHeight)
 
         scIt->second.flag = CSidechainsCacheEntry::Flags::ERASED;
         LogPrint("sc", "%s():%d - scId=%s removed from scView\n", __func__, __LINE__, scId.ToString() );
+
+        // the scId could be re-created with a different vk, drop the deserialized one
+        libzendoomc::CScVkCache::Instance().Erase(scId);
     }
     return true;
 }
@@ -824,13 +896,17 @@ int CSidechain::StartHeightForEpoch(int targetEpoch) const { return -1; }
 int CSidechain::SafeguardMargin() const { return -1; }
 size_t CSidechain::DynamicMemoryUsage() const { return 0; }
 bool CCoinsViewCache::isEpochDataValid(const CSidechain& info, int epochNumber, const uint256& endEpochBlockHash) {return true;}
-bool CCoinsViewCache::IsCertApplicableToState(const CScCertificate& cert, int nHeight, CValidationState& state, libzendoomc::CScProofVerifier& scVerifier) {return true;}
+bool CCoinsViewCache::IsCertApplicableToState(const CScCertificate& cert, int nHeight, CValidationState& state, libzendoomc::CScProofVerifier& scVerifier,
+                                              std::vector<libzendoomc::CScCertProofCheck>* pvProofChecks) {return true;}
 bool libzendoomc::CScProofVerifier::verifyCScCertificate(              
     const libzendoomc::ScConstant& constant,
     const libzendoomc::ScVk& wCertVk,
     const uint256& prev_end_epoch_block_hash,
-    const CScCertificate& scCert
+    const CScCertificate& scCert,
+    std::vector<libzendoomc::CScCertProofCheck>* pvChecks
 ) const { return true; }
+libzendoomc::CScVkCache& libzendoomc::CScVkCache::Instance() { static CScVkCache cache; return cache; }
+void libzendoomc::CScVkCache::Erase(const uint256& scId) {}
 bool CCoinsViewCache::HaveScRequirements(const CTransaction& tx, int height) { return true;}
 size_t CSidechainEvents::DynamicMemoryUsage() const { return 0;}
 
@@ -838,7 +914,8 @@ size_t CSidechainEvents::DynamicMemoryUsage() const { return 0;}
 
 #include "consensus/validation.h"
 #include "main.h"
-bool CCoinsViewCache::IsCertApplicableToState(const CScCertificate& cert, int nHeight, CValidationState& state, libzendoomc::CScProofVerifier& scVerifier)
+bool CCoinsViewCache::IsCertApplicableToState(const CScCertificate& cert, int nHeight, CValidationState& state, libzendoomc::CScProofVerifier& scVerifier,
+                                              std::vector<libzendoomc::CScCertProofCheck>* pvProofChecks)
 {
     const uint256& certHash = cert.GetHash();
 
@@ -895,8 +972,8 @@ bool CCoinsViewCache::IsCertApplicableToState(const CScCertificate& cert, int nH
     int targetHeight = scInfo.StartHeightForEpoch(cert.epochNumber) - 1;
     uint256 prev_end_epoch_block_hash = chainActive[targetHeight] -> GetBlockHash();
 
-    // Verify certificate proof
-    if (!scVerifier.verifyCScCertificate(scInfo.creationData.constant, scInfo.creationData.wCertVk, prev_end_epoch_block_hash, cert)){
+    // Verify certificate proof, or just queue its verification if the caller asked for deferring it
+    if (!scVerifier.verifyCScCertificate(scInfo.creationData.constant, scInfo.creationData.wCertVk, prev_end_epoch_block_hash, cert, pvProofChecks)){
         LogPrintf("ERROR: certificate[%s] cannot be accepted for sidechain [%s]: proof verification failed\n",
             certHash.ToString(), cert.GetScId().ToString());
         return state.Invalid(error("proof not verified"),
@@ -1543,8 +1620,26 @@ CSidechain::State CCoinsViewCache::isCeasedAtHeight(const uint256& scId, int hei
     return  CSidechain::State::ALIVE;
 }
 
+void CCoinsViewCache::UpdateBaseScIds() const {
+    // keep track of the sidechains the base is going to know about, BatchWrite consumes the map
+    if (fBaseScIdsLoaded)
+    {
+        for (const auto& entry: cacheSidechains)
+        {
+            if (entry.second.flag == CSidechainsCacheEntry::Flags::ERASED)
+                baseScIds.erase(entry.first);
+            else
+                baseScIds.insert(entry.first);
+        }
+    }
+}
+
 bool CCoinsViewCache::Flush() {
+    UpdateBaseScIds();
+
     bool fOk = base->BatchWrite(cacheCoins, hashBlock, hashAnchor, cacheAnchors, cacheNullifiers, cacheSidechains, cacheSidechainEvents);
+    if (!fOk)
+        fBaseScIdsLoaded = false;
     cacheCoins.clear();
     cacheSidechains.clear();
     cacheSidechainEvents.clear();
@@ -1554,6 +1649,106 @@ bool CCoinsViewCache::Flush() {
     return fOk;
 }
 
+bool CCoinsViewCache::Sync(size_t nMaxUsage) {
+    assert(!hasModifier);
+    UpdateBaseScIds();
+
+    // Only the dirty coins are handed over to the base, which consumes them: the ones still
+    // holding outputs are copied and stay here as clean entries, the spent ones are moved.
+    CCoinsMap mapDirty;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) {
+            ++it;
+            continue;
+        }
+        CCoinsCacheEntry& entry = mapDirty[it->first];
+        entry.flags = it->second.flags;
+        entry.vBaseUnspent.swap(it->second.vBaseUnspent);
+        if (it->second.coins.IsPruned()) {
+            cachedCoinsUsage -= it->second.coins.DynamicMemoryUsage();
+            entry.coins.swap(it->second.coins);
+            it = cacheCoins.erase(it);
+        } else {
+            entry.coins = it->second.coins;
+            it->second.flags = 0;
+            // once written, the base holds the outputs as they are now
+            it->second.ResetBaseUnspent();
+            ++it;
+        }
+    }
+
+    size_t nWritten = mapDirty.size();
+    bool fOk = base->BatchWrite(mapDirty, hashBlock, hashAnchor, cacheAnchors, cacheNullifiers, cacheSidechains, cacheSidechainEvents);
+    if (!fOk) {
+        fBaseScIdsLoaded = false;
+        cacheCoins.clear();
+        cachedCoinsUsage = 0;
+    }
+    cacheSidechains.clear();
+    cacheSidechainEvents.clear();
+    cacheAnchors.clear();
+    cacheNullifiers.clear();
+    if (!fOk)
+        return false;
+
+    LogPrint("coindb", "%s():%d - written %u coins, %u kept in cache\n", __func__, __LINE__, nWritten, cacheCoins.size());
+    Trim(nMaxUsage);
+    return true;
+}
+
+void CCoinsViewCache::Trim(size_t nMaxUsage) {
+    assert(!hasModifier);
+    size_t nUsage = DynamicMemoryUsage();
+    if (nUsage <= nMaxUsage)
+        return;
+
+    // A rough estimate of what dropping an entry saves: its coins, its element and a couple of table slots
+    const size_t nEntryOverhead = sizeof(CCoinsMap::value_type) + 4 * sizeof(void*);
+
+    // Sum up what can be evicted per age, in blocks, of the last use; then find the youngest age to
+    // evict so that enough memory is released, evicting the oldest entries first
+    std::map<unsigned int, size_t, std::greater<unsigned int> > mapAgeUsage;
+    for (const auto& entry : cacheCoins) {
+        if (entry.second.flags & CCoinsCacheEntry::DIRTY)
+            continue;
+        mapAgeUsage[currentGeneration - entry.second.generation] += entry.second.coins.DynamicMemoryUsage() + nEntryOverhead;
+    }
+
+    size_t nToRelease = nUsage - nMaxUsage;
+    size_t nReleased = 0;
+    unsigned int nMinAge = 0;
+    bool fEvict = false;
+    for (const auto& ageUsage : mapAgeUsage) {
+        fEvict = true;
+        nMinAge = ageUsage.first;
+        nReleased += ageUsage.second;
+        if (nReleased >= nToRelease)
+            break;
+    }
+    if (!fEvict)
+        return;
+
+    // Rebuild the map rather than erasing in place, so that its table and element chunks shrink as well
+    CCoinsMap mapKept;
+    size_t nEvicted = 0;
+    for (auto& entry : cacheCoins) {
+        if (!(entry.second.flags & CCoinsCacheEntry::DIRTY) && currentGeneration - entry.second.generation >= nMinAge) {
+            cachedCoinsUsage -= entry.second.coins.DynamicMemoryUsage();
+            nEvicted++;
+            continue;
+        }
+        CCoinsCacheEntry& kept = mapKept[entry.first];
+        kept.coins.swap(entry.second.coins);
+        kept.flags = entry.second.flags;
+        kept.generation = entry.second.generation;
+        kept.vBaseUnspent.swap(entry.second.vBaseUnspent);
+    }
+    cacheCoins.swap(mapKept);
+
+    LogPrint("coindb", "%s():%d - evicted %u coins unused for %u blocks or more, cache usage %u => %u (limit %u)\n",
+        __func__, __LINE__, nEvicted, nMinAge, nUsage, DynamicMemoryUsage(), nMaxUsage);
+}
+
 bool CCoinsViewCache::DecrementImmatureAmount(const uint256& scId, const CSidechainsMap::iterator& targetEntry, CAmount nValue, int maturityHeight)
 {
     // get the map of immature amounts, they are indexed by height
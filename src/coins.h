@@ -9,6 +9,7 @@
 #include "compressor.h"
 #include "core_memusage.h"
 #include "memusage.h"
+#include "openhashmap.h"
 #include "serialize.h"
 #include "uint256.h"
 
@@ -286,13 +287,28 @@ struct CCoinsCacheEntry
 {
     CCoins coins; // The actual cached data.
     unsigned char flags;
+    unsigned int generation; // The cache generation (see CCoinsViewCache::Trim) this entry was last used in.
+
+    /**
+     * The outputs the parent view holds unspent, so that the coins database only has to write the
+     * outputs which changed. Empty if the parent view does not have this entry or if it is not known
+     * which outputs the parent view has (only for an entry not coming from the parent view and not FRESH).
+     */
+    std::vector<bool> vBaseUnspent;
 
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
         FRESH = (1 << 1), // The parent view does not have this entry (or it is pruned).
     };
 
-    CCoinsCacheEntry() : coins(), flags(0) {}
+    CCoinsCacheEntry() : coins(), flags(0), generation(0) {}
+
+    //! Record the current outputs as the ones the parent view holds
+    void ResetBaseUnspent() {
+        vBaseUnspent.assign(coins.vout.size(), false);
+        for (size_t i = 0; i < coins.vout.size(); i++)
+            vBaseUnspent[i] = !coins.vout[i].IsNull();
+    }
 };
 
 struct CSidechainsCacheEntry
@@ -350,11 +366,11 @@ struct CNullifiersCacheEntry
     CNullifiersCacheEntry() : entered(false), flags(0) {}
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher>      CCoinsMap;
-typedef boost::unordered_map<uint256, CSidechainsCacheEntry, CCoinsKeyHasher> CSidechainsMap; //maps scId to sidechain informations
+typedef openhashmap<uint256, CCoinsCacheEntry, CCoinsKeyHasher>              CCoinsMap;
+typedef openhashmap<uint256, CSidechainsCacheEntry, CCoinsKeyHasher>         CSidechainsMap; //maps scId to sidechain informations
 typedef boost::unordered_map<int, CSidechainEventsCacheEntry>                 CSidechainEventsMap; //maps blockchain height to sidechain amount to mature/certs to void
-typedef boost::unordered_map<uint256, CAnchorsCacheEntry, CCoinsKeyHasher>    CAnchorsMap;
-typedef boost::unordered_map<uint256, CNullifiersCacheEntry, CCoinsKeyHasher> CNullifiersMap;
+typedef openhashmap<uint256, CAnchorsCacheEntry, CCoinsKeyHasher>            CAnchorsMap;
+typedef openhashmap<uint256, CNullifiersCacheEntry, CCoinsKeyHasher>         CNullifiersMap;
 
 struct CCoinsStats
 {
@@ -445,7 +461,7 @@ public:
     void GetScIds(std::set<uint256>& scIdsList)                        const override;
     uint256 GetBestBlock()                                             const override;
     uint256 GetBestAnchor()                                            const override;
-    void SetBackend(CCoinsView &viewIn);
+    virtual void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins,
                     const uint256 &hashBlock,
                     const uint256 &hashAnchor,
@@ -459,6 +475,40 @@ public:
 
 class CCoinsViewCache;
 
+template <typename T> class CCheckQueue;
+
+/**
+ * Closure representing the lookup of the coins of one transaction in a view,
+ * so that many lookups can be spread over the workers of a CCheckQueue.
+ * The view must support concurrent reads.
+ */
+class CCoinsFetchCheck
+{
+private:
+    const CCoinsView *view;
+    uint256 txid;
+    CCoins *pcoins;
+    char *pfFound;
+
+public:
+    CCoinsFetchCheck(): view(NULL), pcoins(NULL), pfFound(NULL) {}
+    CCoinsFetchCheck(const CCoinsView *viewIn, const uint256 &txidIn, CCoins *pcoinsIn, char *pfFoundIn):
+        view(viewIn), txid(txidIn), pcoins(pcoinsIn), pfFound(pfFoundIn) {}
+
+    bool operator()() {
+        *pfFound = view->GetCoins(txid, *pcoins);
+        // a missing input is not an error here, ConnectBlock reports it
+        return true;
+    }
+
+    void swap(CCoinsFetchCheck &check) {
+        std::swap(view, check.view);
+        std::swap(txid, check.txid);
+        std::swap(pcoins, check.pcoins);
+        std::swap(pfFound, check.pfFound);
+    }
+};
+
 /** 
  * A reference to a mutable cache entry. Encapsulating it allows us to run
  *  cleanup code after the modification is finished, and keeping track of
@@ -502,6 +552,17 @@ protected:
     /* Cached dynamic memory usage for the inner CCoins objects. */
     mutable size_t cachedCoinsUsage;
 
+    /* Current cache generation, bumped at every new best block: coins used longest ago are evicted first. */
+    unsigned int currentGeneration;
+
+    /**
+     * Ids of the sidechains known to the base view, lazily loaded on first use and kept up to date
+     * by Flush, so that listing all sidechains does not hit the base view (and the chainstate db) each time.
+     * This relies on the base view being modified only through this cache, as it happens for pcoinsTip.
+     */
+    mutable std::set<uint256> baseScIds;
+    mutable bool fBaseScIdsLoaded;
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
     ~CCoinsViewCache();
@@ -513,6 +574,7 @@ public:
     bool HaveCoins(const uint256 &txid)                                const override;
     uint256 GetBestBlock()                                             const override;
     uint256 GetBestAnchor()                                            const override;
+    void SetBackend(CCoinsView &viewIn)                                      override;
     void SetBestBlock(const uint256 &hashBlock);
     bool BatchWrite(CCoinsMap &mapCoins,
                     const uint256 &hashBlock,
@@ -563,7 +625,8 @@ public:
     bool RevertTxOutputs(const CTransaction& tx, int nHeight);
 
     //CERTIFICATES RELATED PUBLIC MEMBERS
-    bool IsCertApplicableToState(const CScCertificate& cert, int nHeight, CValidationState& state, libzendoomc::CScProofVerifier& scVerifier);
+    bool IsCertApplicableToState(const CScCertificate& cert, int nHeight, CValidationState& state, libzendoomc::CScProofVerifier& scVerifier,
+                                 std::vector<libzendoomc::CScCertProofCheck>* pvProofChecks = nullptr);
     bool isEpochDataValid(const CSidechain& scInfo, int epochNumber, const uint256& epochBlockHash);
     bool UpdateScInfo(const CScCertificate& cert, CTxUndo& certUndoEntry);
     bool RevertCertOutputs(const CScCertificate& cert, const CTxUndo &certUndoEntry);
@@ -587,6 +650,26 @@ public:
 
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base as Flush does, but keep the coins
+     * cached (no longer dirty) and then evict the least recently used ones until DynamicMemoryUsage()
+     * is at most nMaxUsage, so that the following blocks still find most of their inputs in memory.
+     * The base must not drop entries this cache holds, which is the case for the coins database.
+     * If false is returned, the state of this cache (and its backing view) will be undefined.
+     */
+    bool Sync(size_t nMaxUsage);
+
+    //! Evict the least recently used coins which are not dirty, until DynamicMemoryUsage() is at most nMaxUsage
+    void Trim(size_t nMaxUsage);
+
+    /**
+     * Load the coins of the given transactions which are not cached yet from the base view,
+     * spreading the lookups over the workers of pqueue, so that the serial code using this cache
+     * later on does not wait for the base view (and the disk) one transaction at a time.
+     * The base view must support concurrent reads. Does nothing if pqueue is NULL.
+     */
+    void Prefetch(const std::vector<uint256> &txids, CCheckQueue<CCoinsFetchCheck> *pqueue);
+
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
@@ -624,6 +707,7 @@ private:
     const CSidechain* const        AccessSidechain(const uint256& scId);
     CSidechainEventsMap::const_iterator FetchSidechainEvents(int height) const;
     CSidechainEventsMap::iterator  ModifySidechainEvents(int height);
+    void                           UpdateBaseScIds()             const;
 
     static int getInitScCoinsMaturity();
     int getScCoinsMaturity();
@@ -0,0 +1,218 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CUCKOOCACHE_H
+#define BITCOIN_CUCKOOCACHE_H
+
+#include "uint256.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Fixed-size set of uniformly distributed 256 bit values (salted hashes), which any number of
+ * threads can query and insert into at the same time without taking any lock.
+ *
+ * Every value can be stored in one of 8 slots, picked by its 8 32-bit words. Inserting a value
+ * when all its slots are taken moves the value of one of them to another of its slots, and so on
+ * for a few steps (cuckoo hashing), after which the value still in hand is dropped. Values can be
+ * marked as erased on lookup, so that their slot is reused first.
+ *
+ * Each slot is guarded by a sequence number, odd while a writer is changing it: readers check
+ * that it did not change while they read the slot, and writers only try to take a slot once.
+ * Races thus only ever make a lookup miss or an insertion get dropped, and a lookup never finds
+ * a value which was not inserted.
+ */
+class CCuckooCache
+{
+private:
+    struct Slot
+    {
+        std::atomic<uint32_t> seq;
+        std::atomic<uint64_t> words[4];
+    };
+
+    std::unique_ptr<Slot[]> slots;
+
+    //! One bit per slot, set if the slot can be overwritten (empty or erased)
+    std::unique_ptr<std::atomic<uint8_t>[]> collectable;
+
+    uint32_t nSize;
+
+    //! How many values are moved at most to make room for a new one
+    unsigned int nDepthLimit;
+
+    static uint64_t Word(const uint256& value, unsigned int i)
+    {
+        uint64_t word;
+        memcpy(&word, value.begin() + 8 * i, 8);
+        return word;
+    }
+
+    void Locations(const uint256& value, uint32_t locs[8]) const
+    {
+        for (unsigned int i = 0; i < 8; i++) {
+            uint32_t word;
+            memcpy(&word, value.begin() + 4 * i, 4);
+            locs[i] = (uint32_t)(((uint64_t)word * nSize) >> 32);
+        }
+    }
+
+    bool IsCollectable(uint32_t n) const
+    {
+        return collectable[n >> 3].load(std::memory_order_relaxed) & (1 << (n & 7));
+    }
+
+    void SetCollectable(uint32_t n, bool fCollectable)
+    {
+        if (fCollectable)
+            collectable[n >> 3].fetch_or(1 << (n & 7), std::memory_order_relaxed);
+        else
+            collectable[n >> 3].fetch_and(~(1 << (n & 7)), std::memory_order_relaxed);
+    }
+
+    bool Matches(uint32_t n, const uint256& value) const
+    {
+        const Slot& slot = slots[n];
+        uint32_t nSeq = slot.seq.load(std::memory_order_acquire);
+        if (nSeq & 1)
+            return false;
+        bool fMatch = true;
+        for (unsigned int i = 0; i < 4; i++)
+            fMatch &= slot.words[i].load(std::memory_order_relaxed) == Word(value, i);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return fMatch && slot.seq.load(std::memory_order_relaxed) == nSeq;
+    }
+
+    //! Take a slot for writing, unless another writer has it
+    bool TryLock(uint32_t n, uint32_t& nSeq)
+    {
+        Slot& slot = slots[n];
+        nSeq = slot.seq.load(std::memory_order_relaxed);
+        if ((nSeq & 1) || !slot.seq.compare_exchange_strong(nSeq, nSeq + 1, std::memory_order_acquire))
+            return false;
+        std::atomic_thread_fence(std::memory_order_release);
+        return true;
+    }
+
+    void Unlock(uint32_t n, uint32_t nSeq)
+    {
+        slots[n].seq.store(nSeq + 2, std::memory_order_release);
+    }
+
+    //! Swap value with the content of a locked slot
+    void Exchange(uint32_t n, uint256& value)
+    {
+        Slot& slot = slots[n];
+        for (unsigned int i = 0; i < 4; i++) {
+            uint64_t word = slot.words[i].load(std::memory_order_relaxed);
+            slot.words[i].store(Word(value, i), std::memory_order_relaxed);
+            memcpy(value.begin() + 8 * i, &word, 8);
+        }
+    }
+
+    //! Store value in one of its slots which can be overwritten, if any
+    bool TryPlace(const uint256& value, const uint32_t locs[8])
+    {
+        for (unsigned int i = 0; i < 8; i++) {
+            uint32_t nSeq;
+            if (!IsCollectable(locs[i]) || !TryLock(locs[i], nSeq))
+                continue;
+            bool fPlaced = IsCollectable(locs[i]);
+            if (fPlaced) {
+                uint256 tmp = value;
+                Exchange(locs[i], tmp);
+                SetCollectable(locs[i], false);
+            }
+            Unlock(locs[i], nSeq);
+            if (fPlaced)
+                return true;
+        }
+        return false;
+    }
+
+public:
+    CCuckooCache(): nSize(0), nDepthLimit(0) {}
+
+    //! Allocate (and empty) the cache so that it uses at most nBytes; return the number of values it can hold
+    uint32_t Setup(size_t nBytes)
+    {
+        nSize = (uint32_t)std::min<size_t>(std::numeric_limits<uint32_t>::max(), nBytes / (sizeof(Slot) + 1));
+        slots.reset(nSize ? new Slot[nSize] : nullptr);
+        collectable.reset(nSize ? new std::atomic<uint8_t>[(nSize + 7) / 8] : nullptr);
+        for (uint32_t n = 0; n < nSize; n++) {
+            slots[n].seq.store(0, std::memory_order_relaxed);
+            for (unsigned int i = 0; i < 4; i++)
+                slots[n].words[i].store(0, std::memory_order_relaxed);
+        }
+        for (uint32_t n = 0; n < (nSize + 7) / 8; n++)
+            collectable[n].store(0xff, std::memory_order_relaxed);
+        nDepthLimit = (unsigned int)std::log2((double)std::max<uint32_t>(2, nSize));
+        return nSize;
+    }
+
+    //! Whether value is in the cache; if fErase, its slot becomes the first to be reused
+    bool Contains(const uint256& value, bool fErase)
+    {
+        if (nSize == 0)
+            return false;
+        uint32_t locs[8];
+        Locations(value, locs);
+        for (unsigned int i = 0; i < 8; i++) {
+            if (Matches(locs[i], value)) {
+                if (fErase)
+                    SetCollectable(locs[i], true);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Insert(const uint256& valueIn)
+    {
+        if (nSize == 0)
+            return;
+        uint32_t locs[8];
+        Locations(valueIn, locs);
+        for (unsigned int i = 0; i < 8; i++) {
+            if (Matches(locs[i], valueIn)) {
+                SetCollectable(locs[i], false);
+                return;
+            }
+        }
+
+        // Make room by moving the value of one slot to another of its slots, in turn, always taking
+        // the slot after the one a value was moved out of, so as not to move it straight back.
+        uint256 value = valueIn;
+        uint32_t nLast = locs[7];
+        for (unsigned int nDepth = 0; nDepth <= nDepthLimit; nDepth++) {
+            if (TryPlace(value, locs))
+                return;
+            unsigned int nNext = 0;
+            while (nNext < 8 && locs[nNext] != nLast)
+                nNext++;
+            uint32_t n = locs[(nNext + 1) & 7];
+            uint32_t nSeq;
+            if (!TryLock(n, nSeq))
+                return;
+            bool fFreed = IsCollectable(n);
+            Exchange(n, value);
+            SetCollectable(n, false);
+            Unlock(n, nSeq);
+            // an erased value got overwritten meanwhile: no need to find it a place
+            if (fFreed)
+                return;
+            nLast = n;
+            Locations(value, locs);
+        }
+        // the value left in hand is dropped, as a random eviction would
+    }
+};
+
+#endif // BITCOIN_CUCKOOCACHE_H
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+
+#include "addressindex.h"
+#include "chain.h"
+#include "scindex.h"
+#include "spentindex.h"
+#include "timestampindex.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+
+static uint160 AddressHash(const std::string& hex) {
+    uint160 hash;
+    hash.SetHex(hex);
+    return hash;
+}
+
+class AddressIndexTest : public ::testing::Test {
+protected:
+    boost::filesystem::path pathTemp;
+
+    void SetUp() override {
+        pathTemp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        boost::filesystem::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+    }
+
+    void TearDown() override {
+        ClearDatadirCache();
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(pathTemp.string(), ec);
+    }
+
+    //! store a block index entry, whose key follows the keys of the timestamp index
+    static void WriteBlockIndex(CBlockTreeDB& db) {
+        static const uint256 hash = uint256S("ff");
+        CBlockIndex index;
+        index.phashBlock = &hash;
+        std::vector<const CBlockIndex*> blockinfo(1, &index);
+        ASSERT_TRUE(db.WriteBatchSync(std::vector<std::pair<int, const CBlockFileInfo*> >(), 0, blockinfo));
+    }
+};
+
+TEST_F(AddressIndexTest, DeltasAreReadInChainOrder) {
+    CBlockTreeDB db(1 << 20, true);
+    uint160 address = AddressHash("aa");
+    uint160 other = AddressHash("ab");
+
+    // heights which sort differently as little-endian integers
+    std::vector<std::pair<CAddressIndexKey, CAmount> > deltas;
+    deltas.push_back(std::make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, address, 256, 0, uint256S("01"), 0, false), 10));
+    deltas.push_back(std::make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, address, 1, 2, uint256S("02"), 1, false), 20));
+    deltas.push_back(std::make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, address, 300, 1, uint256S("03"), 0, true), -10));
+    deltas.push_back(std::make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, other, 2, 0, uint256S("04"), 0, false), 5));
+    deltas.push_back(std::make_pair(CAddressIndexKey(ADDRESS_INDEX_SCRIPTHASH, address, 2, 0, uint256S("05"), 0, false), 7));
+    ASSERT_TRUE(db.WriteAddressIndex(deltas));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > read;
+    ASSERT_TRUE(db.ReadAddressIndex(address, ADDRESS_INDEX_PUBKEYHASH, read));
+    ASSERT_EQ(read.size(), 3u);
+    EXPECT_EQ(read[0].first.nHeight, 1);
+    EXPECT_EQ(read[0].second, 20);
+    EXPECT_EQ(read[1].first.nHeight, 256);
+    EXPECT_EQ(read[2].first.nHeight, 300);
+    EXPECT_TRUE(read[2].first.fSpending);
+    EXPECT_EQ(read[2].first.txid, uint256S("03"));
+
+    read.clear();
+    ASSERT_TRUE(db.ReadAddressIndex(address, ADDRESS_INDEX_PUBKEYHASH, read, 2, 299));
+    ASSERT_EQ(read.size(), 1u);
+    EXPECT_EQ(read[0].first.nHeight, 256);
+
+    // disconnecting erases the same keys
+    deltas.resize(1);
+    ASSERT_TRUE(db.EraseAddressIndex(deltas));
+    read.clear();
+    ASSERT_TRUE(db.ReadAddressIndex(address, ADDRESS_INDEX_PUBKEYHASH, read));
+    EXPECT_EQ(read.size(), 2u);
+}
+
+TEST_F(AddressIndexTest, NullValuesEraseEntries) {
+    CBlockTreeDB db(1 << 20, true);
+    uint160 address = AddressHash("aa");
+    uint256 txid = uint256S("01");
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspent;
+    unspent.push_back(std::make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, address, txid, 0),
+                                     CAddressUnspentValue(100, CScript() << OP_TRUE, 10, 0)));
+    unspent.push_back(std::make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, address, txid, 1),
+                                     CAddressUnspentValue(200, CScript() << OP_TRUE, 10, 25)));
+    ASSERT_TRUE(db.UpdateAddressUnspentIndex(unspent));
+    // the keys of the address index follow, and are longer
+    std::vector<std::pair<CAddressIndexKey, CAmount> > deltas;
+    deltas.push_back(std::make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, address, 10, 1, txid, 0, false), 100));
+    ASSERT_TRUE(db.WriteAddressIndex(deltas));
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > read;
+    ASSERT_TRUE(db.ReadAddressUnspentIndex(address, ADDRESS_INDEX_PUBKEYHASH, read));
+    ASSERT_EQ(read.size(), 2u);
+    EXPECT_EQ(read[1].second.nValue, 200);
+    EXPECT_EQ(read[1].second.nBwtMaturityHeight, 25);
+
+    unspent.resize(1);
+    unspent[0].second = CAddressUnspentValue();
+    ASSERT_TRUE(db.UpdateAddressUnspentIndex(unspent));
+    read.clear();
+    ASSERT_TRUE(db.ReadAddressUnspentIndex(address, ADDRESS_INDEX_PUBKEYHASH, read));
+    ASSERT_EQ(read.size(), 1u);
+    EXPECT_EQ(read[0].first.n, 1u);
+
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spent;
+    spent.push_back(std::make_pair(CSpentIndexKey(txid, 0), CSpentIndexValue(uint256S("02"), 3, 11, 100, ADDRESS_INDEX_PUBKEYHASH, address)));
+    ASSERT_TRUE(db.UpdateSpentIndex(spent));
+    CSpentIndexValue value;
+    ASSERT_TRUE(db.ReadSpentIndex(CSpentIndexKey(txid, 0), value));
+    EXPECT_EQ(value.txid, uint256S("02"));
+    EXPECT_EQ(value.nInput, 3u);
+    EXPECT_EQ(value.nHeight, 11);
+
+    spent[0].second = CSpentIndexValue();
+    ASSERT_TRUE(db.UpdateSpentIndex(spent));
+    EXPECT_FALSE(db.ReadSpentIndex(CSpentIndexKey(txid, 0), value));
+}
+
+TEST_F(AddressIndexTest, BlocksAreReadByTimestampRange) {
+    CBlockTreeDB db(1 << 20, true);
+    ASSERT_TRUE(db.WriteTimestampIndex(CTimestampIndexKey(0x100, uint256S("01"))));
+    ASSERT_TRUE(db.WriteTimestampIndex(CTimestampIndexKey(0x1ff, uint256S("02"))));
+    ASSERT_TRUE(db.WriteTimestampIndex(CTimestampIndexKey(0x200, uint256S("03"))));
+    WriteBlockIndex(db);
+
+    std::vector<uint256> hashes;
+    ASSERT_TRUE(db.ReadTimestampIndex(0x200, 0x100, hashes));
+    ASSERT_EQ(hashes.size(), 2u);
+    EXPECT_EQ(hashes[0], uint256S("01"));
+    EXPECT_EQ(hashes[1], uint256S("02"));
+
+    ASSERT_TRUE(db.EraseTimestampIndex(CTimestampIndexKey(0x100, uint256S("01"))));
+    hashes.clear();
+    ASSERT_TRUE(db.ReadTimestampIndex(0x300, 0, hashes));
+    EXPECT_EQ(hashes.size(), 2u);
+}
+
+TEST_F(AddressIndexTest, ScActivityIsReadByHeightRange) {
+    CBlockTreeDB db(1 << 20, true);
+    uint256 scId = uint256S("aa");
+    uint256 otherScId = uint256S("ab");
+
+    std::vector<std::pair<CScIndexKey, CScIndexValue> > activity;
+    activity.push_back(std::make_pair(CScIndexKey(scId, 300, SC_INDEX_CERTIFICATE, uint256S("03"), 0),
+                                      CScIndexValue(30, 1, uint256(), CScript())));
+    activity.push_back(std::make_pair(CScIndexKey(scId, 300, SC_INDEX_BACKWARD_TRANSFER, uint256S("03"), 1),
+                                      CScIndexValue(30, 1, uint256(), CScript() << OP_TRUE)));
+    activity.push_back(std::make_pair(CScIndexKey(scId, 1, SC_INDEX_CREATION, uint256S("01"), 0),
+                                      CScIndexValue(10, -1, uint256S("ff"), CScript())));
+    activity.push_back(std::make_pair(CScIndexKey(scId, 256, SC_INDEX_FORWARD_TRANSFER, uint256S("02"), 2),
+                                      CScIndexValue(20, -1, uint256S("fe"), CScript())));
+    activity.push_back(std::make_pair(CScIndexKey(otherScId, 2, SC_INDEX_CREATION, uint256S("04"), 0),
+                                      CScIndexValue(5, -1, uint256(), CScript())));
+    ASSERT_TRUE(db.WriteScIndex(activity));
+    // the keys of the timestamp index follow, and are shorter
+    ASSERT_TRUE(db.WriteTimestampIndex(CTimestampIndexKey(0x100, uint256S("01"))));
+
+    std::vector<std::pair<CScIndexKey, CScIndexValue> > read;
+    ASSERT_TRUE(db.ReadScIndex(scId, read));
+    ASSERT_EQ(read.size(), 4u);
+    EXPECT_EQ(read[0].first.kind, SC_INDEX_CREATION);
+    EXPECT_EQ(read[0].second.address, uint256S("ff"));
+    EXPECT_EQ(read[1].first.nHeight, 256);
+    EXPECT_EQ(read[1].first.n, 2u);
+    EXPECT_EQ(read[2].first.kind, SC_INDEX_CERTIFICATE);
+    EXPECT_EQ(read[3].first.kind, SC_INDEX_BACKWARD_TRANSFER);
+    EXPECT_EQ(read[3].second.nEpoch, 1);
+
+    read.clear();
+    ASSERT_TRUE(db.ReadScIndex(scId, read, 2, 299));
+    ASSERT_EQ(read.size(), 1u);
+    EXPECT_EQ(read[0].first.kind, SC_INDEX_FORWARD_TRANSFER);
+
+    // reading the last sidechain reaches the end of the index
+    read.clear();
+    ASSERT_TRUE(db.ReadScIndex(otherScId, read, 1));
+    ASSERT_EQ(read.size(), 1u);
+    EXPECT_EQ(read[0].first.nHeight, 2);
+
+    ASSERT_TRUE(db.EraseScIndex(activity));
+    read.clear();
+    ASSERT_TRUE(db.ReadScIndex(otherScId, read));
+    EXPECT_TRUE(read.empty());
+}
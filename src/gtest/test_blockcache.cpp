@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include "blockcache.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "main.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+
+// a block using about nSize bytes of memory, distinct for every nNonce
+static CBlock MakeBlock(unsigned int nNonce, size_t nSize)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].scriptSig = CScript() << nNonce;
+    std::vector<unsigned char> data(nSize, OP_TRUE);
+    mtx.addOut(CTxOut(CAmount(1), CScript(data.begin(), data.end())));
+
+    CBlock block;
+    block.nNonce = ArithToUint256(arith_uint256(nNonce));
+    block.vtx.push_back(mtx);
+    return block;
+}
+
+TEST(BlockCache, KeepsTheMostRecentlyUsedBlocks) {
+    nBlockCacheUsage = 1 << 20;
+
+    std::vector<CBlock> blocks;
+    for (unsigned int i = 0; i < 8; i++)
+        blocks.push_back(MakeBlock(1000 + i, 200000));
+
+    // a null position cannot be read: only cached blocks are found
+    CacheBlock(blocks[0]);
+    std::shared_ptr<const CBlock> pblock = GetCachedBlock(blocks[0].GetHash(), CDiskBlockPos());
+    ASSERT_TRUE(pblock != nullptr);
+    EXPECT_EQ(pblock->GetHash(), blocks[0].GetHash());
+    EXPECT_EQ(pblock, GetCachedBlock(blocks[0].GetHash(), CDiskBlockPos()));
+
+    // keep using the first block while the others fill the cache
+    for (unsigned int i = 1; i < blocks.size(); i++) {
+        CacheBlock(blocks[i]);
+        EXPECT_TRUE(GetCachedBlock(blocks[0].GetHash(), CDiskBlockPos()) != nullptr);
+    }
+    EXPECT_TRUE(GetCachedBlock(blocks[1].GetHash(), CDiskBlockPos()) == nullptr);
+    EXPECT_TRUE(GetCachedBlock(blocks.back().GetHash(), CDiskBlockPos()) != nullptr);
+    // evicted blocks stay valid for those holding them
+    EXPECT_EQ(pblock->GetHash(), blocks[0].GetHash());
+
+    // blocks larger than the cache are not kept
+    CBlock large = MakeBlock(2000, 2 << 20);
+    CacheBlock(large);
+    EXPECT_TRUE(GetCachedBlock(large.GetHash(), CDiskBlockPos()) == nullptr);
+    EXPECT_TRUE(GetCachedBlock(blocks[0].GetHash(), CDiskBlockPos()) != nullptr);
+
+    nBlockCacheUsage = 0;
+    CBlock other = MakeBlock(3000, 100);
+    CacheBlock(other);
+    EXPECT_TRUE(GetCachedBlock(other.GetHash(), CDiskBlockPos()) == nullptr);
+
+    nBlockCacheUsage = (size_t) DEFAULT_MAX_BLOCK_CACHE_SIZE << 20;
+}
+
+TEST(BlockCache, KeepsNothingConnectedDuringTheInitialDownload) {
+    SelectParams(CBaseChainParams::REGTEST);
+    boost::filesystem::path pathTemp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+    ClearDatadirCache();
+
+    // the genesis block is the only one whose proof of work can be read back without mining
+    CBlock genesis = Params().GenesisBlock();
+    const uint256 hash = genesis.GetHash();
+    CDiskBlockPos pos(0, 0);
+    ASSERT_TRUE(WriteBlockToDisk(genesis, pos, Params().MessageStart()));
+    CBlockIndex index(genesis);
+    index.phashBlock = &hash;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus |= BLOCK_HAVE_DATA;
+
+    // reindexing past the chain split
+    const uint256 hashTip = uint256S("1");
+    CBlockIndex tip;
+    tip.phashBlock = &hashTip;
+    tip.pprev = &index;
+    tip.nHeight = 1;
+    chainActive.SetTip(&tip);
+    fReindex = true;
+    ASSERT_TRUE(IsInitialBlockDownload());
+
+    std::shared_ptr<const CBlock> pblock = GetBlockToConnect(&index);
+    ASSERT_TRUE(pblock != nullptr);
+    EXPECT_EQ(pblock->GetHash(), hash);
+    EXPECT_TRUE(GetCachedBlock(hash, CDiskBlockPos()) == nullptr);
+
+    CacheConnectedBlock(genesis);
+    EXPECT_TRUE(GetCachedBlock(hash, CDiskBlockPos()) == nullptr);
+
+    fReindex = false;
+    chainActive.SetTip(NULL);
+    ClearDatadirCache();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(pathTemp.string(), ec);
+}
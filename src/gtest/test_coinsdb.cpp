@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include "main.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+
+class CCoinsViewTestDB : public CCoinsViewDB {
+public:
+    CCoinsViewTestDB() : CCoinsViewDB(1 << 20, false, true) {}
+
+    //! store coins as versions before the per output layout did
+    bool WriteLegacyCoins(const uint256& txid, const CCoins& coins) {
+        return db.Write(std::make_pair('c', txid), coins);
+    }
+
+    bool WriteCoins(const uint256& txid, const CCoinsCacheEntry& entry) {
+        CCoinsMap mapCoins;
+        mapCoins[txid] = entry;
+        CAnchorsMap mapAnchors;
+        CNullifiersMap mapNullifiers;
+        CSidechainsMap mapSidechains;
+        CSidechainEventsMap mapSidechainEvents;
+        return BatchWrite(mapCoins, uint256(), uint256(), mapAnchors, mapNullifiers, mapSidechains, mapSidechainEvents);
+    }
+};
+
+class CoinsDBTest : public ::testing::Test {
+protected:
+    boost::filesystem::path pathTemp;
+
+    void SetUp() override {
+        pathTemp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        boost::filesystem::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+    }
+
+    void TearDown() override {
+        ClearDatadirCache();
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(pathTemp.string(), ec);
+    }
+
+    //! coins of a certificate with one change output followed by backward transfers
+    static CCoins CertCoins() {
+        CCoins coins;
+        coins.nVersion = SC_CERT_VERSION;
+        coins.nHeight = 100;
+        coins.nFirstBwtPos = 1;
+        coins.nBwtMaturityHeight = 150;
+        coins.vout.resize(4);
+        for (unsigned int i = 0; i < coins.vout.size(); i++) {
+            coins.vout[i].nValue = 1000 + i;
+            coins.vout[i].scriptPubKey = CScript() << OP_TRUE;
+        }
+        return coins;
+    }
+};
+
+TEST_F(CoinsDBTest, OutputsAreStoredAndSpentOneByOne) {
+    CCoinsViewTestDB db;
+    uint256 txid = uint256S("aaaa");
+
+    CCoinsCacheEntry entry;
+    entry.coins = CertCoins();
+    entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+    ASSERT_TRUE(db.WriteCoins(txid, entry));
+
+    CCoins coins;
+    ASSERT_TRUE(db.GetCoins(txid, coins));
+    EXPECT_TRUE(db.HaveCoins(txid));
+    EXPECT_EQ(coins.vout, entry.coins.vout);
+    EXPECT_EQ(coins.nHeight, 100);
+    // the maturity of backward transfers survives the round trip
+    EXPECT_TRUE(coins.IsFromCert());
+    EXPECT_TRUE(coins.isOutputMature(0, 101));
+    EXPECT_FALSE(coins.isOutputMature(2, 149));
+    EXPECT_TRUE(coins.isOutputMature(2, 150));
+
+    // spend an output in the middle and the last one, knowing which outputs are stored
+    entry.ResetBaseUnspent();
+    entry.flags = CCoinsCacheEntry::DIRTY;
+    entry.coins.Spend(1);
+    entry.coins.Spend(3);
+    ASSERT_TRUE(db.WriteCoins(txid, entry));
+    ASSERT_TRUE(db.GetCoins(txid, coins));
+    EXPECT_EQ(coins.vout, entry.coins.vout);
+    EXPECT_EQ(coins.vout.size(), 3u);
+
+    // spend the rest, without knowing which outputs are stored
+    entry.vBaseUnspent.clear();
+    entry.coins.Spend(0);
+    entry.coins.Spend(2);
+    ASSERT_TRUE(entry.coins.IsPruned());
+    ASSERT_TRUE(db.WriteCoins(txid, entry));
+    EXPECT_FALSE(db.GetCoins(txid, coins));
+    EXPECT_FALSE(db.HaveCoins(txid));
+}
+
+TEST_F(CoinsDBTest, UpgradeMovesLegacyRecords) {
+    CCoinsViewTestDB db;
+    CCoins certCoins = CertCoins();
+    certCoins.vout[2].SetNull();
+    CCoins txCoins;
+    txCoins.nVersion = TRANSPARENT_TX_VERSION;
+    txCoins.nHeight = 7;
+    txCoins.fCoinBase = true;
+    txCoins.vout.resize(1);
+    txCoins.vout[0].nValue = 5;
+
+    std::vector<uint256> txids;
+    for (int i = 0; i < 100; i++) {
+        txids.push_back(GetRandHash());
+        ASSERT_TRUE(db.WriteLegacyCoins(txids.back(), i % 2 ? certCoins : txCoins));
+    }
+    CCoins coins;
+    EXPECT_FALSE(db.GetCoins(txids[0], coins));
+
+    ASSERT_TRUE(db.Upgrade());
+    for (int i = 0; i < 100; i++) {
+        const CCoins& expected = i % 2 ? certCoins : txCoins;
+        ASSERT_TRUE(db.GetCoins(txids[i], coins));
+        EXPECT_EQ(coins.vout, expected.vout);
+        EXPECT_EQ(coins.fCoinBase, expected.fCoinBase);
+        EXPECT_EQ(coins.nHeight, expected.nHeight);
+        EXPECT_EQ(coins.IsFromCert(), expected.IsFromCert());
+        if (expected.IsFromCert()) {
+            EXPECT_EQ(coins.nFirstBwtPos, expected.nFirstBwtPos);
+            EXPECT_EQ(coins.nBwtMaturityHeight, expected.nBwtMaturityHeight);
+        }
+    }
+
+    // nothing is left to upgrade
+    ASSERT_TRUE(db.Upgrade());
+    ASSERT_TRUE(db.GetCoins(txids[1], coins));
+    EXPECT_EQ(coins.vout, certCoins.vout);
+}
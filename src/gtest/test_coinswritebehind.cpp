@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include "main.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+
+class CoinsWriteBehindTest : public ::testing::Test {
+protected:
+    boost::filesystem::path pathTemp;
+
+    void SetUp() override {
+        pathTemp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        boost::filesystem::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+    }
+
+    void TearDown() override {
+        ClearDatadirCache();
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(pathTemp.string(), ec);
+    }
+
+    static bool WriteCoin(CCoinsView& view, const uint256& txid, CAmount nValue, const uint256& hashBlock) {
+        CCoinsMap mapCoins;
+        CCoinsCacheEntry& entry = mapCoins[txid];
+        entry.flags = CCoinsCacheEntry::DIRTY;
+        if (nValue >= 0) {
+            entry.coins.nVersion = TRANSPARENT_TX_VERSION;
+            entry.coins.vout.resize(1);
+            entry.coins.vout[0].nValue = nValue;
+        }
+        CAnchorsMap mapAnchors;
+        CNullifiersMap mapNullifiers;
+        CSidechainsMap mapSidechains;
+        CSidechainEventsMap mapSidechainEvents;
+        return view.BatchWrite(mapCoins, hashBlock, uint256(), mapAnchors, mapNullifiers, mapSidechains, mapSidechainEvents);
+    }
+};
+
+TEST_F(CoinsWriteBehindTest, QueuedChangesAreVisibleAndEventuallyOnDisk) {
+    CCoinsViewDB db(1 << 20, false, true);
+    uint256 txid = uint256S("aaaa");
+    uint256 hashBlock1 = uint256S("1111");
+    uint256 hashBlock2 = uint256S("2222");
+
+    {
+        CCoinsViewWriteBehind writer(&db);
+
+        ASSERT_TRUE(WriteCoin(writer, txid, 10, hashBlock1));
+        // readers see the changes whether or not they have reached the disk
+        CCoins coins;
+        EXPECT_TRUE(writer.GetCoins(txid, coins));
+        EXPECT_EQ(coins.vout[0].nValue, 10);
+        EXPECT_EQ(writer.GetBestBlock(), hashBlock1);
+
+        ASSERT_TRUE(writer.WaitForWrite());
+        EXPECT_TRUE(db.GetCoins(txid, coins));
+        EXPECT_EQ(db.GetBestBlock(), hashBlock1);
+
+        // spending the coin erases it
+        ASSERT_TRUE(WriteCoin(writer, txid, -1, hashBlock2));
+        EXPECT_FALSE(writer.HaveCoins(txid));
+        EXPECT_FALSE(writer.GetCoins(txid, coins));
+        EXPECT_EQ(writer.GetBestBlock(), hashBlock2);
+    }
+
+    // the last changes are written before the writer goes away
+    EXPECT_FALSE(db.HaveCoins(txid));
+    EXPECT_EQ(db.GetBestBlock(), hashBlock2);
+}
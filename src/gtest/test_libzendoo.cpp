@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include <cstring>
 #include <utilstrencodings.h>
+#include <sc/proofverifier.h>
+#include <primitives/certificate.h>
 
 TEST(ZendooLib, FieldTest)
 {
@@ -259,4 +261,54 @@ TEST(ZendooLib, TestProofNoBwt){
     zendoo_sc_proof_free(proof);
     zendoo_sc_vk_free(vk);
     zendoo_field_free(constant);
-}
\ No newline at end of file
+}
+TEST(ZendooLib, DeferredCertProofVerification)
+{
+    CScCertificate cert;
+    libzendoomc::ScConstant constant;
+    libzendoomc::ScVk vk;
+    std::vector<libzendoomc::CScCertProofCheck> vChecks;
+
+    // Disabled verifier neither verifies nor queues anything
+    ASSERT_TRUE(libzendoomc::CScProofVerifier::Disabled().verifyCScCertificate(constant, vk, uint256(), cert, &vChecks));
+    ASSERT_TRUE(vChecks.empty());
+
+    // Strict verifier queues the check instead of running it
+    ASSERT_TRUE(libzendoomc::CScProofVerifier::Strict().verifyCScCertificate(constant, vk, uint256(), cert, &vChecks));
+    ASSERT_TRUE(vChecks.size() == 1);
+
+    // Running the queued check performs the actual verification, which fails on a null vk
+    ASSERT_FALSE(vChecks[0]());
+}
+
+TEST(ZendooLib, VkCacheLru)
+{
+    libzendoomc::CScVkCache& vkCache = libzendoomc::CScVkCache::Instance();
+    vkCache.Clear();
+    vkCache.SetMaxEntries(2);
+
+    libzendoomc::CScVkCache::VkHandle vk;
+    libzendoomc::CScVkCache::FieldHandle constant;
+    const uint256 scId1 = uint256S("1"), scId2 = uint256S("2"), scId3 = uint256S("3");
+    const uint256 dataHash = uint256S("abcd");
+
+    vkCache.Put(scId1, dataHash, vk, constant);
+    vkCache.Put(scId2, dataHash, vk, constant);
+    ASSERT_TRUE(vkCache.Get(scId1, dataHash, vk, constant));
+
+    // an entry built from different serialized data is not returned
+    ASSERT_FALSE(vkCache.Get(scId1, uint256S("dcba"), vk, constant));
+
+    // scId2 is the least recently used one, hence it is evicted first
+    vkCache.Put(scId3, dataHash, vk, constant);
+    ASSERT_TRUE(vkCache.Size() == 2);
+    ASSERT_FALSE(vkCache.Get(scId2, dataHash, vk, constant));
+    ASSERT_TRUE(vkCache.Get(scId1, dataHash, vk, constant));
+    ASSERT_TRUE(vkCache.Get(scId3, dataHash, vk, constant));
+
+    vkCache.Erase(scId1);
+    ASSERT_FALSE(vkCache.Get(scId1, dataHash, vk, constant));
+
+    vkCache.Clear();
+    vkCache.SetMaxEntries(libzendoomc::CScVkCache::DEFAULT_MAX_ENTRIES);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include "arith_uint256.h"
+#include "clientversion.h"
+#include "mappedfile.h"
+#include "streams.h"
+#include "uint256.h"
+
+#include <boost/filesystem.hpp>
+
+class MappedFileTest : public ::testing::Test {
+protected:
+    boost::filesystem::path path;
+
+    void SetUp() override {
+        path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    }
+
+    void TearDown() override {
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+    }
+
+    void Append(const CDataStream& ss) {
+        // still creates the file when ss is empty, without indexing into it
+        FILE* file = fopen(path.string().c_str(), "ab");
+        ASSERT_TRUE(file != NULL);
+        if (!ss.empty())
+            ASSERT_EQ(fwrite(&ss[0], 1, ss.size(), file), ss.size());
+        fclose(file);
+    }
+};
+
+TEST_F(MappedFileTest, DeserializesFromTheMapping) {
+    EXPECT_TRUE(CMappedFile::Open(path) == nullptr);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    Append(ss);
+    // empty files are not mapped
+    EXPECT_TRUE(CMappedFile::Open(path) == nullptr);
+
+    std::vector<uint256> values(100);
+    for (unsigned int i = 0; i < values.size(); i++)
+        values[i] = ArithToUint256(arith_uint256(i * 1000 + 1));
+    ss << values << std::string("trailer");
+    Append(ss);
+
+    std::shared_ptr<const CMappedFile> pfile = CMappedFile::Open(path);
+    ASSERT_TRUE(pfile != nullptr);
+    ASSERT_EQ(pfile->size(), ss.size());
+
+    // what is appended later is not part of the mapping
+    CDataStream ssMore(SER_DISK, CLIENT_VERSION);
+    ssMore << values;
+    Append(ssMore);
+    // the mapping outlives the file
+    boost::filesystem::remove(path);
+
+    CSpanReader reader(pfile->data(), pfile->data() + pfile->size(), SER_DISK, CLIENT_VERSION);
+    std::vector<uint256> read;
+    reader >> read;
+    EXPECT_EQ(read, values);
+    std::string trailer;
+    reader >> trailer;
+    EXPECT_EQ(trailer, "trailer");
+    EXPECT_EQ(reader.size(), 0u);
+    EXPECT_THROW(reader >> trailer, std::ios_base::failure);
+
+    // readers only see their span
+    CSpanReader partial(pfile->data(), pfile->data() + 10, SER_DISK, CLIENT_VERSION);
+    EXPECT_THROW(partial >> read, std::ios_base::failure);
+}
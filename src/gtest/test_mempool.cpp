@@ -252,3 +252,105 @@ TEST(Mempool, SproutNegativeVersionTx) {
     }
 
 }
+
+static CTransaction makeSpendingTx(const uint256& prevHash, CAmount nValue)
+{
+    CMutableTransaction mtx;
+    mtx.nVersion = TRANSPARENT_TX_VERSION;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(prevHash, 0);
+    mtx.addOut(CTxOut(nValue, CScript() << OP_TRUE));
+    return CTransaction(mtx);
+}
+
+TEST(Mempool, TrimToSizeEvictsLowestFeeRateWithDescendants) {
+    CTxMemPool pool(CFeeRate(1000));
+
+    CTransaction parent = makeSpendingTx(uint256S("aa"), 10000);
+    CTransaction child  = makeSpendingTx(parent.GetHash(), 9000);
+    CTransaction other  = makeSpendingTx(uint256S("bb"), 10000);
+
+    pool.addUnchecked(parent.GetHash(), CTxMemPoolEntry(parent, /*fee*/100,   GetTime(), 0.0, 1));
+    pool.addUnchecked(child.GetHash(),  CTxMemPoolEntry(child,  /*fee*/50000, GetTime(), 0.0, 1));
+    pool.addUnchecked(other.GetHash(),  CTxMemPoolEntry(other,  /*fee*/10000, GetTime(), 0.0, 1));
+    EXPECT_EQ(pool.GetMinFee(1).GetFeePerK(), 0);
+
+    std::set<uint256> setDescendants;
+    pool.CalculateDescendants(parent.GetHash(), setDescendants);
+    EXPECT_EQ(setDescendants.size(), 2);
+
+    // the parent has the lowest fee rate, it goes away together with its child in spite of the child fee
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    EXPECT_FALSE(pool.existsTx(parent.GetHash()));
+    EXPECT_FALSE(pool.existsTx(child.GetHash()));
+    EXPECT_TRUE(pool.existsTx(other.GetHash()));
+
+    // the rolling minimum fee is bumped above the fee rate of the evicted package
+    CFeeRate packageRate(100 + 50000,
+        ::GetSerializeSize(parent, SER_NETWORK, PROTOCOL_VERSION) + ::GetSerializeSize(child, SER_NETWORK, PROTOCOL_VERSION));
+    EXPECT_EQ(pool.GetMinFee(1).GetFeePerK(), packageRate.GetFeePerK() + 1000);
+
+    // prioritisation moves a tx in the eviction order
+    CTransaction cheap = makeSpendingTx(uint256S("cc"), 10000);
+    pool.addUnchecked(cheap.GetHash(), CTxMemPoolEntry(cheap, /*fee*/100, GetTime(), 0.0, 1));
+    pool.PrioritiseTransaction(cheap.GetHash(), cheap.GetHash().ToString(), 0.0, 1000000);
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    EXPECT_TRUE(pool.existsTx(cheap.GetHash()));
+    EXPECT_FALSE(pool.existsTx(other.GetHash()));
+}
+
+TEST(Mempool, TrimToSizeDoesNotEvictCertificateDependencies) {
+    CTxMemPool pool(CFeeRate(1000));
+
+    CTransaction funding = makeSpendingTx(uint256S("aa"), 10000);
+    CTransaction other   = makeSpendingTx(uint256S("bb"), 10000);
+    pool.addUnchecked(funding.GetHash(), CTxMemPoolEntry(funding, /*fee*/1,     GetTime(), 0.0, 1));
+    pool.addUnchecked(other.GetHash(),   CTxMemPoolEntry(other,   /*fee*/10000, GetTime(), 0.0, 1));
+
+    CMutableScCertificate mcert;
+    mcert.scId = uint256S("1492");
+    mcert.vin.resize(1);
+    mcert.vin[0].prevout = COutPoint(funding.GetHash(), 0);
+    mcert.addOut(CTxOut(9000, CScript() << OP_TRUE));
+    CScCertificate cert(mcert);
+    pool.addUnchecked(cert.GetHash(), CCertificateMemPoolEntry(cert, /*fee*/1000, GetTime(), 0.0, 1));
+
+    pool.TrimToSize(0);
+    EXPECT_TRUE(pool.existsTx(funding.GetHash()));
+    EXPECT_TRUE(pool.existsCert(cert.GetHash()));
+    EXPECT_FALSE(pool.existsTx(other.GetHash()));
+}
+
+TEST(Mempool, ExpireRemovesOldTransactionsWithDescendants) {
+    CTxMemPool pool(CFeeRate(1000));
+    int64_t nNow = GetTime();
+
+    CTransaction oldParent = makeSpendingTx(uint256S("aa"), 10000);
+    CTransaction newChild  = makeSpendingTx(oldParent.GetHash(), 9000);
+    CTransaction recent    = makeSpendingTx(uint256S("bb"), 10000);
+    CTransaction funding   = makeSpendingTx(uint256S("cc"), 10000);
+
+    pool.addUnchecked(oldParent.GetHash(), CTxMemPoolEntry(oldParent, /*fee*/1000, nNow - 7200, 0.0, 1));
+    pool.addUnchecked(newChild.GetHash(),  CTxMemPoolEntry(newChild,  /*fee*/1000, nNow,        0.0, 1));
+    pool.addUnchecked(recent.GetHash(),    CTxMemPoolEntry(recent,    /*fee*/1000, nNow,        0.0, 1));
+    pool.addUnchecked(funding.GetHash(),   CTxMemPoolEntry(funding,   /*fee*/1000, nNow - 7200, 0.0, 1));
+
+    // a certificate spends an old tx, which must then survive expiry
+    CMutableScCertificate mcert;
+    mcert.scId = uint256S("1492");
+    mcert.vin.resize(1);
+    mcert.vin[0].prevout = COutPoint(funding.GetHash(), 0);
+    mcert.addOut(CTxOut(9000, CScript() << OP_TRUE));
+    CScCertificate cert(mcert);
+    pool.addUnchecked(cert.GetHash(), CCertificateMemPoolEntry(cert, /*fee*/1000, nNow - 7200, 0.0, 1));
+
+    EXPECT_EQ(pool.Expire(nNow - 7200), 0);
+
+    // the child goes away with its expired parent even if it is recent
+    EXPECT_EQ(pool.Expire(nNow - 3600), 2);
+    EXPECT_FALSE(pool.existsTx(oldParent.GetHash()));
+    EXPECT_FALSE(pool.existsTx(newChild.GetHash()));
+    EXPECT_TRUE(pool.existsTx(recent.GetHash()));
+    EXPECT_TRUE(pool.existsTx(funding.GetHash()));
+    EXPECT_TRUE(pool.existsCert(cert.GetHash()));
+}
@@ -0,0 +1,31 @@
+#include <gtest/gtest.h>
+
+#include "proofcache.h"
+#include "random.h"
+
+TEST(ProofCache, JoinSplitProofsAreCachedByTxHash) {
+    uint256 txHash = GetRandHash();
+
+    EXPECT_FALSE(IsJoinSplitProofsCached(txHash));
+    CacheJoinSplitProofs(txHash);
+    EXPECT_TRUE(IsJoinSplitProofsCached(txHash));
+
+    EXPECT_FALSE(IsJoinSplitProofsCached(GetRandHash()));
+}
+
+TEST(ProofCache, CertProofIsCachedForGivenVerificationData) {
+    uint256 certHash = GetRandHash();
+    uint256 vkDataHash = GetRandHash();
+    uint256 prevEndEpochBlockHash = GetRandHash();
+
+    EXPECT_FALSE(IsCertProofCached(certHash, vkDataHash, prevEndEpochBlockHash));
+    CacheCertProof(certHash, vkDataHash, prevEndEpochBlockHash);
+    EXPECT_TRUE(IsCertProofCached(certHash, vkDataHash, prevEndEpochBlockHash));
+
+    // same certificate verified against a different vk or chain is not a hit
+    EXPECT_FALSE(IsCertProofCached(certHash, GetRandHash(), prevEndEpochBlockHash));
+    EXPECT_FALSE(IsCertProofCached(certHash, vkDataHash, GetRandHash()));
+
+    // entries for joinsplits and certificates do not collide
+    EXPECT_FALSE(IsJoinSplitProofsCached(certHash));
+}
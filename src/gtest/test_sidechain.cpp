@@ -305,6 +305,26 @@ TEST_F(SidechainTestSuite, RevertingScCreationTxRemovesTheSc) {
     EXPECT_FALSE(sidechainsView->HaveSidechain(scId));
 }
 
+TEST_F(SidechainTestSuite, RevertingScCreationTxDropsCachedVk) {
+    CTransaction aTransaction = txCreationUtils::createNewSidechainTxWith(CAmount(10));
+    const uint256& scId = aTransaction.GetScIdFromScCcOut(0);
+    int scCreationHeight = 1;
+    CBlock aBlock;
+    sidechainsView->UpdateScInfo(aTransaction, aBlock, scCreationHeight);
+
+    libzendoomc::CScVkCache& vkCache = libzendoomc::CScVkCache::Instance();
+    vkCache.Clear();
+    vkCache.Put(scId, uint256S("aaaa"), libzendoomc::CScVkCache::VkHandle(), libzendoomc::CScVkCache::FieldHandle());
+    ASSERT_TRUE(vkCache.Size() == 1);
+
+    //test
+    bool res = sidechainsView->RevertTxOutputs(aTransaction, scCreationHeight);
+
+    //checks
+    EXPECT_TRUE(res);
+    EXPECT_TRUE(vkCache.Size() == 0);
+}
+
 TEST_F(SidechainTestSuite, RevertingFwdTransferRemovesCoinsFromImmatureBalance) {
     CTransaction aTransaction = txCreationUtils::createNewSidechainTxWith(CAmount(10));
     const uint256& scId = aTransaction.GetScIdFromScCcOut(0);
@@ -824,6 +844,42 @@ TEST_F(SidechainTestSuite, GetScIdsReturnsNonErasedSidechains) {
     EXPECT_TRUE(knownScIdsSet.count(scId2) == 0)<<"Actual count is "<<knownScIdsSet.count(scId2);
 }
 
+TEST_F(SidechainTestSuite, GetScIdsIsKeptUpToDateAcrossFlushes) {
+    CBlock aBlock;
+
+    int sc1CreationHeight(11);
+    CTransaction scTx1 = txCreationUtils::createNewSidechainTxWith(CAmount(1));
+    uint256 scId1 = scTx1.GetScIdFromScCcOut(0);
+    ASSERT_TRUE(sidechainsView->UpdateScInfo(scTx1, aBlock, sc1CreationHeight));
+    ASSERT_TRUE(sidechainsView->Flush());
+
+    // loads the ids known to the backing db
+    std::set<uint256> knownScIdsSet;
+    sidechainsView->GetScIds(knownScIdsSet);
+    ASSERT_TRUE(knownScIdsSet.size() == 1);
+
+    int sc2CreationHeight(33);
+    CTransaction scTx2 = txCreationUtils::createNewSidechainTxWith(CAmount(2));
+    uint256 scId2 = scTx2.GetScIdFromScCcOut(0);
+    ASSERT_TRUE(sidechainsView->UpdateScInfo(scTx2, aBlock, sc2CreationHeight));
+    ASSERT_TRUE(sidechainsView->Flush());
+
+    ASSERT_TRUE(sidechainsView->RevertTxOutputs(scTx1, sc1CreationHeight));
+    ASSERT_TRUE(sidechainsView->Flush());
+
+    //test
+    sidechainsView->GetScIds(knownScIdsSet);
+
+    //check
+    EXPECT_TRUE(knownScIdsSet.size() == 1)<<"Instead knowScIdSet size is "<<knownScIdsSet.size();
+    EXPECT_TRUE(knownScIdsSet.count(scId1) == 0)<<"Actual count is "<<knownScIdsSet.count(scId1);
+    EXPECT_TRUE(knownScIdsSet.count(scId2) == 1)<<"Actual count is "<<knownScIdsSet.count(scId2);
+
+    std::set<uint256> persistedScIdsSet;
+    fakeChainStateDb->GetScIds(persistedScIdsSet);
+    EXPECT_TRUE(persistedScIdsSet == knownScIdsSet);
+}
+
 TEST_F(SidechainTestSuite, GetScIdsOnChainstateDbSelectOnlySidechains) {
 
     //init a tmp chainstateDb
@@ -1026,3 +1082,45 @@ CBlockUndo SidechainTestSuite::createBlockUndoWith(const uint256 & scId, int hei
     return retVal;
 }
 
+
+TEST_F(SidechainTestSuite, ScMerklePathLeadsToTheScTxsCommitment) {
+    CTransaction scTx1 = txCreationUtils::createNewSidechainTxWith(CAmount(10));
+    CTransaction scTx2 = txCreationUtils::createNewSidechainTxWith(CAmount(20));
+    CTransaction scTx3 = txCreationUtils::createNewSidechainTxWith(CAmount(30));
+    const uint256& scId1 = scTx1.GetScIdFromScCcOut(0);
+    const uint256& scId2 = scTx2.GetScIdFromScCcOut(0);
+    const uint256& scId3 = scTx3.GetScIdFromScCcOut(0);
+
+    CBlock aBlock;
+    aBlock.vtx.push_back(scTx1);
+    aBlock.vtx.push_back(scTx2);
+    aBlock.vtx.push_back(scTx3);
+    aBlock.vtx.push_back(txCreationUtils::createFwdTransferTxWith(scId2, CAmount(5)));
+    aBlock.vcert.push_back(txCreationUtils::createCertificate(scId3, /*epochNum*/0, uint256S("aaaa"),
+        /*changeTotalAmount*/0, /*numChangeOut*/0, /*bwtTotalAmount*/1, /*numBwt*/1));
+
+    SidechainTxsCommitmentBuilder builder;
+    for (const CTransaction& tx : aBlock.vtx)
+        builder.add(tx);
+    for (const CScCertificate& cert : aBlock.vcert)
+        builder.add(cert);
+    const uint256 commitment = builder.getCommitment();
+    EXPECT_TRUE(commitment == aBlock.BuildScTxsCommitment());
+
+    for (const uint256& scId : {scId1, scId2, scId3})
+    {
+        uint256 ftHash, btrHash, wCertHash;
+        int nLeafIndex = -1;
+        std::vector<uint256> vBranch;
+        ASSERT_TRUE(builder.getScMerklePath(scId, ftHash, btrHash, wCertHash, nLeafIndex, vBranch));
+
+        const uint256 txsHash = Hash(BEGIN(ftHash), END(ftHash), BEGIN(btrHash), END(btrHash));
+        const uint256 leaf = Hash(BEGIN(txsHash), END(txsHash), BEGIN(wCertHash), END(wCertHash), BEGIN(scId), END(scId));
+        EXPECT_TRUE(CBlock::CheckMerkleBranch(leaf, vBranch, nLeafIndex) == commitment);
+    }
+
+    uint256 ftHash, btrHash, wCertHash;
+    int nLeafIndex = -1;
+    std::vector<uint256> vBranch;
+    EXPECT_FALSE(builder.getScMerklePath(uint256S("1492"), ftHash, btrHash, wCertHash, nLeafIndex, vBranch));
+}
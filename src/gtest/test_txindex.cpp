@@ -0,0 +1,369 @@
+#include <gtest/gtest.h>
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "crypto/equihash.h"
+#include "main.h"
+#include "pow.h"
+#include "streams.h"
+#include "tx_creation_utils.h"
+#include "txdb.h"
+#include "txindex.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validationinterface.h"
+
+#include <boost/filesystem.hpp>
+
+TEST(TxIndex, PositionsPointToTheSerializedTransactions) {
+    SelectParams(CBaseChainParams::REGTEST);
+
+    CBlock block;
+    block.nVersion = BLOCK_VERSION_SC_SUPPORT;
+    block.vtx.push_back(txCreationUtils::createCoinBase(CAmount(10)));
+    block.vtx.push_back(txCreationUtils::createTransparentTx());
+    block.vtx.push_back(txCreationUtils::createSproutTx());
+    for (int epoch = 0; epoch < 2; epoch++)
+        block.vcert.push_back(txCreationUtils::createCertificate(uint256S("aaaa"), epoch, uint256(),
+                                                                 CAmount(1), 1, CAmount(2), 2));
+
+    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+    GetTxIndexPositions(block, CDiskBlockPos(3, 100), vPos);
+    ASSERT_EQ(vPos.size(), block.vtx.size() + block.vcert.size());
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << block;
+    // offsets are counted from the end of the header, as GetTransaction reads them
+    size_t nHeaderSize = ::GetSerializeSize(CBlockHeader(block), SER_DISK, CLIENT_VERSION);
+    for (unsigned int i = 0; i < vPos.size(); i++) {
+        EXPECT_EQ(vPos[i].second.nFile, 3);
+        EXPECT_EQ(vPos[i].second.nPos, 100u);
+
+        CDataStream ssTx(ss.begin() + nHeaderSize + vPos[i].second.nTxOffset, ss.end(), SER_DISK, CLIENT_VERSION);
+        if (i < block.vtx.size()) {
+            CTransaction tx;
+            ssTx >> tx;
+            EXPECT_EQ(tx.GetHash(), vPos[i].first);
+            EXPECT_EQ(tx.GetHash(), block.vtx[i].GetHash());
+        } else {
+            CScCertificate cert;
+            ssTx >> cert;
+            EXPECT_EQ(cert.GetHash(), vPos[i].first);
+            EXPECT_EQ(cert.GetHash(), block.vcert[i - block.vtx.size()].GetHash());
+        }
+    }
+}
+
+// solve the header of a regtest block, as the generate rpc does, so that it can be read back from disk
+static void Mine(CBlock& block)
+{
+    const unsigned int n = Params().EquihashN();
+    const unsigned int k = Params().EquihashK();
+    crypto_generichash_blake2b_state eh_state;
+    EhInitialiseState(n, k, eh_state);
+    CEquihashInput I{block};
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << I;
+    crypto_generichash_blake2b_update(&eh_state, (unsigned char*)&ss[0], ss.size());
+
+    while (true) {
+        block.nNonce = ArithToUint256(UintToArith256(block.nNonce) + 1);
+        crypto_generichash_blake2b_state curr_state = eh_state;
+        crypto_generichash_blake2b_update(&curr_state, block.nNonce.begin(), block.nNonce.size());
+        std::function<bool(std::vector<unsigned char>)> validBlock = [&block](std::vector<unsigned char> soln) {
+            block.nSolution = soln;
+            return CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus());
+        };
+        if (EhBasicSolveUncancellable(n, k, curr_state, validBlock))
+            return;
+    }
+}
+
+// wait for the index thread, up to 30 seconds
+static bool WaitFor(std::function<bool()> predicate)
+{
+    for (int i = 0; i < 3000; i++) {
+        if (predicate())
+            return true;
+        MilliSleep(10);
+    }
+    return predicate();
+}
+
+/** Index recording the blocks it is given */
+class CTestIndex : public CBaseIndex
+{
+private:
+    mutable boost::mutex cs;
+    std::vector<const CBlockIndex*> vIndexed;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override
+    {
+        EXPECT_EQ(block.GetHash(), pindex->GetBlockHash());
+        boost::unique_lock<boost::mutex> lock(cs);
+        vIndexed.push_back(pindex);
+        return true;
+    }
+
+    std::string GetName() const override { return "testindex"; }
+
+public:
+    std::vector<const CBlockIndex*> GetIndexed() const
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        return vIndexed;
+    }
+
+    bool HasIndexed(const CBlockIndex* pindex) const
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        return !vIndexed.empty() && vIndexed.back() == pindex;
+    }
+};
+
+class BaseIndexTest : public ::testing::Test {
+protected:
+    boost::filesystem::path pathTemp;
+    //! end of the block file the blocks are appended to
+    unsigned int nBlockFileEnd;
+    unsigned int nBlocks;
+
+    void SetUp() override {
+        SelectParams(CBaseChainParams::REGTEST);
+        pathTemp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+        boost::filesystem::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+        ClearDatadirCache();
+
+        pblocktree = new CBlockTreeDB(1 << 20, true);
+        nBlockFileEnd = 0;
+        nBlocks = 0;
+    }
+
+    void TearDown() override {
+        StopTxIndex();
+        fTxIndex = false;
+        {
+            LOCK(cs_main);
+            chainActive.SetTip(NULL);
+            for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); ++it)
+                delete it->second;
+            mapBlockIndex.clear();
+        }
+        delete pblocktree;
+        pblocktree = NULL;
+
+        ClearDatadirCache();
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(pathTemp.string(), ec);
+    }
+
+    //! store a new block on top of pprev, returning its index entry
+    CBlockIndex* AddBlock(CBlockIndex* pprev)
+    {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].scriptSig = CScript() << ++nBlocks;
+        mtx.addOut(CTxOut(CAmount(1), CScript() << OP_TRUE));
+
+        CBlock block;
+        block.hashPrevBlock = pprev ? pprev->GetBlockHash() : uint256();
+        block.nTime = 1269211443 + nBlocks;
+        block.nBits = UintToArith256(Params().GetConsensus().powLimit).GetCompact();
+        block.vtx.push_back(mtx);
+        block.hashMerkleRoot = block.BuildMerkleTree();
+        Mine(block);
+
+        CDiskBlockPos pos(0, nBlockFileEnd);
+        EXPECT_TRUE(WriteBlockToDisk(block, pos, Params().MessageStart()));
+        nBlockFileEnd = pos.nPos + ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+
+        CBlockIndex* pindex = new CBlockIndex(block);
+        LOCK(cs_main);
+        BlockMap::iterator it = mapBlockIndex.insert(std::make_pair(block.GetHash(), pindex)).first;
+        pindex->phashBlock = &it->first;
+        pindex->pprev = pprev;
+        pindex->nHeight = pprev ? pprev->nHeight + 1 : 0;
+        pindex->nFile = pos.nFile;
+        pindex->nDataPos = pos.nPos;
+        pindex->nStatus |= BLOCK_HAVE_DATA;
+        pindex->BuildSkip();
+        return pindex;
+    }
+
+    //! store nCount blocks on top of pprev, returning the last one
+    CBlockIndex* AddBlocks(CBlockIndex* pprev, unsigned int nCount)
+    {
+        for (unsigned int i = 0; i < nCount; i++)
+            pprev = AddBlock(pprev);
+        return pprev;
+    }
+
+    //! make pindex the tip of the active chain, and notify it as ActivateBestChain does
+    static void SetTip(CBlockIndex* pindex)
+    {
+        {
+            LOCK(cs_main);
+            chainActive.SetTip(pindex);
+        }
+        GetMainSignals().ChainTip(pindex, NULL, ZCIncrementalMerkleTree(), true);
+    }
+
+    static void WriteBestBlock(const std::string& name, const CBlockIndex* pindex)
+    {
+        LOCK(cs_main);
+        ASSERT_TRUE(pblocktree->WriteBestIndexBlock(name, chainActive.GetLocator(pindex)));
+    }
+
+    //! the block of the active chain the stored locator of an index points to
+    static const CBlockIndex* ReadBestBlock(const std::string& name)
+    {
+        CBlockLocator locator;
+        if (!pblocktree->ReadBestIndexBlock(name, locator))
+            return NULL;
+        LOCK(cs_main);
+        return FindForkInGlobalIndex(chainActive, locator);
+    }
+
+    static bool HasTx(const CBlockIndex* pindex)
+    {
+        CBlock block;
+        CDiskTxPos pos;
+        return ReadBlockFromDisk(block, pindex) && pblocktree->ReadTxIndex(block.vtx[0].GetHash(), pos);
+    }
+};
+
+TEST_F(BaseIndexTest, IndexesFromTheGenesisAndFollowsTheTip) {
+    CBlockIndex* pindexTip = AddBlocks(NULL, 5);
+    SetTip(pindexTip);
+
+    CTestIndex index;
+    index.Start();
+    ASSERT_TRUE(WaitFor([&]() { return index.HasIndexed(pindexTip); }));
+    EXPECT_TRUE(WaitFor([&]() { return ReadBestBlock("testindex") == pindexTip; }));
+
+    CBlockIndex* pindexNew = AddBlocks(pindexTip, 2);
+    SetTip(pindexNew);
+    ASSERT_TRUE(WaitFor([&]() { return index.HasIndexed(pindexNew); }));
+    index.Stop();
+
+    std::vector<const CBlockIndex*> vIndexed = index.GetIndexed();
+    ASSERT_EQ(vIndexed.size(), 7u);
+    for (unsigned int i = 0; i < vIndexed.size(); i++)
+        EXPECT_EQ(vIndexed[i], chainActive[i]);
+    EXPECT_EQ(ReadBestBlock("testindex"), pindexNew);
+}
+
+TEST_F(BaseIndexTest, CatchesUpFromTheStoredLocator) {
+    CBlockIndex* pindexTip = AddBlocks(NULL, 8);
+    SetTip(pindexTip);
+    WriteBestBlock("testindex", chainActive[4]);
+
+    CTestIndex index;
+    index.Start();
+    ASSERT_TRUE(WaitFor([&]() { return index.HasIndexed(pindexTip); }));
+    index.Stop();
+
+    // only the blocks after the locator are indexed
+    std::vector<const CBlockIndex*> vIndexed = index.GetIndexed();
+    ASSERT_EQ(vIndexed.size(), 3u);
+    for (unsigned int i = 0; i < vIndexed.size(); i++)
+        EXPECT_EQ(vIndexed[i], chainActive[5 + i]);
+    EXPECT_EQ(ReadBestBlock("testindex"), pindexTip);
+
+    // started again at the tip, nothing is left to index
+    CTestIndex synced;
+    synced.Start();
+    synced.Stop();
+    EXPECT_TRUE(synced.GetIndexed().empty());
+    EXPECT_EQ(ReadBestBlock("testindex"), pindexTip);
+}
+
+TEST_F(BaseIndexTest, ResumesAfterTheForkPoint) {
+    CBlockIndex* pindexOld = AddBlocks(NULL, 8);
+    SetTip(pindexOld);
+    CBlockIndex* pindexFork = chainActive[4];
+
+    CTestIndex index;
+    index.Start();
+    ASSERT_TRUE(WaitFor([&]() { return index.HasIndexed(pindexOld); }));
+
+    // reorganized while running
+    CBlockIndex* pindexNew = AddBlocks(pindexFork, 4);
+    SetTip(pindexNew);
+    ASSERT_TRUE(WaitFor([&]() { return index.HasIndexed(pindexNew); }));
+    index.Stop();
+
+    std::vector<const CBlockIndex*> vIndexed = index.GetIndexed();
+    ASSERT_EQ(vIndexed.size(), 12u);
+    for (unsigned int i = 0; i < 4; i++)
+        EXPECT_EQ(vIndexed[8 + i], chainActive[5 + i]);
+    EXPECT_EQ(ReadBestBlock("testindex"), pindexNew);
+
+    // reorganized while stopped, from a locator of the stale branch
+    WriteBestBlock("testindex", pindexOld);
+    CTestIndex resumed;
+    resumed.Start();
+    ASSERT_TRUE(WaitFor([&]() { return resumed.HasIndexed(pindexNew); }));
+    resumed.Stop();
+
+    vIndexed = resumed.GetIndexed();
+    ASSERT_EQ(vIndexed.size(), 4u);
+    for (unsigned int i = 0; i < vIndexed.size(); i++)
+        EXPECT_EQ(vIndexed[i], chainActive[5 + i]);
+}
+
+TEST_F(BaseIndexTest, TxIndexResumesAtTheTipOfALegacyIndex) {
+    CBlockIndex* pindexTip = AddBlocks(NULL, 3);
+    SetTip(pindexTip);
+
+    // older versions only kept a flag, and indexed the blocks as they were connected
+    ASSERT_TRUE(pblocktree->WriteFlag("txindex", true));
+    CTxIndex legacy;
+    legacy.Start();
+    legacy.Stop();
+    EXPECT_EQ(ReadBestBlock("txindex"), pindexTip);
+    EXPECT_FALSE(HasTx(pindexTip));
+
+    CBlockIndex* pindexNew = AddBlock(pindexTip);
+    SetTip(pindexNew);
+    CTxIndex index;
+    index.Start();
+    ASSERT_TRUE(WaitFor([&]() { return ReadBestBlock("txindex") == pindexNew; }));
+    index.Stop();
+    EXPECT_TRUE(HasTx(pindexNew));
+    EXPECT_FALSE(HasTx(pindexTip));
+}
+
+TEST_F(BaseIndexTest, TxIndexCanBeTurnedOffAndOn) {
+    CBlockIndex* pindexTip = AddBlocks(NULL, 3);
+    SetTip(pindexTip);
+
+    fTxIndex = true;
+    StartTxIndex();
+    ASSERT_TRUE(WaitFor([&]() { return ReadBestBlock("txindex") == pindexTip; }));
+    StopTxIndex();
+    for (int i = 0; i <= pindexTip->nHeight; i++)
+        EXPECT_TRUE(HasTx(chainActive[i]));
+
+    // the blocks connected while turned off are indexed once turned on again
+    fTxIndex = false;
+    StartTxIndex();
+    bool fLegacy = true;
+    EXPECT_TRUE(pblocktree->ReadFlag("txindex", fLegacy));
+    EXPECT_FALSE(fLegacy);
+    CBlockIndex* pindexNew = AddBlocks(pindexTip, 2);
+    SetTip(pindexNew);
+    StopTxIndex();
+    EXPECT_FALSE(HasTx(pindexNew));
+
+    fTxIndex = true;
+    StartTxIndex();
+    ASSERT_TRUE(WaitFor([&]() { return ReadBestBlock("txindex") == pindexNew; }));
+    StopTxIndex();
+    for (int i = 0; i <= pindexNew->nHeight; i++)
+        EXPECT_TRUE(HasTx(chainActive[i]));
+}
@@ -11,7 +11,10 @@
 #include "utilstrencodings.h"
 #include "ui_interface.h"
 
+#include <memory>
+
 #include <boost/algorithm/string.hpp> // boost::trim
+#include <boost/bind.hpp>
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
@@ -75,6 +78,43 @@ static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const Uni
     req->WriteReply(nStatus, strReply);
 }
 
+/** Work item answering a deferred request, once its method is ready to */
+class HTTPRPCResumeItem : public HTTPClosure
+{
+public:
+    HTTPRPCResumeItem(const std::shared_ptr<HTTPRequest>& req, const UniValue& id, const boost::function<UniValue(void)>& resume):
+        req(req), id(id), resume(resume)
+    {
+    }
+    void operator()()
+    {
+        try {
+            UniValue result = resume();
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReply(HTTP_OK, JSONRPCReply(result, NullUniValue, id));
+        } catch (const UniValue& objError) {
+            JSONErrorReply(req.get(), objError, id);
+        } catch (const std::exception& e) {
+            JSONErrorReply(req.get(), JSONRPCError(RPC_MISC_ERROR, e.what()), id);
+        }
+    }
+
+private:
+    std::shared_ptr<HTTPRequest> req;
+    UniValue id;
+    boost::function<UniValue(void)> resume;
+};
+
+/** Called back, from any thread, when a deferred request can be answered */
+static void ResumeJSONRPC(std::shared_ptr<HTTPRequest> req, const UniValue& id, const boost::function<UniValue(void)>& resume)
+{
+    std::unique_ptr<HTTPRPCResumeItem> item(new HTTPRPCResumeItem(req, id, resume));
+    if (HTTPQueueWork(item.get()))
+        item.release(); /* if true, queue took ownership */
+    else
+        req->WriteReply(HTTP_INTERNAL_SERVER_ERROR, "Work queue depth exceeded");
+}
+
 static bool RPCAuthorized(const std::string& strAuth)
 {
     if (strRPCUserColonPass.empty()) // Belt-and-suspenders measure if InitRPCAuthentication was not called
@@ -127,7 +167,15 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
+            UniValue result;
+            try {
+                result = tableRPC.execute(jreq.strMethod, jreq.params, true);
+            } catch (const RPCDeferral& deferral) {
+                // Set the request aside rather than holding this worker thread until it can be answered
+                std::shared_ptr<HTTPRequest> deferred(req->Detach());
+                deferral.subscribe(boost::bind(&ResumeJSONRPC, deferred, jreq.id, deferral.resume));
+                return true;
+            }
 
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
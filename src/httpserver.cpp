@@ -647,6 +647,20 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
+HTTPRequest* HTTPRequest::Detach()
+{
+    assert(!replySent && req);
+    HTTPRequest* detached = new HTTPRequest(req);
+    replySent = true;
+    req = 0;
+    return detached;
+}
+
+bool HTTPQueueWork(HTTPClosure* item)
+{
+    return workQueue && workQueue->Enqueue(item);
+}
+
 void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
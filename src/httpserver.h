@@ -115,6 +115,13 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     virtual void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Move the request to a new object, e.g. to reply to it after the handler returned.
+     *
+     * @note This object is left without a request: do not call any of its methods afterwards.
+     */
+    HTTPRequest* Detach();
 };
 
 /** Event handler closure.
@@ -126,6 +133,11 @@ public:
     virtual ~HTTPClosure() {}
 };
 
+/** Run a closure on one of the HTTP worker threads, e.g. to resume a detached request.
+ * Returns true if the work queue took ownership of the closure, false if it is full.
+ */
+bool HTTPQueueWork(HTTPClosure* item);
+
 /** Event class. This can be used either as an cross-thread trigger or as a timer.
  */
 class HTTPEvent
@@ -59,6 +59,11 @@ public:
 
         batch.Delete(slKey);
     }
+
+    void Clear()
+    {
+        batch.Clear();
+    }
 };
 
 class CLevelDBWrapper
@@ -168,6 +173,12 @@ public:
     {
         return pdb->NewIterator(iteroptions);
     }
+
+    //! Iterator over a few adjacent keys, which populates the block cache as Read does
+    leveldb::Iterator* NewLookupIterator() const
+    {
+        return pdb->NewIterator(readoptions);
+    }
 };
 
 #endif // BITCOIN_LEVELDBWRAPPER_H
@@ -7,19 +7,26 @@
 
 #include "sodium.h"
 
+#include "addressindex.h"
 #include "addrman.h"
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockcache.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
 #include "consensus/validation.h"
 #include "deprecation.h"
 #include "init.h"
+#include "mappedfile.h"
 #include "merkleblock.h"
 #include "metrics.h"
 #include "net.h"
 #include "pow.h"
+#include "proofcache.h"
+#include "scindex.h"
+#include "spentindex.h"
+#include "timestampindex.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -65,13 +72,15 @@ BlockMap mapBlockIndex;
 CChain chainActive;
 CBlockIndex *pindexBestHeader = NULL;
 int64_t nTimeBestReceived = 0;
-CWaitableCriticalSection csBestBlock;
-CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 bool fExperimentalMode = false;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = false;
+bool fAddressIndex = DEFAULT_ADDRESSINDEX;
+bool fSpentIndex = DEFAULT_SPENTINDEX;
+bool fTimestampIndex = DEFAULT_TIMESTAMPINDEX;
+bool fScIndex = DEFAULT_SCINDEX;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = true;
@@ -583,6 +592,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewWriteBehind *pcoinsWriter = NULL;
 CBlockTreeDB *pblocktree = NULL;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -925,7 +935,7 @@ bool CheckCertificate(const CScCertificate& cert, CValidationState& state)
 
 
 bool CheckTransaction(const CTransaction& tx, CValidationState &state,
-                      libzcash::ProofVerifier& verifier)
+                      libzcash::ProofVerifier& verifier, std::vector<CJoinSplitCheck> *pvJoinSplitChecks)
 {
     // Don't count coinbase transactions because mining skews the count
     if (!tx.IsCoinBase()) {
@@ -935,11 +945,16 @@ bool CheckTransaction(const CTransaction& tx, CValidationState &state,
         return false;
     }
 
-    // Ensure that zk-SNARKs verify
-    BOOST_FOREACH(const JSDescription &joinsplit, tx.GetVjoinsplit()) {
-        if (!joinsplit.Verify(*pzcashParams, verifier, tx.joinSplitPubKey)) {
-            return state.DoS(100, error("CheckTransaction(): joinsplit does not verify"),
-                                REJECT_INVALID, "bad-txns-joinsplit-verification-failed");
+    // Ensure that zk-SNARKs verify, unless they already did when tx was accepted to mempool.
+    // If the caller collects JoinSplit checks, verification is deferred to them.
+    if (!tx.GetVjoinsplit().empty() && !IsJoinSplitProofsCached(tx.GetHash())) {
+        BOOST_FOREACH(const JSDescription &joinsplit, tx.GetVjoinsplit()) {
+            if (pvJoinSplitChecks) {
+                pvJoinSplitChecks->push_back(CJoinSplitCheck(joinsplit, tx.joinSplitPubKey, verifier));
+            } else if (!joinsplit.Verify(*pzcashParams, verifier, tx.joinSplitPubKey)) {
+                return state.DoS(100, error("CheckTransaction(): joinsplit does not verify"),
+                                    REJECT_INVALID, "bad-txns-joinsplit-verification-failed");
+            }
         }
     }
 
@@ -1028,6 +1043,22 @@ CAmount GetMinRelayFee(const CTransactionBase& tx, unsigned int nBytes, bool fAl
     return nMinFee;
 }
 
+static void LimitMempoolSize(CTxMemPool& pool, size_t limit)
+{
+    size_t nUsageBefore = pool.DynamicMemoryUsage();
+    if (nUsageBefore <= limit)
+        return;
+
+    // stale transactions go first, they would not be mined anyway
+    int nExpired = pool.Expire(GetTime() - GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+    if (nExpired != 0)
+        LogPrint("mempool", "%s():%d - expired %d transactions from the memory pool\n", __func__, __LINE__, nExpired);
+
+    pool.TrimToSize(limit);
+    LogPrint("mempool", "%s():%d - mempool usage %u => %u (limit %u)\n",
+        __func__, __LINE__, nUsageBefore, pool.DynamicMemoryUsage(), limit);
+}
+
 bool AcceptCertificateToMemoryPool(CTxMemPool& pool, CValidationState &state, const CScCertificate &cert, bool fLimitFree,
                         bool* pfMissingInputs, bool fRejectAbsurdFee, bool disconnecting)
 {
@@ -1183,6 +1214,17 @@ bool AcceptCertificateToMemoryPool(CTxMemPool& pool, CValidationState &state, co
                                     __func__, certHash.ToString(), nFees, txMinFee),
                             REJECT_INSUFFICIENTFEE, "insufficient fee");
 
+        // A full mempool raises the fee needed by relayed certificates as it does for transactions. Certificates
+        // submitted locally, which are most likely needed by their sidechain within the current epoch, are exempted
+        // and are never evicted once in the pool.
+        if (fLimitFree) {
+            CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+            if (mempoolRejectFee > 0 && nFees < mempoolRejectFee)
+                return state.DoS(0, error("%s(): mempool min fee not met %s, %d < %d",
+                                        __func__, certHash.ToString(), nFees, mempoolRejectFee),
+                                REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+        }
+
         // Require that free transactions have sufficient priority to be mined in the next block.
         if (GetBoolArg("-relaypriority", false) && nFees < ::minRelayTxFee.GetFee(nSize) && !AllowFree(view.GetPriority(cert, chainActive.Height() + 1))) {
             return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "insufficient priority");
@@ -1242,6 +1284,10 @@ bool AcceptCertificateToMemoryPool(CTxMemPool& pool, CValidationState &state, co
 
         // Store transaction in memory
         pool.addUnchecked(certHash, entry, !IsInitialBlockDownload());
+
+        // make room for the certificate, if needed. Certificates themselves are not evicted
+        if (!disconnecting)
+            LimitMempoolSize(pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
     }
 
     return true;
@@ -1266,6 +1312,10 @@ bool AcceptTxToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTran
     if (!CheckTransaction(tx, state, verifier))
         return error("%s(): CheckTransaction failed", __func__);
 
+    // spare the verification of the same proofs when the tx will be connected in a block
+    if (!tx.GetVjoinsplit().empty())
+        CacheJoinSplitProofs(tx.GetHash());
+
     // DoS level set to 10 to be more forgiving.
     // Check transaction contextually against the set of consensus rules which apply in the next block to be mined.
     if (!tx.ContextualCheck(state, nextBlockHeight, 10)) {
@@ -1444,6 +1494,19 @@ bool AcceptTxToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTran
                                 REJECT_INSUFFICIENTFEE, "insufficient fee");
         }
 
+        // Transactions resurrected from a disconnected block are let in anyway, the pool is trimmed afterwards
+        if (!disconnecting) {
+            double dPriorityDelta = 0;
+            CAmount nFeeDelta = 0;
+            pool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
+
+            CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+            if (mempoolRejectFee > 0 && nFees + nFeeDelta < mempoolRejectFee)
+                return state.DoS(0, error("%s(): mempool min fee not met %s, %d < %d",
+                                        __func__, hash.ToString(), nFees + nFeeDelta, mempoolRejectFee),
+                                REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+        }
+
         // Require that free transactions have sufficient priority to be mined in the next block.
         if (GetBoolArg("-relaypriority", false) && nFees < ::minRelayTxFee.GetFee(nSize) && !AllowFree(view.GetPriority(tx, chainActive.Height() + 1))) {
             return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "insufficient priority");
@@ -1503,6 +1566,13 @@ bool AcceptTxToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTran
 
         // Store transaction in memory
         pool.addUnchecked(hash, entry, !IsInitialBlockDownload());
+
+        // trim the mempool and check if tx was trimmed
+        if (!disconnecting) {
+            LimitMempoolSize(pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+            if (!pool.existsTx(hash))
+                return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+        }
     }
 
     return true;
@@ -1578,9 +1648,9 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock
     }
 
     if (pindexSlow) {
-        CBlock block;
-        if (ReadBlockFromDisk(block, pindexSlow)) {
-            BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+        std::shared_ptr<const CBlock> pblock = GetCachedBlock(pindexSlow);
+        if (pblock) {
+            BOOST_FOREACH(const CTransaction &tx, pblock->vtx) {
                 if (tx.GetHash() == hash) {
                     txOut = tx;
                     hashBlock = pindexSlow->GetBlockHash();
@@ -1639,9 +1709,9 @@ bool GetCertificate(const uint256 &hash, CScCertificate &certOut, uint256 &hashB
     }
 
     if (pindexSlow) {
-        CBlock block;
-        if (ReadBlockFromDisk(block, pindexSlow)) {
-            BOOST_FOREACH(const CScCertificate &cert, block.vcert) {
+        std::shared_ptr<const CBlock> pblock = GetCachedBlock(pindexSlow);
+        if (pblock) {
+            BOOST_FOREACH(const CScCertificate &cert, pblock->vcert) {
                 if (cert.GetHash() == hash) {
                     certOut = cert;
                     hashBlock = pindexSlow->GetBlockHash();
@@ -1654,6 +1724,60 @@ bool GetCertificate(const uint256 &hash, CScCertificate &certOut, uint256 &hashB
     return false;
 }
 
+bool GetAddressIndex(const uint160& addressHash, uint8_t type,
+                     std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex, int start, int end)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressUnspent(const uint160& addressHash, uint8_t type,
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& unspentOutputs)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    if (!fSpentIndex)
+        return false;
+
+    return pblocktree->ReadSpentIndex(key, value);
+}
+
+bool GetScIndex(const uint256& scId, std::vector<std::pair<CScIndexKey, CScIndexValue> >& scIndex, int start, int end)
+{
+    if (!fScIndex)
+        return error("sidechain index not enabled");
+
+    if (!pblocktree->ReadScIndex(scId, scIndex, start, end))
+        return error("unable to get activity for sidechain");
+
+    return true;
+}
+
+bool GetTimestampIndex(unsigned int high, unsigned int low, std::vector<uint256>& hashes)
+{
+    if (!fTimestampIndex)
+        return error("timestamp index not enabled");
+
+    if (!pblocktree->ReadTimestampIndex(high, low, hashes))
+        return error("unable to get hashes for timestamps");
+
+    return true;
+}
+
 
 
 
@@ -1685,18 +1809,126 @@ bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos, const CMessageHeader::M
     return true;
 }
 
+namespace {
+
+/** Maximum number of block and undo files kept mapped at the same time */
+static const size_t MAX_MAPPED_DISK_FILES = 64;
+
+/**
+ * Read-only mappings of the block and undo files before the last one, which are not appended to
+ * anymore, but for the undo data of the blocks connected after their block file was left: those
+ * are found by mapping the undo file again.
+ */
+class CDiskFileMappings
+{
+private:
+    typedef std::pair<std::string, int> FileKey;
+
+    struct MappedFile
+    {
+        std::shared_ptr<const CMappedFile> pfile;
+        uint64_t nLastUsed;
+    };
+
+    std::map<FileKey, MappedFile> mapFiles;
+    uint64_t nUseCount;
+    boost::mutex cs_mappings;
+
+public:
+    CDiskFileMappings(): nUseCount(0) {}
+
+    //! Mapping of the file of pos at least nMinSize bytes long; NULL if there is none
+    std::shared_ptr<const CMappedFile> Get(const CDiskBlockPos& pos, const char* prefix, uint64_t nMinSize)
+    {
+        const FileKey key(prefix, pos.nFile);
+        boost::unique_lock<boost::mutex> lock(cs_mappings);
+        std::map<FileKey, MappedFile>::iterator it = mapFiles.find(key);
+        if (it == mapFiles.end() || it->second.pfile->size() < nMinSize) {
+            std::shared_ptr<const CMappedFile> pfile = CMappedFile::Open(GetBlockPosFilename(pos, prefix));
+            if (!pfile || pfile->size() < nMinSize)
+                return std::shared_ptr<const CMappedFile>();
+            if (it == mapFiles.end()) {
+                if (mapFiles.size() >= MAX_MAPPED_DISK_FILES) {
+                    // readers still holding the least recently used mapping keep it alive
+                    std::map<FileKey, MappedFile>::iterator itOldest = mapFiles.begin();
+                    for (std::map<FileKey, MappedFile>::iterator itFile = mapFiles.begin(); itFile != mapFiles.end(); ++itFile)
+                        if (itFile->second.nLastUsed < itOldest->second.nLastUsed)
+                            itOldest = itFile;
+                    mapFiles.erase(itOldest);
+                }
+                it = mapFiles.insert(std::make_pair(key, MappedFile())).first;
+            }
+            it->second.pfile = pfile;
+        }
+        it->second.nLastUsed = ++nUseCount;
+        return it->second.pfile;
+    }
+
+    void Erase(int nFile)
+    {
+        boost::unique_lock<boost::mutex> lock(cs_mappings);
+        mapFiles.erase(FileKey("blk", nFile));
+        mapFiles.erase(FileKey("rev", nFile));
+    }
+
+    void Clear()
+    {
+        boost::unique_lock<boost::mutex> lock(cs_mappings);
+        mapFiles.clear();
+    }
+};
+
+CDiskFileMappings diskFileMappings;
+
+} // anon namespace
+
+/**
+ * Locate the record at pos of a block or undo file which is not appended to anymore, in a mapping of
+ * the file: false if the file is the last one, or cannot be mapped, so that it is read through stdio.
+ * Records are preceded by the network magic and their size, and followed by nTrailerSize bytes.
+ */
+static bool GetMappedRecord(const CDiskBlockPos& pos, const char* prefix, unsigned int nTrailerSize,
+                            std::shared_ptr<const CMappedFile>& pfile, const char*& pbegin, const char*& pend)
+{
+    {
+        LOCK(cs_LastBlockFile);
+        if (pos.IsNull() || pos.nFile >= nLastBlockFile)
+            return false;
+    }
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(uint32_t))
+        return false;
+
+    pfile = diskFileMappings.Get(pos, prefix, pos.nPos);
+    if (!pfile)
+        return false;
+    const uint64_t nEnd = pos.nPos + (uint64_t)ReadLE32((const unsigned char*)pfile->data() + pos.nPos - sizeof(uint32_t)) + nTrailerSize;
+    if (nEnd > pfile->size()) {
+        pfile = diskFileMappings.Get(pos, prefix, nEnd);
+        if (!pfile)
+            return false;
+    }
+    pbegin = pfile->data() + pos.nPos;
+    pend = pfile->data() + nEnd;
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-
-    // Read block
+    // Read block, straight from the mapping of its file unless it is still appended to
+    std::shared_ptr<const CMappedFile> pfile;
+    const char *pbegin, *pend;
     try {
-        filein >> block;
+        if (GetMappedRecord(pos, "blk", 0, pfile, pbegin, pend)) {
+            CSpanReader reader(pbegin, pend, SER_DISK, CLIENT_VERSION);
+            reader >> block;
+        } else {
+            CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+            filein >> block;
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
@@ -1720,6 +1952,25 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
     return true;
 }
 
+void GetTxIndexPositions(const CBlock& block, const CDiskBlockPos& blockPos, std::vector<std::pair<uint256, CDiskTxPos> >& vPos)
+{
+    CDiskTxPos pos(blockPos, GetSizeOfCompactSize(block.vtx.size()));
+    vPos.clear();
+    vPos.reserve(block.vtx.size() + block.vcert.size());
+    for (const CTransaction& tx : block.vtx) {
+        vPos.push_back(std::make_pair(tx.GetHash(), pos));
+        pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
+    }
+
+    // the certificates follow the size of vcert, if any
+    if (!block.vcert.empty())
+        pos.nTxOffset += GetSizeOfCompactSize(block.vcert.size());
+    for (const CScCertificate& cert : block.vcert) {
+        vPos.push_back(std::make_pair(cert.GetHash(), pos));
+        pos.nTxOffset += cert.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
+    }
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     CAmount nSubsidy = 12.5 * COIN;
@@ -2017,13 +2268,14 @@ CScriptCheck::CScriptCheck(): ptxTo(0), nIn(0), chain(nullptr),
                               error(SCRIPT_ERR_UNKNOWN_ERROR) {}
 CScriptCheck::CScriptCheck(const CCoins& txFromIn, const CTransactionBase& txToIn,
                            unsigned int nInIn, const CChain* chainIn,
-                           unsigned int nFlagsIn, bool cacheIn):
+                           unsigned int nFlagsIn, bool cacheIn,
+                           const std::shared_ptr<const PrecomputedTransactionData>& txdataIn):
                             scriptPubKey(txFromIn.vout[txToIn.GetVin()[nInIn].prevout.n].scriptPubKey),
                             ptxTo(&txToIn), nIn(nInIn), chain(chainIn), nFlags(nFlagsIn),
-                            cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR) { }
+                            cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
 
 bool CScriptCheck::operator()() {
-    return ptxTo->VerifyScript(scriptPubKey, nFlags, nIn, chain, cacheStore, &error); 
+    return ptxTo->VerifyScript(scriptPubKey, nFlags, nIn, chain, cacheStore, &error, txdata.get()); 
 }
 
 void CScriptCheck::swap(CScriptCheck &check) {
@@ -2034,10 +2286,23 @@ void CScriptCheck::swap(CScriptCheck &check) {
     std::swap(nFlags, check.nFlags);
     std::swap(cacheStore, check.cacheStore);
     std::swap(error, check.error);
+    txdata.swap(check.txdata);
 }
 
 ScriptError CScriptCheck::GetScriptError() const { return error; }
 
+bool CJoinSplitCheck::operator()() {
+    if (!pjoinsplit->Verify(*pzcashParams, *verifier, *pjoinSplitPubKey))
+        return error("CJoinSplitCheck(): joinsplit does not verify");
+    return true;
+}
+
+void CJoinSplitCheck::swap(CJoinSplitCheck &check) {
+    std::swap(pjoinsplit, check.pjoinsplit);
+    std::swap(pjoinSplitPubKey, check.pjoinSplitPubKey);
+    std::swap(verifier, check.verifier);
+}
+
 int GetSpendHeight(const CCoinsViewCache& inputs)
 {
     LOCK(cs_main);
@@ -2162,13 +2427,16 @@ bool ContextualCheckInputs(const CTransactionBase& tx, CValidationState &state,
         // before the last block chain checkpoint. This is safe because block merkle hashes are
         // still computed and checked, and any change will be caught at the next checkpoint.
         if (fScriptChecks) {
+            // serialize what all the signature hashes have in common once for all the inputs
+            std::shared_ptr<const PrecomputedTransactionData> txdata = std::make_shared<PrecomputedTransactionData>(tx);
+
             for (unsigned int i = 0; i < tx.GetVin().size(); i++) {
                 const COutPoint &prevout = tx.GetVin()[i].prevout;
                 const CCoins* coins = inputs.AccessCoins(prevout.hash);
                 assert(coins);
 
                 // Verify signature
-                CScriptCheck check(*coins, tx, i, &chain, flags, cacheStore);
+                CScriptCheck check(*coins, tx, i, &chain, flags, cacheStore, txdata);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -2184,7 +2452,7 @@ bool ContextualCheckInputs(const CTransactionBase& tx, CValidationState &state,
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
                         CScriptCheck check(*coins, tx, i, &chain,
-                                flags & ~STANDARD_CONTEXTUAL_NOT_MANDATORY_VERIFY_FLAGS, cacheStore);
+                                flags & ~STANDARD_CONTEXTUAL_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, txdata);
                         if (check())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
                     }
@@ -2235,16 +2503,22 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenBlockFile failed", __func__);
-
-    // Read block
+    // Read undo data and its checksum, from the mapping of the file unless it is still appended to
+    std::shared_ptr<const CMappedFile> pfile;
+    const char *pbegin, *pend;
     uint256 hashChecksum;
     try {
-        filein >> blockundo;
-        filein >> hashChecksum;
+        if (GetMappedRecord(pos, "rev", sizeof(uint256), pfile, pbegin, pend)) {
+            CSpanReader reader(pbegin, pend, SER_DISK, CLIENT_VERSION);
+            reader >> blockundo;
+            reader >> hashChecksum;
+        } else {
+            CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("%s: OpenBlockFile failed", __func__);
+            filein >> blockundo;
+            filein >> hashChecksum;
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s", __func__, e.what());
@@ -2283,7 +2557,195 @@ bool AbortNode(CValidationState& state, const std::string& strMessage, const std
 
 } // anon namespace
 
-bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view,
+namespace {
+/** Changes a block makes to the -addressindex, -spentindex and -scindex, written once the block is connected or disconnected */
+struct CIndexChanges
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+    std::vector<std::pair<CScIndexKey, CScIndexValue> > scIndex;
+
+    bool Write(bool fConnect) const
+    {
+        if (!addressIndex.empty() &&
+            !(fConnect ? pblocktree->WriteAddressIndex(addressIndex) : pblocktree->EraseAddressIndex(addressIndex)))
+            return false;
+        if (!addressUnspentIndex.empty() && !pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex))
+            return false;
+        if (!spentIndex.empty() && !pblocktree->UpdateSpentIndex(spentIndex))
+            return false;
+        return scIndex.empty() || (fConnect ? pblocktree->WriteScIndex(scIndex) : pblocktree->EraseScIndex(scIndex));
+    }
+};
+
+//! The address a script pays to, if it is one the address index knows of
+bool GetAddressIndexKey(const CScript& script, uint8_t& addressType, uint160& addressHash)
+{
+    CTxDestination dest;
+    if (!ExtractDestination(script, dest))
+        return false;
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        addressType = ADDRESS_INDEX_PUBKEYHASH;
+        addressHash = *keyID;
+        return true;
+    }
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        addressType = ADDRESS_INDEX_SCRIPTHASH;
+        addressHash = *scriptID;
+        return true;
+    }
+    return false;
+}
+
+//! The unspent index entry of an output of coins
+CAddressUnspentValue GetAddressUnspentValue(const CCoins& coins, unsigned int n)
+{
+    const CTxOut& txout = coins.vout[n];
+    bool fBwt = coins.IsFromCert() && (int)n >= coins.nFirstBwtPos;
+    return CAddressUnspentValue(txout.nValue, txout.scriptPubKey, coins.nHeight, fBwt ? coins.nBwtMaturityHeight : 0);
+}
+
+/**
+ * Index the outputs of a transaction or certificate at position nTxIndex of the block at nHeight,
+ * as created if fConnect, in which case coins are its outputs, or as removed otherwise.
+ */
+void IndexOutputs(const CTransactionBase& txBase, const CCoins* coins, int nHeight, unsigned int nTxIndex,
+                  bool fConnect, CIndexChanges& changes)
+{
+    if (!fAddressIndex)
+        return;
+
+    const uint256& hash = txBase.GetHash();
+    for (unsigned int k = 0; k < txBase.GetVout().size(); k++) {
+        const CTxOut& out = txBase.GetVout()[k];
+        uint8_t addressType;
+        uint160 addressHash;
+        if (!GetAddressIndexKey(out.scriptPubKey, addressType, addressHash))
+            continue;
+
+        changes.addressIndex.push_back(std::make_pair(
+            CAddressIndexKey(addressType, addressHash, nHeight, nTxIndex, hash, k, false), out.nValue));
+        CAddressUnspentValue value;
+        if (fConnect && coins && coins->IsAvailable(k))
+            value = GetAddressUnspentValue(*coins, k);
+        changes.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, addressHash, hash, k), value));
+    }
+}
+
+/**
+ * Index the inputs of a transaction or certificate at position nTxIndex of the block at nHeight, as spent if
+ * fConnect, or as unspent again otherwise, in which case view must hold the outputs they spent back.
+ * The inputs funding sidechain creations and forward transfers are indexed as any other.
+ */
+void IndexSpends(const CTransactionBase& txBase, const CTxUndo& txundo, const CCoinsViewCache& view, int nHeight,
+                 unsigned int nTxIndex, bool fConnect, CIndexChanges& changes)
+{
+    if (!fAddressIndex && !fSpentIndex)
+        return;
+
+    const uint256& hash = txBase.GetHash();
+    for (unsigned int j = 0; j < txBase.GetVin().size(); j++) {
+        const COutPoint& prevout = txBase.GetVin()[j].prevout;
+        const CTxOut& prevTxOut = txundo.vprevout[j].txout;
+        uint8_t addressType = ADDRESS_INDEX_NONE;
+        uint160 addressHash;
+        bool fAddress = GetAddressIndexKey(prevTxOut.scriptPubKey, addressType, addressHash);
+
+        if (fAddressIndex && fAddress) {
+            changes.addressIndex.push_back(std::make_pair(
+                CAddressIndexKey(addressType, addressHash, nHeight, nTxIndex, hash, j, true), -prevTxOut.nValue));
+            CAddressUnspentValue value;
+            if (!fConnect) {
+                const CCoins* coins = view.AccessCoins(prevout.hash);
+                if (coins && coins->IsAvailable(prevout.n))
+                    value = GetAddressUnspentValue(*coins, prevout.n);
+            }
+            changes.addressUnspentIndex.push_back(std::make_pair(
+                CAddressUnspentKey(addressType, addressHash, prevout.hash, prevout.n), value));
+        }
+
+        if (fSpentIndex) {
+            CSpentIndexValue value;
+            if (fConnect)
+                value = CSpentIndexValue(hash, j, nHeight, prevTxOut.nValue, addressType, addressHash);
+            changes.spentIndex.push_back(std::make_pair(CSpentIndexKey(prevout.hash, prevout.n), value));
+        }
+    }
+}
+
+/**
+ * Index the backward transfers which the sidechains ceasing at nHeight void, as spent by the block after all
+ * its transactions and certificates if fConnect, or as unspent again otherwise. view must hold the voided
+ * outputs, as it does before the sidechain events are handled, or after they are reverted.
+ */
+void IndexVoidedBwts(const CCoinsViewCache& view, int nHeight, unsigned int nTxIndex, bool fConnect,
+                     CIndexChanges& changes)
+{
+    CSidechainEvents scEvents;
+    if (!fAddressIndex || !view.GetSidechainEvents(nHeight, scEvents))
+        return;
+
+    for (const uint256& scId : scEvents.ceasingScs) {
+        CSidechain sidechain;
+        if (!view.GetSidechain(scId, sidechain) || sidechain.lastCertificateHash.IsNull())
+            continue;
+        const uint256& hash = sidechain.lastCertificateHash;
+        const CCoins* coins = view.AccessCoins(hash);
+        if (!coins || !coins->IsFromCert())
+            continue;
+
+        for (unsigned int pos = coins->nFirstBwtPos; pos < coins->vout.size(); pos++) {
+            uint8_t addressType;
+            uint160 addressHash;
+            if (!coins->IsAvailable(pos) || !GetAddressIndexKey(coins->vout[pos].scriptPubKey, addressType, addressHash))
+                continue;
+
+            changes.addressIndex.push_back(std::make_pair(
+                CAddressIndexKey(addressType, addressHash, nHeight, nTxIndex, hash, pos, true), -coins->vout[pos].nValue));
+            changes.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, addressHash, hash, pos),
+                fConnect ? CAddressUnspentValue() : GetAddressUnspentValue(*coins, pos)));
+        }
+    }
+}
+
+//! Index the sidechain creations and forward transfers of a transaction in the block at nHeight
+void IndexScActivity(const CTransaction& tx, int nHeight, CIndexChanges& changes)
+{
+    if (!fScIndex)
+        return;
+
+    const uint256& hash = tx.GetHash();
+    for (unsigned int k = 0; k < tx.GetVscCcOut().size(); k++) {
+        const CTxScCreationOut& scCreation = tx.GetVscCcOut()[k];
+        changes.scIndex.push_back(std::make_pair(CScIndexKey(scCreation.GetScId(), nHeight, SC_INDEX_CREATION, hash, k),
+                                                 CScIndexValue(scCreation.nValue, -1, scCreation.address, CScript())));
+    }
+    for (unsigned int k = 0; k < tx.GetVftCcOut().size(); k++) {
+        const CTxForwardTransferOut& fwdTransfer = tx.GetVftCcOut()[k];
+        changes.scIndex.push_back(std::make_pair(CScIndexKey(fwdTransfer.GetScId(), nHeight, SC_INDEX_FORWARD_TRANSFER, hash, k),
+                                                 CScIndexValue(fwdTransfer.nValue, -1, fwdTransfer.address, CScript())));
+    }
+}
+
+//! Index a certificate in the block at nHeight, and its backward transfers
+void IndexScActivity(const CScCertificate& cert, int nHeight, CIndexChanges& changes)
+{
+    if (!fScIndex)
+        return;
+
+    const uint256& hash = cert.GetHash();
+    changes.scIndex.push_back(std::make_pair(CScIndexKey(cert.GetScId(), nHeight, SC_INDEX_CERTIFICATE, hash, 0),
+                                             CScIndexValue(cert.GetValueOfBackwardTransfers(), cert.epochNumber, uint256(), CScript())));
+    for (unsigned int pos = cert.nFirstBwtPos; pos < cert.GetVout().size(); pos++) {
+        const CTxOut& out = cert.GetVout()[pos];
+        changes.scIndex.push_back(std::make_pair(CScIndexKey(cert.GetScId(), nHeight, SC_INDEX_BACKWARD_TRANSFER, hash, pos),
+                                                 CScIndexValue(out.nValue, cert.epochNumber, uint256(), out.scriptPubKey)));
+    }
+}
+} // anon namespace
+
+bool DisconnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view,
     bool* pfClean, std::vector<uint256>* pVoidedCertsList)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
@@ -2312,6 +2774,8 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
         return error("DisconnectBlock(): cannot revert sidechains scheduled events");
     }
 
+    CIndexChanges indexChanges;
+    IndexVoidedBwts(view, pindex->nHeight, block.vtx.size() + block.vcert.size(), false, indexChanges);
 
     // not including coinbase
     const int certOffset = block.vtx.size() - 1;
@@ -2378,6 +2842,10 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
             }
 
         }
+
+        IndexOutputs(cert, NULL, pindex->nHeight, block.vtx.size() + i, false, indexChanges);
+        IndexSpends(cert, certUndo, view, pindex->nHeight, block.vtx.size() + i, false, indexChanges);
+        IndexScActivity(cert, pindex->nHeight, indexChanges);
     }
 
     // undo transactions in reverse order
@@ -2449,12 +2917,23 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
                 }
 
             }
+            IndexSpends(tx, txundo, view, pindex->nHeight, i, false, indexChanges);
         }
+        IndexOutputs(tx, NULL, pindex->nHeight, i, false, indexChanges);
+        IndexScActivity(tx, pindex->nHeight, indexChanges);
     }
 
     // set the old best anchor back
     view.PopAnchor(blockUndo.old_tree_root);
 
+    // the indexes are left alone when only checking that the block can be disconnected, as VerifyDB does
+    if (!pfClean) {
+        if (!indexChanges.Write(false))
+            return AbortNode(state, "Failed to write address, spent or sidechain index");
+        if (fTimestampIndex && !pblocktree->EraseTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
+            return AbortNode(state, "Failed to write timestamp index");
+    }
+
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
@@ -2491,11 +2970,61 @@ void static FlushBlockFile(bool fFinalize = false)
 
 bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+// the scripts, proofs and block inputs of a block are checked and fetched by the same -par workers
+static CCheckQueueWorkers checkworkers;
+
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128, &checkworkers);
+
+void ExpireMempool()
+{
+    // cs_main first: validation code relies on mempool parents not vanishing between its mempool lookups
+    LOCK(cs_main);
+    int nExpired = mempool.Expire(GetTime() - GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+    if (nExpired != 0)
+        LogPrint("mempool", "%s():%d - expired %d transactions from the memory pool\n", __func__, __LINE__, nExpired);
+}
+
+// sc proofs are way more expensive than scripts, hand them out to workers one at a time
+static CCheckQueue<libzendoomc::CScCertProofCheck> scproofcheckqueue(1, &checkworkers);
+
+// the same goes for joinsplit proofs
+static CCheckQueue<CJoinSplitCheck> joinsplitcheckqueue(1, &checkworkers);
+
+// block inputs are looked up in the coins database before the block is connected
+static CCheckQueue<CCoinsFetchCheck> coinsfetchqueue(16, &checkworkers);
 
 void ThreadScriptCheck() {
     RenameThread("horizen-scriptch");
-    scriptcheckqueue.Thread();
+    checkworkers.Thread();
+}
+
+/**
+ * Warm pcoinsTip up with the coins spent by the block, reading them from the coins database in parallel,
+ * so that ConnectBlock does not wait for the disk at every input.
+ */
+static void PrefetchBlockInputs(const CBlock& block)
+{
+    std::set<uint256> setCreated;
+    for (const CTransaction& tx: block.vtx)
+        setCreated.insert(tx.GetHash());
+    for (const CScCertificate& cert: block.vcert)
+        setCreated.insert(cert.GetHash());
+
+    std::vector<uint256> vTxids;
+    for (const CTransaction& tx: block.vtx) {
+        if (tx.IsCoinBase())
+            continue;
+        for (const CTxIn& txin: tx.GetVin())
+            if (!setCreated.count(txin.prevout.hash))
+                vTxids.push_back(txin.prevout.hash);
+    }
+    for (const CScCertificate& cert: block.vcert) {
+        for (const CTxIn& txin: cert.GetVin())
+            if (!setCreated.count(txin.prevout.hash))
+                vTxids.push_back(txin.prevout.hash);
+    }
+
+    pcoinsTip->Prefetch(vTxids, nScriptCheckThreads ? &coinsfetchqueue : NULL);
 }
 
 //
@@ -2589,9 +3118,14 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     auto verifier = libzcash::ProofVerifier::Strict();
     auto disabledVerifier = libzcash::ProofVerifier::Disabled();
 
-    // Check it again to verify JoinSplit proofs, and in case a previous version let a bad block in
-    if (!CheckBlock(block, state, fExpensiveChecks ? verifier : disabledVerifier, !fJustCheck, !fJustCheck))
+    // Check it again to verify JoinSplit proofs, and in case a previous version let a bad block in.
+    // When we have worker threads, JoinSplit proofs are verified on them while the block is being connected
+    CCheckQueueControl<CJoinSplitCheck> joinSplitControl(fExpensiveChecks && nScriptCheckThreads ? &joinsplitcheckqueue : NULL);
+    std::vector<CJoinSplitCheck> vJoinSplitChecks;
+    if (!CheckBlock(block, state, fExpensiveChecks ? verifier : disabledVerifier, !fJustCheck, !fJustCheck,
+                    fExpensiveChecks && nScriptCheckThreads ? &vJoinSplitChecks : NULL))
         return false;
+    joinSplitControl.Add(vJoinSplitChecks);
 
     // verify that the view's current state corresponds to the previous block
     uint256 hashPrevBlock = pindex->pprev == NULL ? uint256() : pindex->pprev->GetBlockHash();
@@ -2635,14 +3169,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CBlockUndo blockundo;
 
     CCheckQueueControl<CScriptCheck> control(fExpensiveChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
+    CCheckQueueControl<libzendoomc::CScCertProofCheck> scProofControl(fExpensiveChecks && nScriptCheckThreads ? &scproofcheckqueue : NULL);
 
     int64_t nTimeStart = GetTimeMicros();
     CAmount nFees = 0;
     int nInputs = 0;
     unsigned int nSigOps = 0;
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
-    vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1 + block.vcert.size());
 
     // Construct the incremental merkle tree at the current
@@ -2664,6 +3196,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     }
 
     SidechainTxsCommitmentBuilder scCommitmentBuilder;
+    CIndexChanges indexChanges;
      
     for (unsigned int i = 0; i < block.vtx.size(); i++) // Processing transactions loop
     {
@@ -2700,8 +3233,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
             nFees += tx.GetFeeAmount(view.GetValueIn(tx));
 
+            // Signatures of a block being connected are not checked again: they are dropped from the signature cache,
+            // unless the block is only being checked, and is to be connected later
             std::vector<CScriptCheck> vChecks;
-            if (!ContextualCheckInputs(tx, state, view, fExpensiveChecks, chain, flags, false, chainparams.GetConsensus(), nScriptCheckThreads ? &vChecks : NULL))
+            if (!ContextualCheckInputs(tx, state, view, fExpensiveChecks, chain, flags, fJustCheck, chainparams.GetConsensus(), nScriptCheckThreads ? &vChecks : NULL))
                 return false;
 
             control.Add(vChecks);
@@ -2713,6 +3248,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
 
+        if (i > 0)
+            IndexSpends(tx, blockundo.vtxundo.back(), view, pindex->nHeight, i, true, indexChanges);
+        IndexOutputs(tx, view.AccessCoins(tx.GetHash()), pindex->nHeight, i, true, indexChanges);
+        IndexScActivity(tx, pindex->nHeight, indexChanges);
+
         if ( i > 0)
         {
             if (!view.UpdateScInfo(tx, block, pindex->nHeight) )
@@ -2749,9 +3289,6 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             }
         }
 
-        vPos.push_back(std::make_pair(tx.GetHash(), pos));
-        pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
-
         if (fCheckScTxesCommitment)
         {
             scCommitmentBuilder.add(tx);
@@ -2783,21 +3320,29 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         nFees += cert.GetFeeAmount(view.GetValueIn(cert));
 
         std::vector<CScriptCheck> vChecks;
-        if (!ContextualCheckInputs(cert, state, view, fExpensiveChecks, chain, flags, false, chainparams.GetConsensus(), nScriptCheckThreads ? &vChecks : NULL))
+        if (!ContextualCheckInputs(cert, state, view, fExpensiveChecks, chain, flags, fJustCheck, chainparams.GetConsensus(), nScriptCheckThreads ? &vChecks : NULL))
             return false;
 
         control.Add(vChecks);
 
+        // proof verification, when enabled, is deferred to the sc proof check queue and joined below
+        std::vector<libzendoomc::CScCertProofCheck> vProofChecks;
         auto scVerifier = fExpensiveChecks ? libzendoomc::CScProofVerifier::Strict() : libzendoomc::CScProofVerifier::Disabled();
-        if (!view.IsCertApplicableToState(cert, pindex->nHeight, state, scVerifier) ) {
+        if (!view.IsCertApplicableToState(cert, pindex->nHeight, state, scVerifier, nScriptCheckThreads ? &vProofChecks : NULL) ) {
             LogPrint("sc", "%s():%d - ERROR: cert=%s\n", __func__, __LINE__, cert.GetHash().ToString() );
             return state.DoS(100, error("ConnectBlock(): invalid sc certificate [%s]", cert.GetHash().ToString()),
                              REJECT_INVALID, "bad-sc-cert-not-applicable");
         }
 
+        scProofControl.Add(vProofChecks);
+
         blockundo.vtxundo.push_back(CTxUndo());
         UpdateCoins(cert, view, blockundo.vtxundo.back(), pindex->nHeight);
 
+        IndexSpends(cert, blockundo.vtxundo.back(), view, pindex->nHeight, block.vtx.size() + certIdx, true, indexChanges);
+        IndexOutputs(cert, view.AccessCoins(cert.GetHash()), pindex->nHeight, block.vtx.size() + certIdx, true, indexChanges);
+        IndexScActivity(cert, pindex->nHeight, indexChanges);
+
         if (!view.UpdateScInfo(cert, blockundo.vtxundo.back()) )
         {
             return state.DoS(100, error("ConnectBlock(): could not add in scView: cert[%s]", cert.GetHash().ToString()),
@@ -2812,25 +3357,14 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
         }
 
-
-        if (certIdx == 0) {
-            // we are processing the first certificate, add the size of the vcert to the offset
-            int sz = GetSizeOfCompactSize(block.vcert.size());
-            LogPrint("cert", "%s():%d - adding %d to nTxOffset\n", __func__, __LINE__, sz );
-            pos.nTxOffset += sz;
-            LogPrint("cert", "%s():%d - nTxOffset=%d\n", __func__, __LINE__, pos.nTxOffset );
-        }
-        vPos.push_back(std::make_pair(cert.GetHash(), pos));
-        pos.nTxOffset += cert.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
-
         if (fCheckScTxesCommitment)
         {
             scCommitmentBuilder.add(cert);
         }
-
-        LogPrint("cert", "%s():%d - nTxOffset=%d\n", __func__, __LINE__, pos.nTxOffset );
     } //end of Processing certificates loop
 
+    IndexVoidedBwts(view, pindex->nHeight, block.vtx.size() + block.vcert.size(), true, indexChanges);
+
     if (!view.HandleSidechainEvents(pindex->nHeight, blockundo, pVoidedCertList))
     {
         LogPrint("cert", "%s():%d - SIDECHAIN-EVENT: failed handling scheduled event\n", __func__, __LINE__);
@@ -2878,6 +3412,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
     if (!control.Wait())
         return state.DoS(100, false);
+    if (!scProofControl.Wait())
+        return state.DoS(100, error("ConnectBlock(): sc certificate proof verification failed"),
+                         REJECT_INVALID, "bad-sc-cert-proof-not-verified");
+    if (!joinSplitControl.Wait())
+        return state.DoS(100, error("ConnectBlock(): joinsplit does not verify"),
+                         REJECT_INVALID, "bad-txns-joinsplit-verification-failed");
     int64_t nTime2 = GetTimeMicros(); nTimeVerify += nTime2 - nTimeStart;
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime2 - nTimeStart), nInputs <= 1 ? 0 : 0.001 * (nTime2 - nTimeStart) / (nInputs-1), nTimeVerify * 0.000001);
 
@@ -2907,9 +3447,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return AbortNode(state, "Failed to write transaction index");
+    if (!indexChanges.Write(true))
+        return AbortNode(state, "Failed to write address, spent or sidechain index");
+
+    if (fTimestampIndex)
+        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
+            return AbortNode(state, "Failed to write timestamp index");
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -3022,8 +3565,14 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         // overwrite one. Still, use a conservative safety factor of 2.
         if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
-        // Flush the chainstate (which may refer to block index entries).
-        if (!pcoinsTip->Flush())
+        // Flush the chainstate (which may refer to block index entries). Coins are kept in memory, unless the
+        // cache has grown too large: then leave some headroom, not to flush again a few blocks later.
+        size_t nMaxCacheUsage = (fCacheLarge || fCacheCritical) ? nCoinCacheUsage / 100 * COINS_CACHE_TRIM_PERCENT : nCoinCacheUsage;
+        if (!pcoinsTip->Sync(nMaxCacheUsage))
+            return AbortNode(state, "Failed to write to coin database");
+        // The coins database is written in the background, unless the chainstate on disk must be
+        // up to date on return (e.g. at shutdown) or block files are being pruned away.
+        if (pcoinsWriter && (mode == FLUSH_STATE_ALWAYS || fFlushForPrune) && !pcoinsWriter->WaitForWrite())
             return AbortNode(state, "Failed to write to coin database");
         nLastFlush = nNow;
     }
@@ -3068,8 +3617,6 @@ void static UpdateTip(CBlockIndex *pindexNew) {
       chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(), log(chainActive.Tip()->nChainWork.getdouble())/log(2.0), (unsigned long)chainActive.Tip()->nChainTx,
       DateTimeStrFormat("%Y-%m-%d %H:%M:%S", chainActive.Tip()->GetBlockTime()),
       syncProgress, pcoinsTip->DynamicMemoryUsage() * (1.0 / (1<<20)), pcoinsTip->GetCacheSize());
-
-    cvBlockChange.notify_all();
 }
 
 /** Disconnect chainActive's tip. */
@@ -3077,10 +3624,11 @@ bool static DisconnectTip(CValidationState &state) {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
     mempool.check(pcoinsTip);
-    // Read block from disk.
-    CBlock block;
-    if (!ReadBlockFromDisk(block, pindexDelete))
+    // Read block from disk, unless it was connected recently.
+    std::shared_ptr<const CBlock> pblock = GetCachedBlock(pindexDelete);
+    if (!pblock)
         return AbortNode(state, "Failed to read block");
+    const CBlock& block = *pblock;
     // Apply the block atomically to the chain state.
     uint256 anchorBeforeDisconnect = pcoinsTip->GetBestAnchor();
     int64_t nStart = GetTimeMicros();
@@ -3138,6 +3686,9 @@ bool static DisconnectTip(CValidationState &state) {
     // remove any certificate, and possible dependancies, that refers to this block as end epoch
     mempool.removeOutOfEpochCertificates(pindexDelete);
 
+    // resurrected transactions bypassed the size limit
+    LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+
     mempool.check(pcoinsTip);
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev);
@@ -3164,6 +3715,7 @@ bool static DisconnectTip(CValidationState &state) {
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -3173,16 +3725,17 @@ static int64_t nTimePostConnect = 0;
  * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
  */
-bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *pblock) {
+bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, const CBlock *pblock) {
     assert(pindexNew->pprev == chainActive.Tip());
     mempool.check(pcoinsTip);
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
-    CBlock block;
+    std::shared_ptr<const CBlock> pblockRead;
     if (!pblock) {
-        if (!ReadBlockFromDisk(block, pindexNew))
+        pblockRead = GetBlockToConnect(pindexNew);
+        if (!pblockRead)
             return AbortNode(state, "Failed to read block");
-        pblock = &block;
+        pblock = pblockRead.get();
     }
     // Get the current commitment tree
     ZCIncrementalMerkleTree oldTree;
@@ -3191,6 +3744,10 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    PrefetchBlockInputs(*pblock);
+    int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetch += nTimePrefetched - nTime2;
+    LogPrint("bench", "  - Prefetch inputs: %.2fms [%.2fs]\n", (nTimePrefetched - nTime2) * 0.001, nTimePrefetch * 0.000001);
+    nTime2 = nTimePrefetched;
     std::vector<uint256> voidedCertList;
     {
         CCoinsViewCache view(pcoinsTip);
@@ -3225,6 +3782,9 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
     mempool.check(pcoinsTip);
     // Update chainActive & related variables.
     UpdateTip(pindexNew);
+    // The notifications of the new tip will all fetch it
+    if (!pblockRead)
+        CacheConnectedBlock(*pblock);
 
     // Tell wallet about transactions and certificates that went from mempool to conflicted:
     for(const CTransaction &tx: removedTxs) {
@@ -3900,7 +4460,7 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool f
 
 bool CheckBlock(const CBlock& block, CValidationState& state,
                 libzcash::ProofVerifier& verifier,
-                bool fCheckPOW, bool fCheckMerkleRoot)
+                bool fCheckPOW, bool fCheckMerkleRoot, std::vector<CJoinSplitCheck> *pvJoinSplitChecks)
 {
     // These are checks that are independent of context.
 
@@ -3945,7 +4505,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state,
 
     // Check transactions and certificates
     for(const CTransaction& tx: block.vtx) {
-        if (!CheckTransaction(tx, state, verifier)) {
+        if (!CheckTransaction(tx, state, verifier, pvJoinSplitChecks)) {
             return error("CheckBlock(): CheckTransaction failed");
         }
     }
@@ -4345,6 +4905,7 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune)
         CDiskBlockPos pos(*it, 0);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
+        diskFileMappings.Erase(*it);
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
     }
 }
@@ -4564,9 +5125,14 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadReindexing(fReindexing);
     fReindex |= fReindexing;
 
-    // Check whether we have a transaction index
-    pblocktree->ReadFlag("txindex", fTxIndex);
-    LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("spentindex", fSpentIndex);
+    LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
+    LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("scindex", fScIndex);
+    LogPrintf("%s: sidechain index %s\n", __func__, fScIndex ? "enabled" : "disabled");
 
     // Fill in-memory data
     BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex)
@@ -4713,6 +5279,7 @@ void UnloadBlockIndex()
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
+    diskFileMappings.Clear();
     nBlockSequenceId = 1;
     mapBlockSource.clear();
     mapBlocksInFlight.clear();
@@ -4750,9 +5317,15 @@ bool InitBlockIndex() {
     if (chainActive.Genesis() != NULL)
         return true;
 
-    // Use the provided setting for -txindex in the new database
-    fTxIndex = GetBoolArg("-txindex", false);
-    pblocktree->WriteFlag("txindex", fTxIndex);
+    // Use the provided settings for the address, spent, timestamp and sidechain indexes in the new database
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    pblocktree->WriteFlag("addressindex", fAddressIndex);
+    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    pblocktree->WriteFlag("spentindex", fSpentIndex);
+    fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    pblocktree->WriteFlag("timestampindex", fTimestampIndex);
+    fScIndex = GetBoolArg("-scindex", DEFAULT_SCINDEX);
+    pblocktree->WriteFlag("scindex", fScIndex);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -38,16 +38,25 @@
 
 #include <boost/unordered_map.hpp>
 
+struct CAddressIndexKey;
+struct CAddressUnspentKey;
+struct CAddressUnspentValue;
 class CBlockIndex;
 class CBlockTreeDB;
+class CCoinsViewWriteBehind;
 class CBloomFilter;
 class CInv;
 class CScriptCheck;
+class CJoinSplitCheck;
 class CValidationInterface;
 class CValidationState;
 class CTxUndo;
 struct CNodeStateStats;
 class CTxInUndo;
+struct CScIndexKey;
+struct CScIndexValue;
+struct CSpentIndexKey;
+struct CSpentIndexValue;
 
 /** Default for -blockmaxsize and -blockminsize, which control the range of sizes the mining code will create **/
 static const unsigned int DEFAULT_BLOCK_MAX_SIZE = MAX_BLOCK_SIZE;
@@ -68,6 +77,17 @@ static const unsigned int MAX_STANDARD_TX_SIGOPS = MAX_BLOCK_SIGOPS/5;
 static const unsigned int DEFAULT_MIN_RELAY_TX_FEE = 100;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -maxmempool, maximum megabytes of mempool memory usage */
+static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
+/** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
+static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
+/** How often, in seconds, expired transactions are removed from the mempool */
+static const int64_t MEMPOOL_EXPIRY_INTERVAL = 10 * 60;
+/** Defaults for -addressindex, -spentindex, -timestampindex and -scindex, which can only be changed by reindexing */
+static const bool DEFAULT_ADDRESSINDEX = false;
+static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_TIMESTAMPINDEX = false;
+static const bool DEFAULT_SCINDEX = false;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -94,6 +114,8 @@ static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
 static const unsigned int DATABASE_FLUSH_INTERVAL = 24 * 60 * 60;
+/** When the coins cache outgrows -dbcache, it is trimmed to this percentage of its limit after being flushed */
+static const unsigned int COINS_CACHE_TRIM_PERCENT = 75;
 /** Maximum length of reject messages. */
 static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 /* Maximum number of heigths meaningful when looking for block finality */
@@ -115,13 +137,15 @@ extern BlockMap mapBlockIndex;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockSize;
 extern const std::string strMessageMagic;
-extern CWaitableCriticalSection csBestBlock;
-extern CConditionVariable cvBlockChange;
 extern bool fExperimentalMode;
 extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
+extern bool fTimestampIndex;
+extern bool fScIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
@@ -223,8 +247,10 @@ bool ProcessMessages(CNode* pfrom);
  * @param[in]   fSendTrickle    When true send the trickled data, otherwise trickle the data until true.
  */
 bool SendMessages(CNode* pto, bool fSendTrickle);
-/** Run an instance of the script checking thread */
+/** Run an instance of the thread checking scripts and proofs, and fetching block inputs */
 void ThreadScriptCheck();
+/** Remove transactions older than -mempoolexpiry hours from the mempool, run periodically by the scheduler */
+void ExpireMempool();
 /** Try to detect Partition (network isolation) attacks against us */
 void PartitionCheck(bool (*initialDownloadCheck)(), CCriticalSection& cs, const CBlockIndex *const &bestHeader, int64_t nPowTargetSpacing);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
@@ -235,6 +261,20 @@ std::string GetWarnings(const std::string& strFor);
 bool GetTransaction(const uint256 &hash, CTransaction &tx, uint256 &hashBlock, bool fAllowSlow = false);
 /** Retrieve a certificate (from memory pool, or from disk, if possible) */
 bool GetCertificate(const uint256 &hash, CScCertificate &cert, uint256 &hashBlock, bool fAllowSlow = false);
+/** Retrieve the changes to the balance of an address from the -addressindex, between the given heights if end is not 0 */
+bool GetAddressIndex(const uint160& addressHash, uint8_t type,
+                     std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                     int start = 0, int end = 0);
+/** Retrieve the unspent outputs paying an address from the -addressindex */
+bool GetAddressUnspent(const uint160& addressHash, uint8_t type,
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& unspentOutputs);
+/** Retrieve the input spending an output from the -spentindex */
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
+/** Retrieve the activity of a sidechain from the -scindex, between the given heights if end is not 0 */
+bool GetScIndex(const uint256& scId, std::vector<std::pair<CScIndexKey, CScIndexValue> >& scIndex,
+                int start = 0, int end = 0);
+/** Retrieve the hashes of the active chain blocks with low <= time < high from the -timestampindex */
+bool GetTimestampIndex(unsigned int high, unsigned int low, std::vector<uint256>& hashes);
 /** Find the best known block, and make it the tip of the block chain */
 bool ActivateBestChain(CValidationState &state, CBlock *pblock = NULL);
 /** Find an alternative chain tip and propagate to the network */
@@ -385,7 +425,8 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache &inputs, CTxUndo& txund
 void UpdateCoins(const CScCertificate& cert, CCoinsViewCache &inputs, CTxUndo& txundo, int nHeight);
 
 /** Context-independent validity checks */
-bool CheckTransaction(const CTransaction& tx, CValidationState& state, libzcash::ProofVerifier& verifier);
+bool CheckTransaction(const CTransaction& tx, CValidationState& state, libzcash::ProofVerifier& verifier,
+                      std::vector<CJoinSplitCheck> *pvJoinSplitChecks = NULL);
 bool CheckCertificate(const CScCertificate& cert, CValidationState& state);
 bool CheckTransactionWithoutProofVerification(const CTransaction& tx, CValidationState &state);
 
@@ -423,20 +464,44 @@ private:
     unsigned int nFlags;
     bool cacheStore;
     ScriptError error;
+    //! shared by the checks of all the inputs of ptxTo
+    std::shared_ptr<const PrecomputedTransactionData> txdata;
 
 public:
     CScriptCheck();
-    CScriptCheck(const CCoins& txFromIn, const CTransactionBase& txToIn, unsigned int nInIn, const CChain* chainIn, unsigned int nFlagsIn, bool cacheIn);
+    CScriptCheck(const CCoins& txFromIn, const CTransactionBase& txToIn, unsigned int nInIn, const CChain* chainIn, unsigned int nFlagsIn, bool cacheIn,
+                 const std::shared_ptr<const PrecomputedTransactionData>& txdataIn = nullptr);
     bool operator()();
     void swap(CScriptCheck &check);
     ScriptError GetScriptError() const;
 };
 
+/**
+ * Closure representing one JoinSplit proof verification
+ * Note that this stores references to the joinsplit, its transaction and the verifier
+ */
+class CJoinSplitCheck
+{
+private:
+    const JSDescription *pjoinsplit;
+    const uint256 *pjoinSplitPubKey;
+    libzcash::ProofVerifier *verifier;
+
+public:
+    CJoinSplitCheck(): pjoinsplit(nullptr), pjoinSplitPubKey(nullptr), verifier(nullptr) {}
+    CJoinSplitCheck(const JSDescription& joinsplitIn, const uint256& joinSplitPubKeyIn, libzcash::ProofVerifier& verifierIn):
+        pjoinsplit(&joinsplitIn), pjoinSplitPubKey(&joinSplitPubKeyIn), verifier(&verifierIn) {}
+    bool operator()();
+    void swap(CJoinSplitCheck &check);
+};
+
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
+/** Position on disk of the transactions and certificates of a block stored at blockPos, for the transaction index */
+void GetTxIndexPositions(const CBlock& block, const CDiskBlockPos& blockPos, std::vector<std::pair<uint256, CDiskTxPos> >& vPos);
 
 
 /** Functions for validating blocks and updating the block tree */
@@ -445,7 +510,7 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
  *  In case pfClean is provided, operation will try to be tolerant about errors, and *pfClean
  *  will be true if no problems were found. Otherwise, the return value will be false in case
  *  of problems. Note that in any case, coins may be modified. */
-bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins,
+bool DisconnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins,
     bool* pfClean = NULL, std::vector<uint256>* pVoidedCertList = nullptr);
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins */
@@ -456,7 +521,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
 bool CheckBlock(const CBlock& block, CValidationState& state,
                 libzcash::ProofVerifier& verifier,
-                bool fCheckPOW = true, bool fCheckMerkleRoot = true);
+                bool fCheckPOW = true, bool fCheckMerkleRoot = true,
+                std::vector<CJoinSplitCheck> *pvJoinSplitChecks = NULL);
 
 /** Context-dependent validity checks */
 bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex *pindexPrev);
@@ -555,6 +621,9 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Background writer of the chainstate flushes, below pcoinsTip, if any (protected by cs_main) */
+extern CCoinsViewWriteBehind *pcoinsWriter;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
@@ -0,0 +1,47 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "mappedfile.h"
+
+#include "util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    munmap(const_cast<char*>(pdata), nSize);
+#endif
+}
+
+std::shared_ptr<const CMappedFile> CMappedFile::Open(const boost::filesystem::path& path)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return std::shared_ptr<const CMappedFile>();
+
+    struct stat st;
+    void* pdata = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        pdata = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file open
+    close(fd);
+    if (pdata == MAP_FAILED) {
+        LogPrint("db", "%s():%d - could not map %s\n", __func__, __LINE__, path.string());
+        return std::shared_ptr<const CMappedFile>();
+    }
+
+    // blocks are mostly read in order (reindex, rescan, verifychain, peers syncing from us)
+    madvise(pdata, st.st_size, MADV_SEQUENTIAL);
+    return std::shared_ptr<const CMappedFile>(new CMappedFile(static_cast<const char*>(pdata), st.st_size));
+#else
+    return std::shared_ptr<const CMappedFile>();
+#endif
+}
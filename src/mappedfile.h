@@ -0,0 +1,42 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MAPPEDFILE_H
+#define BITCOIN_MAPPEDFILE_H
+
+#include <memory>
+#include <stddef.h>
+
+#include <boost/filesystem/path.hpp>
+
+/**
+ * Read-only memory mapping of a whole file. Reading a record of the file then only costs the page
+ * faults of the pages not in the page cache yet, instead of a seek and copies through stdio. The
+ * mapping shows what is written to the file meanwhile, up to the size the file had when mapped,
+ * and stays valid as long as the object lives, even if the file is removed.
+ */
+class CMappedFile
+{
+private:
+    const char* pdata;
+    size_t nSize;
+
+    CMappedFile(const char* pdataIn, size_t nSizeIn): pdata(pdataIn), nSize(nSizeIn) {}
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+public:
+    ~CMappedFile();
+
+    /**
+     * Map the file at path, telling the kernel it is going to be read sequentially; NULL if it is
+     * empty or cannot be mapped (always on Windows)
+     */
+    static std::shared_ptr<const CMappedFile> Open(const boost::filesystem::path& path);
+
+    const char* data() const { return pdata; }
+    size_t size() const { return nSize; }
+};
+
+#endif // BITCOIN_MAPPEDFILE_H
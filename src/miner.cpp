@@ -39,6 +39,7 @@
 #include <functional>
 #endif
 #include <mutex>
+#include <tuple>
 #include <init.h>
 #include <undo.h>
 
@@ -300,48 +301,6 @@ void GetBlockCertPriorityData(const CBlock *pblock, int nHeight, const CCoinsVie
     }
 }
 
-void GetBlockTxPriorityData(const CBlock *pblock, int nHeight, int64_t nMedianTimePast, const CCoinsViewCache& view,
-                               vector<TxPriority>& vecPriority, list<COrphan>& vOrphan, map<uint256, vector<COrphan*> >& mapDependers)
-{
-    for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin();
-         mi != mempool.mapTx.end(); ++mi)
-    {
-        const CTransaction& tx = mi->second.GetTx();
-
-        int64_t nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
-                ? nMedianTimePast
-                : pblock->GetBlockTime();
-
-        if (tx.IsCoinBase() || !IsFinalTx(tx, nHeight, nLockTimeCutoff))
-            continue;
-
-        CAmount nTotalIn = 0;
-        COrphan* porphan = nullptr;
-
-        if (!GetTxInputsDependencies(tx, nTotalIn, nHeight, vOrphan, mapDependers, porphan) )
-        {
-            if (porphan)
-                vOrphan.pop_back();
-            continue;
-        }
-
-        if (!VerifyForwardTransfersDependencies(tx, view, vOrphan, mapDependers, porphan) )
-        {
-            if (porphan)
-                vOrphan.pop_back();
-            continue;
-        }
-
-        const CMemPoolEntry& mpEntry = mi->second;
-        if (!AddTxToPriorities(tx, view, nTotalIn, nHeight, mpEntry, vecPriority, porphan) )
-        {
-            if (porphan)
-                vOrphan.pop_back();
-            continue;
-        }
-    }
-}
-
 void GetBlockTxPriorityDataOld(const CBlock *pblock, int nHeight, int64_t nMedianTimePast, const CCoinsViewCache& view,
                                vector<TxPriority>& vecPriority, list<COrphan>& vOrphan, map<uint256, vector<COrphan*> >& mapDependers)
 {
@@ -436,6 +395,257 @@ void GetBlockTxPriorityDataOld(const CBlock *pblock, int nHeight, int64_t nMedia
     }
 }
 
+/**
+ * The mempool transactions and certificates CreateNewBlock picks from, together with what it needs to know
+ * about each of them, kept up to date through the mempool notifications instead of being gathered again from
+ * the whole mempool for every template. The candidates are also kept ordered by priority and by fee rate: only
+ * the entries which changed get their place recomputed, unless the tip moved, as priorities depend on the height.
+ * All of it is guarded by the cs of the followed pool.
+ */
+class CBlockTemplateCandidates
+{
+public:
+    struct Candidate
+    {
+        const CMemPoolEntry* pentry;
+        const CTransactionBase* ptx;
+        unsigned int nTxSize;
+        //! false for entries which can never make it into a block, as coinbases or entries spending backward transfers
+        bool fSelectable;
+        //! the pool entries which must be in the block first: the ones it spends and the creation of the sidechains it sends to
+        std::set<uint256> setParents;
+        std::set<uint256> setChildren;
+        //! whether dPriority and feeRate, including the prioritisation deltas, are up to date and the entry is in the orders
+        bool fOrdered;
+        double dPriority;
+        CFeeRate feeRate;
+
+        Candidate(): pentry(nullptr), ptx(nullptr), nTxSize(0), fSelectable(false), fOrdered(false), dPriority(0) {}
+    };
+
+    typedef std::tuple<double, CFeeRate, uint256> PriorityKey;
+    typedef std::tuple<CFeeRate, double, uint256> FeeKey;
+    //! both orders go from the best candidate to the worst
+    typedef std::set<PriorityKey, std::greater<PriorityKey> > PriorityOrder;
+    typedef std::set<FeeKey, std::greater<FeeKey> > FeeOrder;
+
+private:
+    CTxMemPool* pool;
+    boost::signals2::scoped_connection connAdded;
+    boost::signals2::scoped_connection connRemoved;
+    boost::signals2::scoped_connection connPrioritised;
+
+    std::map<uint256, Candidate> mapCandidates;
+    PriorityOrder setByPriority;
+    FeeOrder setByFee;
+    std::set<uint256> setUnordered;
+
+    //! the block the orders are for
+    const CBlockIndex* pindexOrdered;
+    int nHeightOrdered;
+
+    void Unorder(const uint256& hash, Candidate& candidate)
+    {
+        if (candidate.fOrdered) {
+            setByPriority.erase(PriorityKey(candidate.dPriority, candidate.feeRate, hash));
+            setByFee.erase(FeeKey(candidate.feeRate, candidate.dPriority, hash));
+            candidate.fOrdered = false;
+        }
+        setUnordered.insert(hash);
+    }
+
+    void Order(const uint256& hash, Candidate& candidate, int nHeight, const CCoinsViewCache& view)
+    {
+        const CTransactionBase& txBase = *candidate.ptx;
+        double dPriority = 0;
+        CAmount nFee = candidate.pentry->GetFee();
+
+        if (candidate.setParents.empty()) {
+            dPriority = candidate.pentry->GetPriority(nHeight);
+        } else {
+            // Priority is sum(valuein * age) / modified_txsize, over the inputs already in the chain
+            for (const CTxIn& txin : txBase.GetVin()) {
+                if (pool->mapTx.count(txin.prevout.hash) || pool->mapCertificate.count(txin.prevout.hash))
+                    continue;
+                const CCoins* coins = view.AccessCoins(txin.prevout.hash);
+                if (!coins || !coins->IsAvailable(txin.prevout.n))
+                    continue;
+                dPriority += (double)coins->vout[txin.prevout.n].nValue * (nHeight - coins->nHeight);
+            }
+            dPriority = txBase.ComputePriority(dPriority, candidate.nTxSize);
+        }
+        pool->ApplyDeltas(hash, dPriority, nFee);
+
+        candidate.dPriority = dPriority;
+        candidate.feeRate = CFeeRate(nFee, candidate.nTxSize);
+        candidate.fOrdered = true;
+        setByPriority.insert(PriorityKey(candidate.dPriority, candidate.feeRate, hash));
+        setByFee.insert(FeeKey(candidate.feeRate, candidate.dPriority, hash));
+    }
+
+    void Added(const uint256& hash)
+    {
+        AssertLockHeld(pool->cs);
+        Removed(hash);
+
+        Candidate candidate;
+        auto itTx = pool->mapTx.find(hash);
+        if (itTx != pool->mapTx.end()) {
+            candidate.pentry = &itTx->second;
+            candidate.ptx = &itTx->second.GetTx();
+        } else {
+            auto itCert = pool->mapCertificate.find(hash);
+            if (itCert == pool->mapCertificate.end())
+                return;
+            candidate.pentry = &itCert->second;
+            candidate.ptx = &itCert->second.GetCertificate();
+        }
+        const CTransactionBase& txBase = *candidate.ptx;
+        candidate.nTxSize = txBase.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
+        candidate.fSelectable = !txBase.IsCoinBase();
+
+        for (const CTxIn& txin : txBase.GetVin()) {
+            auto itCert = pool->mapCertificate.find(txin.prevout.hash);
+            if (itCert != pool->mapCertificate.end()) {
+                // - tx cannot spend any output of a certificate in mempool, neither change nor backward transfer
+                // - certificate can only spend change outputs of another certificate in mempool, while backward transfers must mature first
+                if (!txBase.IsCertificate() || itCert->second.GetCertificate().IsBackwardTransfer(txin.prevout.n)) {
+                    LogPrintf("%s():%d - ERROR: [%s] has unspendable input that is an unconfirmed certificate [%s] output %d\n",
+                        __func__, __LINE__, hash.ToString(), txin.prevout.hash.ToString(), txin.prevout.n);
+                    candidate.fSelectable = false;
+                }
+                candidate.setParents.insert(txin.prevout.hash);
+            } else if (pool->mapTx.count(txin.prevout.hash)) {
+                candidate.setParents.insert(txin.prevout.hash);
+            }
+        }
+
+        if (!txBase.IsCertificate()) {
+            const CTransaction& tx = dynamic_cast<const CTransaction&>(txBase);
+            for (const auto& ft : tx.GetVftCcOut()) {
+                auto itSc = pool->mapSidechains.find(ft.scId);
+                if (itSc != pool->mapSidechains.end() && !itSc->second.scCreationTxHash.IsNull() && itSc->second.scCreationTxHash != hash)
+                    candidate.setParents.insert(itSc->second.scCreationTxHash);
+            }
+            // entries may be back in the pool after the ones depending on them, when a block gets disconnected
+            for (const auto& sc : tx.GetVscCcOut()) {
+                auto itSc = pool->mapSidechains.find(sc.GetScId());
+                if (itSc == pool->mapSidechains.end())
+                    continue;
+                for (const uint256& fwdHash : itSc->second.fwdTransfersSet)
+                    if (fwdHash != hash)
+                        candidate.setChildren.insert(fwdHash);
+            }
+        }
+        for (unsigned int i = 0; i < txBase.GetVout().size(); i++) {
+            auto itNext = pool->mapNextTx.find(COutPoint(hash, i));
+            if (itNext != pool->mapNextTx.end())
+                candidate.setChildren.insert(itNext->second.ptx->GetHash());
+        }
+
+        for (const uint256& parent : candidate.setParents) {
+            auto it = mapCandidates.find(parent);
+            if (it != mapCandidates.end())
+                it->second.setChildren.insert(hash);
+        }
+        for (const uint256& child : candidate.setChildren) {
+            auto it = mapCandidates.find(child);
+            if (it != mapCandidates.end()) {
+                it->second.setParents.insert(hash);
+                Unorder(child, it->second);
+            }
+        }
+
+        Unorder(hash, mapCandidates[hash] = candidate);
+    }
+
+    void Removed(const uint256& hash)
+    {
+        auto it = mapCandidates.find(hash);
+        if (it == mapCandidates.end())
+            return;
+        Candidate& candidate = it->second;
+        Unorder(hash, candidate);
+        setUnordered.erase(hash);
+
+        for (const uint256& parent : candidate.setParents) {
+            auto itParent = mapCandidates.find(parent);
+            if (itParent != mapCandidates.end())
+                itParent->second.setChildren.erase(hash);
+        }
+        // the priority of the children is computed differently once they have no parent left in the pool
+        for (const uint256& child : candidate.setChildren) {
+            auto itChild = mapCandidates.find(child);
+            if (itChild != mapCandidates.end()) {
+                itChild->second.setParents.erase(hash);
+                Unorder(child, itChild->second);
+            }
+        }
+        mapCandidates.erase(it);
+    }
+
+    void Prioritised(const uint256& hash)
+    {
+        auto it = mapCandidates.find(hash);
+        if (it != mapCandidates.end())
+            Unorder(hash, it->second);
+    }
+
+public:
+    CBlockTemplateCandidates(): pool(nullptr), pindexOrdered(nullptr), nHeightOrdered(0) {}
+
+    //! Start following poolIn, loading what it already holds
+    void Follow(CTxMemPool& poolIn)
+    {
+        AssertLockHeld(poolIn.cs);
+        if (pool == &poolIn)
+            return;
+
+        mapCandidates.clear();
+        setByPriority.clear();
+        setByFee.clear();
+        setUnordered.clear();
+        pindexOrdered = nullptr;
+
+        pool = &poolIn;
+        connAdded = pool->NotifyEntryAdded.connect([this](const uint256& hash) { Added(hash); });
+        connRemoved = pool->NotifyEntryRemoved.connect([this](const uint256& hash) { Removed(hash); });
+        connPrioritised = pool->NotifyEntryPrioritised.connect([this](const uint256& hash) { Prioritised(hash); });
+        for (const auto& entry : pool->mapTx)
+            Added(entry.first);
+        for (const auto& entry : pool->mapCertificate)
+            Added(entry.first);
+    }
+
+    //! Bring the orders up to date for a block at nHeight on top of pindexPrev, whose inputs view holds
+    void UpdateOrder(const CBlockIndex* pindexPrev, int nHeight, const CCoinsViewCache& view)
+    {
+        AssertLockHeld(pool->cs);
+        if (pindexPrev != pindexOrdered || nHeight != nHeightOrdered) {
+            setByPriority.clear();
+            setByFee.clear();
+            setUnordered.clear();
+            for (auto& entry : mapCandidates) {
+                entry.second.fOrdered = false;
+                Order(entry.first, entry.second, nHeight, view);
+            }
+            pindexOrdered = pindexPrev;
+            nHeightOrdered = nHeight;
+            LogPrint("mempool", "%s():%d - ordered %u candidates for height %d\n", __func__, __LINE__, mapCandidates.size(), nHeight);
+        } else {
+            for (const uint256& hash : setUnordered)
+                Order(hash, mapCandidates.at(hash), nHeight, view);
+        }
+        setUnordered.clear();
+    }
+
+    const PriorityOrder& ByPriority() const { return setByPriority; }
+    const FeeOrder& ByFee() const { return setByFee; }
+    const Candidate& Get(const uint256& hash) const { return mapCandidates.at(hash); }
+};
+
+static CBlockTemplateCandidates templateCandidates;
+
 CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn)
 {
     // Block complexity is a sum of block transactions complexity. Transaction complexisty equals to number of inputs squared.
@@ -498,22 +708,8 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
 
         CCoinsViewCache view(pcoinsTip);
 
-        // Priority order to process transactions
-        list<COrphan> vOrphan; // list memory doesn't move
-        map<uint256, vector<COrphan*> > mapDependers;
         bool fPrintPriority = GetBoolArg("-printpriority", false);
-
-        // This vector will be sorted into a priority queue:
-        vector<TxPriority> vecPriority;
-        vecPriority.reserve(mempool.size()); // both tx and cert
-
         bool fDeprecatedGetBlockTemplate = GetBoolArg("-deprecatedgetblocktemplate", false);
-        if (fDeprecatedGetBlockTemplate)
-            GetBlockTxPriorityDataOld(pblock, nHeight, nMedianTimePast, view, vecPriority, vOrphan, mapDependers);
-        else
-            GetBlockTxPriorityData(pblock, nHeight, nMedianTimePast, view, vecPriority, vOrphan, mapDependers);
-
-        GetBlockCertPriorityData(pblock, nHeight, view, vecPriority, vOrphan, mapDependers);
 
         // Collect transactions into block
         uint64_t nBlockSize = 1000;
@@ -522,37 +718,20 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
         bool fSortedByFee = (nBlockPrioritySize <= 0);
 
         TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-
-#if 0
-        for (auto entry : vecPriority)
-        {
-            LogPrint("sc", "%s():%d - tx[%s] prio[%f], feerate[%s]\n",
-                __func__, __LINE__, (entry.get<2>())->GetHash().ToString(), entry.get<0>(), entry.get<1>().ToString());
-        }
-#endif
 
-        // considering certs having a higher priority than any possible tx.
-        // An algorithm for managing tx/cert priorities could be devised
-        while (!vecPriority.empty())
+        // Add tx to the block, unless it does not fit or is not valid on top of what the block already holds.
+        // Once past the priority size, or out of high-priority transactions, switch to sorting by fee.
+        auto TryAddToBlock = [&](const CTransactionBase& tx, double dPriority, const CFeeRate& feeRate) -> bool
         {
-            // Take highest priority transaction off the priority queue:
-            double dPriority = vecPriority.front().get<0>();
-            CFeeRate feeRate = vecPriority.front().get<1>();
-            const CTransactionBase& tx = *(vecPriority.front().get<2>());
-
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
-
             // Size limits
             unsigned int nTxSize = tx.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION);
             if (nBlockSize + nTxSize >= nBlockMaxSize)
-                continue;
+                return false;
 
             // Legacy limits on sigOps:
             unsigned int nTxSigOps = GetLegacySigOpCount(tx);
             if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
-                continue;
+                return false;
 
             const uint256& hash = tx.GetHash();
 
@@ -564,7 +743,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
             {
                 LogPrint("sc", "%s():%d - Skipping [%s] because it is free (feeDelta=%lld/feeRate=%s, blsz=%u/txsz=%u/blminsz=%u)\n",
                     __func__, __LINE__, tx.GetHash().ToString(), nFeeDelta, feeRate.ToString(), nBlockSize, nTxSize, nBlockMinSize );
-                continue;
+                return false;
             }
 
             // Prioritise by fee once past the priority size or we run out of high-priority
@@ -574,36 +753,28 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
             {
                 fSortedByFee = true;
                 comparer = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
             }
 
             // Skip transaction if max block complexity reached.
             int nTxComplexity = tx.GetVin().size() * tx.GetVin().size();
             if (!fDeprecatedGetBlockTemplate && nBlockMaxComplexitySize > 0 && nBlockComplexity + nTxComplexity >= nBlockMaxComplexitySize)
-                continue;
+                return false;
 
             if (!view.HaveInputs(tx))
             {
                 LogPrint("sc", "%s():%d - Skipping [%s] because it has no inputs\n",
                     __func__, __LINE__, tx.GetHash().ToString() );
-                continue;
+                return false;
             }
 
             CAmount nTxFees = tx.GetFeeAmount(view.GetValueIn(tx));
-#if 0
-            if (nTxFees < 0) {
-                LogPrintf("%s():%d - tx=%s has a negative fee (fee=%s)\n",
-                    __func__, __LINE__, tx.GetHash().ToString(), FormatMoney(nTxFees));
-                continue;
-            }
-#endif
 
             nTxSigOps += GetP2SHSigOpCount(tx, view);
             if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
             {
                 LogPrint("sc", "%s():%d - Skipping [%s] because too many sigops in block\n",
                     __func__, __LINE__, tx.GetHash().ToString() );
-                continue;
+                return false;
             }
 
             // Note that flags: we don't want to set mempool/IsStandard()
@@ -611,7 +782,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
             // create only contains transactions that are valid in new blocks.
             CValidationState state;
             if (!tx.ContextualCheckInputs(state, view, true, chainActive, MANDATORY_SCRIPT_VERIFY_FLAGS | SCRIPT_VERIFY_CHECKBLOCKATHEIGHT, true, Params().GetConsensus()))
-                continue;
+                return false;
 
             CTxUndo dummyUndo;
             try {
@@ -625,16 +796,10 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
                 assert("could not cast txbase obj" == 0);
             }
 
-
             // Added
-#if 0
-            pblock->vtx.push_back(tx);
-            pblocktemplate->vTxFees.push_back(nTxFees);
-            pblocktemplate->vTxSigOps.push_back(nTxSigOps);
-#else
             tx.AddToBlock(pblock);
             tx.AddToBlockTemplate(pblocktemplate.get(), nTxFees, nTxSigOps);
-#endif
+
             nBlockSize += nTxSize;
             ++nBlockTx;
             nBlockSigOps += nTxSigOps;
@@ -646,36 +811,183 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn,  unsigned int nBlo
                 LogPrintf("priority %.1f fee %d feeRate %s txid %s\n",
                     dPriority, nTxFees, feeRate.ToString(), tx.GetHash().ToString());
             }
+            return true;
+        };
+
+        if (fDeprecatedGetBlockTemplate)
+        {
+            // Priority order to process transactions
+            list<COrphan> vOrphan; // list memory doesn't move
+            map<uint256, vector<COrphan*> > mapDependers;
+
+            // This vector will be sorted into a priority queue:
+            vector<TxPriority> vecPriority;
+            vecPriority.reserve(mempool.size()); // both tx and cert
+
+            GetBlockTxPriorityDataOld(pblock, nHeight, nMedianTimePast, view, vecPriority, vOrphan, mapDependers);
+            GetBlockCertPriorityData(pblock, nHeight, view, vecPriority, vOrphan, mapDependers);
+
+            std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
 
-            // Add transactions that depend on this one to the priority queue
-            if (mapDependers.count(hash))
+            // considering certs having a higher priority than any possible tx.
+            // An algorithm for managing tx/cert priorities could be devised
+            while (!vecPriority.empty())
             {
-                LogPrint("sc", "%s():%d - tx[%s] has %d orphans\n",
-                    __func__, __LINE__, hash.ToString(), mapDependers[hash].size());
-                BOOST_FOREACH(COrphan* porphan, mapDependers[hash])
+                // Take highest priority transaction off the priority queue:
+                double dPriority = vecPriority.front().get<0>();
+                CFeeRate feeRate = vecPriority.front().get<1>();
+                const CTransactionBase& tx = *(vecPriority.front().get<2>());
+
+                std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
+                vecPriority.pop_back();
+
+                bool fWasSortedByFee = fSortedByFee;
+                bool fAdded = TryAddToBlock(tx, dPriority, feeRate);
+                if (fSortedByFee != fWasSortedByFee)
+                    std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
+                if (!fAdded)
+                    continue;
+
+                // Add transactions that depend on this one to the priority queue
+                const uint256& hash = tx.GetHash();
+                if (mapDependers.count(hash))
                 {
-                    if (!porphan->setDependsOn.empty())
+                    LogPrint("sc", "%s():%d - tx[%s] has %d orphans\n",
+                        __func__, __LINE__, hash.ToString(), mapDependers[hash].size());
+                    BOOST_FOREACH(COrphan* porphan, mapDependers[hash])
                     {
-                        porphan->setDependsOn.erase(hash);
-                        LogPrint("sc", "%s():%d - erasing tx[%s] frim orphan %p\n", __func__, __LINE__, hash.ToString(), porphan);
-                        if (porphan->setDependsOn.empty())
+                        if (!porphan->setDependsOn.empty())
                         {
-                            LogPrint("sc", "%s():%d - tx[%s] resolved all dependencies, adding to prio vec\n",
-                                __func__, __LINE__, porphan->ptx->GetHash().ToString());
-                            vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
-                            std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-#if 0
-        for (auto entry : vecPriority)
-        {
-            LogPrint("sc", "%s():%d - tx[%s] prio[%20.6f], feerate[%12s]\n",
-                __func__, __LINE__, (entry.get<2>())->GetHash().ToString(), entry.get<0>(), entry.get<1>().ToString());
+                            porphan->setDependsOn.erase(hash);
+                            LogPrint("sc", "%s():%d - erasing tx[%s] frim orphan %p\n", __func__, __LINE__, hash.ToString(), porphan);
+                            if (porphan->setDependsOn.empty())
+                            {
+                                LogPrint("sc", "%s():%d - tx[%s] resolved all dependencies, adding to prio vec\n",
+                                    __func__, __LINE__, porphan->ptx->GetHash().ToString());
+                                vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
+                                std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
+                            }
+                        }
+                        else
+                        {
+                            LogPrint("sc", "%s():%d - tx[%s] orphan %p empty\n", __func__, __LINE__, hash.ToString(), porphan);
+                        }
+                    }
+                }
+            }
         }
-#endif
+        else
+        {
+            // The candidates follow the mempool, so that only the entries which changed since the last template
+            // need their place in the orders computed, unless the tip moved.
+            templateCandidates.Follow(mempool);
+            templateCandidates.UpdateOrder(pindexPrev, nHeight, view);
+
+            int64_t nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                    ? nMedianTimePast
+                    : pblock->GetBlockTime();
+
+            // Walk the candidates without parents in the pool along the current order. The ones depending on
+            // other pool entries are queued once all of those are in the block, and compete with the walk.
+            auto itByPriority = templateCandidates.ByPriority().begin();
+            auto itByFee = templateCandidates.ByFee().begin();
+            vector<TxPriority> vecReady;
+            std::set<uint256> setConsidered;
+            std::set<uint256> setInBlock;
+
+            // once the block is almost full, give up after failing to add this many candidates in a row
+            const int MAX_CONSECUTIVE_FAILURES = 1000;
+            int nConsecutiveFailed = 0;
+
+            auto fSkip = [&](const uint256& hash) {
+                const CBlockTemplateCandidates::Candidate& candidate = templateCandidates.Get(hash);
+                return !candidate.fSelectable || !candidate.setParents.empty() || setConsidered.count(hash);
+            };
+
+            while (true)
+            {
+                const uint256* pnext = nullptr;
+                if (fSortedByFee) {
+                    while (itByFee != templateCandidates.ByFee().end() && fSkip(std::get<2>(*itByFee)))
+                        ++itByFee;
+                    if (itByFee != templateCandidates.ByFee().end())
+                        pnext = &std::get<2>(*itByFee);
+                } else {
+                    while (itByPriority != templateCandidates.ByPriority().end() && fSkip(std::get<2>(*itByPriority)))
+                        ++itByPriority;
+                    if (itByPriority != templateCandidates.ByPriority().end())
+                        pnext = &std::get<2>(*itByPriority);
+                }
+
+                const CTransactionBase* ptx = nullptr;
+                double dPriority = 0;
+                CFeeRate feeRate;
+                if (pnext) {
+                    const CBlockTemplateCandidates::Candidate& candidate = templateCandidates.Get(*pnext);
+                    ptx = candidate.ptx;
+                    dPriority = candidate.dPriority;
+                    feeRate = candidate.feeRate;
+                }
+                if (!vecReady.empty() && (!ptx || comparer(TxPriority(dPriority, feeRate, ptx), vecReady.front()))) {
+                    dPriority = vecReady.front().get<0>();
+                    feeRate = vecReady.front().get<1>();
+                    ptx = vecReady.front().get<2>();
+                    std::pop_heap(vecReady.begin(), vecReady.end(), comparer);
+                    vecReady.pop_back();
+                } else if (!ptx) {
+                    break;
+                }
+                const CTransactionBase& tx = *ptx;
+                const uint256& hash = tx.GetHash();
+                setConsidered.insert(hash);
+
+                // sorted by fee, what comes next is free as well
+                if (fSortedByFee && mempool.mapDeltas.empty() && feeRate < ::minRelayTxFee && nBlockSize >= nBlockMinSize)
+                    break;
+
+                if (!tx.IsCertificate()) {
+                    const CTransaction& txTx = dynamic_cast<const CTransaction&>(tx);
+                    if (!IsFinalTx(txTx, nHeight, nLockTimeCutoff))
+                        continue;
+
+                    // forward transfers go to sidechains either in the chain or created by a parent in the block
+                    bool fMissingSidechain = false;
+                    for (const auto& ft : txTx.GetVftCcOut()) {
+                        if (!view.HaveSidechain(ft.scId) && !mempool.hasSidechainCreationTx(ft.scId)) {
+                            LogPrintf("ERROR: mempool transaction missing sidechain\n");
+                            if (fDebug) assert("mempool transaction missing sidechain" == 0);
+                            fMissingSidechain = true;
                         }
                     }
-                    else
-                    {
-                        LogPrint("sc", "%s():%d - tx[%s] orphan %p empty\n", __func__, __LINE__, hash.ToString(), porphan);
+                    if (fMissingSidechain)
+                        continue;
+                }
+
+                bool fWasSortedByFee = fSortedByFee;
+                bool fAdded = TryAddToBlock(tx, dPriority, feeRate);
+                if (fSortedByFee != fWasSortedByFee)
+                    std::make_heap(vecReady.begin(), vecReady.end(), comparer);
+                if (!fAdded) {
+                    if (nBlockSize + 4000 > nBlockMaxSize && ++nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES)
+                        break;
+                    continue;
+                }
+                nConsecutiveFailed = 0;
+                setInBlock.insert(hash);
+
+                // Queue the candidates which depend on this one and on nothing else out of the block
+                for (const uint256& child : templateCandidates.Get(hash).setChildren) {
+                    const CBlockTemplateCandidates::Candidate& candidate = templateCandidates.Get(child);
+                    if (!candidate.fSelectable || setConsidered.count(child))
+                        continue;
+                    bool fReady = true;
+                    for (const uint256& parent : candidate.setParents)
+                        fReady &= setInBlock.count(parent) != 0;
+                    if (fReady) {
+                        LogPrint("sc", "%s():%d - tx[%s] resolved all dependencies, adding to prio vec\n",
+                            __func__, __LINE__, child.ToString());
+                        vecReady.push_back(TxPriority(candidate.dPriority, candidate.feeRate, candidate.ptx));
+                        std::push_heap(vecReady.begin(), vecReady.end(), comparer);
                     }
                 }
             }
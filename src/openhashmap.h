@@ -0,0 +1,455 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_OPENHASHMAP_H
+#define BITCOIN_OPENHASHMAP_H
+
+#include "memusage.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * STL-like unordered map with open addressing, used for the coins view caches.
+ *
+ * The table is a flat array of (hash, element pointer) slots probed linearly, so that a lookup
+ * compares cached hashes and touches a single element on hit instead of chasing a bucket list.
+ * Elements are carved out of chunks owned by the map and recycled through a free list, which
+ * saves the per-node malloc overhead and keeps neighbouring elements close in memory.
+ *
+ * As for boost::unordered_map, references to elements stay valid until the element is erased,
+ * while iterators may be invalidated by an insertion. Erased slots are marked as deleted rather
+ * than emptied, so that erasing while iterating does not disturb the iteration.
+ */
+template <typename K, typename V, typename Hash>
+class openhashmap
+{
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<const key_type, mapped_type> value_type;
+    typedef size_t size_type;
+
+private:
+    struct slot_type
+    {
+        size_t hash;
+        value_type* value; //! NULL for an empty slot, Deleted() for an erased one
+    };
+
+    union pool_node
+    {
+        pool_node* next;
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+    };
+
+    enum : size_t {
+        //! smallest table, must be a power of two
+        MIN_CAPACITY = 16,
+        //! elements allocated together: the chunk size doubles with the map up to this limit
+        MIN_CHUNK_NODES = 16,
+        MAX_CHUNK_NODES = 4096,
+    };
+
+    std::vector<slot_type> table;
+    size_t nSize;
+    size_t nDeleted;
+    Hash hasher;
+
+    std::vector<pool_node*> vChunks;
+    pool_node* freeList;
+    size_t nPoolNodes;
+    size_t nPoolUsage;
+
+    static value_type* Deleted() { return reinterpret_cast<value_type*>(uintptr_t(1)); }
+    static bool IsLive(const slot_type& slot) { return slot.value != NULL && slot.value != Deleted(); }
+
+    value_type* AllocateNode()
+    {
+        if (freeList == NULL)
+        {
+            size_t nNodes = std::min<size_t>(MAX_CHUNK_NODES, std::max<size_t>(MIN_CHUNK_NODES, nPoolNodes));
+            pool_node* chunk = static_cast<pool_node*>(::operator new(nNodes * sizeof(pool_node)));
+            vChunks.push_back(chunk);
+            for (size_t i = 0; i < nNodes; ++i)
+            {
+                chunk[i].next = freeList;
+                freeList = &chunk[i];
+            }
+            nPoolNodes += nNodes;
+            nPoolUsage += memusage::MallocUsage(nNodes * sizeof(pool_node));
+        }
+        pool_node* node = freeList;
+        freeList = node->next;
+        return reinterpret_cast<value_type*>(&node->storage);
+    }
+
+    void DeallocateNode(value_type* value)
+    {
+        pool_node* node = reinterpret_cast<pool_node*>(value);
+        node->next = freeList;
+        freeList = node;
+    }
+
+    void ReleaseNode(value_type* value)
+    {
+        value->~value_type();
+        DeallocateNode(value);
+    }
+
+    void ReleasePool()
+    {
+        for (pool_node* chunk : vChunks)
+            ::operator delete(chunk);
+        vChunks.clear();
+        freeList = NULL;
+        nPoolNodes = 0;
+        nPoolUsage = 0;
+    }
+
+    //! index of the slot holding key, or of the slot where it should be inserted if missing
+    size_t Lookup(const key_type& key, size_t hash, bool& fFound) const
+    {
+        const size_t mask = table.size() - 1;
+        size_t pos = hash & mask;
+        size_t firstDeleted = table.size();
+        while (true)
+        {
+            const slot_type& slot = table[pos];
+            if (slot.value == NULL)
+            {
+                fFound = false;
+                return firstDeleted != table.size() ? firstDeleted : pos;
+            }
+            if (slot.value == Deleted())
+            {
+                if (firstDeleted == table.size())
+                    firstDeleted = pos;
+            }
+            else if (slot.hash == hash && slot.value->first == key)
+            {
+                fFound = true;
+                return pos;
+            }
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    //! make room for one more element, keeping the load (deleted slots included) below 3/4
+    void Reserve()
+    {
+        if ((nSize + nDeleted + 1) * 4 <= table.size() * 3)
+            return;
+
+        // purging deleted slots is enough when they make up most of the load
+        size_t nCapacity = std::max<size_t>(table.size(), MIN_CAPACITY);
+        while ((nSize + 1) * 8 > nCapacity * 3)
+            nCapacity *= 2;
+
+        std::vector<slot_type> slots(nCapacity, slot_type{0, NULL});
+        slots.swap(table);
+        nDeleted = 0;
+
+        const size_t mask = table.size() - 1;
+        for (const slot_type& slot : slots)
+        {
+            if (!IsLive(slot))
+                continue;
+            size_t pos = slot.hash & mask;
+            while (table[pos].value != NULL)
+                pos = (pos + 1) & mask;
+            table[pos] = slot;
+        }
+    }
+
+    void EraseSlot(size_t pos)
+    {
+        ReleaseNode(table[pos].value);
+        table[pos].value = Deleted();
+        --nSize;
+        ++nDeleted;
+        if (nSize == 0)
+        {
+            // cheap reset, nobody can be iterating over the deleted slots anymore
+            std::fill(table.begin(), table.end(), slot_type{0, NULL});
+            nDeleted = 0;
+        }
+    }
+
+public:
+    template <bool fConst>
+    class iterator_impl
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename openhashmap::value_type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef typename std::conditional<fConst, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<fConst, const value_type&, value_type&>::type reference;
+
+    private:
+        friend class openhashmap;
+        template <bool> friend class iterator_impl;
+        typedef typename std::conditional<fConst, const slot_type*, slot_type*>::type slot_pointer;
+
+        slot_pointer slot;
+        slot_pointer slotEnd;
+        value_type* value;
+
+        iterator_impl(slot_pointer slotIn, slot_pointer slotEndIn) : slot(slotIn), slotEnd(slotEndIn), value(NULL)
+        {
+            while (slot != slotEnd && !IsLive(*slot))
+                ++slot;
+            if (slot != slotEnd)
+                value = slot->value;
+        }
+
+    public:
+        iterator_impl() : slot(NULL), slotEnd(NULL), value(NULL) {}
+
+        operator iterator_impl<true>() const
+        {
+            iterator_impl<true> ret;
+            ret.slot = slot;
+            ret.slotEnd = slotEnd;
+            ret.value = value;
+            return ret;
+        }
+
+        // elements do not move, so dereferencing does not depend on the table
+        reference operator*() const { return *value; }
+        pointer operator->() const { return value; }
+
+        iterator_impl& operator++()
+        {
+            *this = iterator_impl(slot + 1, slotEnd);
+            return *this;
+        }
+
+        iterator_impl operator++(int)
+        {
+            iterator_impl ret = *this;
+            ++(*this);
+            return ret;
+        }
+
+        friend bool operator==(const iterator_impl& a, const iterator_impl& b) { return a.value == b.value; }
+        friend bool operator!=(const iterator_impl& a, const iterator_impl& b) { return a.value != b.value; }
+    };
+
+    typedef iterator_impl<false> iterator;
+    typedef iterator_impl<true> const_iterator;
+
+private:
+    std::pair<iterator, bool> Place(size_t pos, size_t hash, value_type* value)
+    {
+        if (table[pos].value == Deleted())
+            --nDeleted;
+        table[pos].hash = hash;
+        table[pos].value = value;
+        ++nSize;
+        return std::make_pair(iterator(&table[pos], table.data() + table.size()), true);
+    }
+
+public:
+
+    openhashmap() : nSize(0), nDeleted(0), freeList(NULL), nPoolNodes(0), nPoolUsage(0) {}
+
+    openhashmap(const openhashmap& other) : openhashmap()
+    {
+        for (const value_type& v : other)
+            insert(v);
+    }
+
+    openhashmap(openhashmap&& other) : openhashmap() { swap(other); }
+
+    openhashmap& operator=(openhashmap other)
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~openhashmap() { clear(); }
+
+    void swap(openhashmap& other)
+    {
+        table.swap(other.table);
+        std::swap(nSize, other.nSize);
+        std::swap(nDeleted, other.nDeleted);
+        std::swap(hasher, other.hasher);
+        vChunks.swap(other.vChunks);
+        std::swap(freeList, other.freeList);
+        std::swap(nPoolNodes, other.nPoolNodes);
+        std::swap(nPoolUsage, other.nPoolUsage);
+    }
+
+    iterator begin() { return iterator(table.data(), table.data() + table.size()); }
+    iterator end() { return iterator(table.data() + table.size(), table.data() + table.size()); }
+    const_iterator begin() const { return const_iterator(table.data(), table.data() + table.size()); }
+    const_iterator end() const { return const_iterator(table.data() + table.size(), table.data() + table.size()); }
+
+    size_type size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+    size_type bucket_count() const { return table.size(); }
+
+    iterator find(const key_type& key)
+    {
+        if (nSize == 0)
+            return end();
+        bool fFound;
+        size_t pos = Lookup(key, hasher(key), fFound);
+        return fFound ? iterator(&table[pos], table.data() + table.size()) : end();
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        if (nSize == 0)
+            return end();
+        bool fFound;
+        size_t pos = Lookup(key, hasher(key), fFound);
+        return fFound ? const_iterator(&table[pos], table.data() + table.size()) : end();
+    }
+
+    size_type count(const key_type& key) const { return find(key) != end() ? 1 : 0; }
+
+    mapped_type& at(const key_type& key)
+    {
+        iterator it = find(key);
+        if (it == end())
+            throw std::out_of_range("openhashmap::at");
+        return it->second;
+    }
+
+    const mapped_type& at(const key_type& key) const
+    {
+        const_iterator it = find(key);
+        if (it == end())
+            throw std::out_of_range("openhashmap::at");
+        return it->second;
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args)
+    {
+        // the key is only known once the element is built
+        value_type* value = AllocateNode();
+        try {
+            new (value) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            DeallocateNode(value);
+            throw;
+        }
+
+        Reserve();
+        const size_t hash = hasher(value->first);
+        bool fFound;
+        size_t pos = Lookup(value->first, hash, fFound);
+        if (fFound)
+        {
+            ReleaseNode(value);
+            return std::make_pair(iterator(&table[pos], table.data() + table.size()), false);
+        }
+        return Place(pos, hash, value);
+    }
+
+    template <typename P>
+    std::pair<iterator, bool> insert(P&& v)
+    {
+        Reserve();
+        const size_t hash = hasher(v.first);
+        bool fFound;
+        size_t pos = Lookup(v.first, hash, fFound);
+        if (fFound)
+            return std::make_pair(iterator(&table[pos], table.data() + table.size()), false);
+
+        value_type* value = AllocateNode();
+        try {
+            new (value) value_type(std::forward<P>(v));
+        } catch (...) {
+            DeallocateNode(value);
+            throw;
+        }
+        return Place(pos, hash, value);
+    }
+
+    mapped_type& operator[](const key_type& key)
+    {
+        iterator it = find(key);
+        if (it != end())
+            return it->second;
+        return emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple()).first->second;
+    }
+
+    iterator erase(const_iterator it)
+    {
+        assert(it.value != NULL);
+        size_t pos;
+        if (it.slot >= table.data() && it.slot < table.data() + table.size() && it.slot->value == it.value)
+        {
+            pos = it.slot - table.data();
+        }
+        else
+        {
+            // the table has been rebuilt since the iterator was obtained, the element has not moved though
+            bool fFound;
+            pos = Lookup(it.value->first, hasher(it.value->first), fFound);
+            assert(fFound && table[pos].value == it.value);
+        }
+        EraseSlot(pos);
+        return iterator(table.data() + pos + (nSize == 0 ? table.size() - pos : 1), table.data() + table.size());
+    }
+
+    size_type erase(const key_type& key)
+    {
+        if (nSize == 0)
+            return 0;
+        bool fFound;
+        size_t pos = Lookup(key, hasher(key), fFound);
+        if (!fFound)
+            return 0;
+        EraseSlot(pos);
+        return 1;
+    }
+
+    void clear()
+    {
+        for (slot_type& slot : table)
+        {
+            if (IsLive(slot))
+                slot.value->~value_type();
+        }
+        std::vector<slot_type>().swap(table);
+        nSize = 0;
+        nDeleted = 0;
+        ReleasePool();
+    }
+
+    //! heap memory held by the table and the element chunks, the elements' own allocations excluded
+    size_t DynamicMemoryUsage() const
+    {
+        return memusage::MallocUsage(table.capacity() * sizeof(slot_type)) + nPoolUsage;
+    }
+};
+
+namespace memusage
+{
+
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const openhashmap<X, Y, Z>& m)
+{
+    return m.DynamicMemoryUsage();
+}
+
+}
+
+#endif // BITCOIN_OPENHASHMAP_H
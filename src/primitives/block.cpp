@@ -246,6 +246,51 @@ void SidechainTxsCommitmentBuilder::add(const CScCertificate& cert)
     mScCerts[cert.GetScId()] = cert.GetHash();
 }
 
+uint256 SidechainTxsCommitmentBuilder::getScLeaf(const uint256& scid, uint256& ftHash, uint256& btrHash, uint256& wCertHash) const
+{
+    ftHash    = getCrossChainNullHash();
+    btrHash   = getCrossChainNullHash();
+    wCertHash = getCrossChainNullHash();
+
+    auto itFt = mScMerkleTreeLeavesFt.find(scid);
+    if (itFt != mScMerkleTreeLeavesFt.end() )
+    {
+        ftHash = getMerkleRootHash(itFt->second);
+    }
+
+    auto itBtr = mScMerkleTreeLeavesBtr.find(scid);
+    if (itBtr != mScMerkleTreeLeavesBtr.end() )
+    {
+        btrHash = getMerkleRootHash(itBtr->second);
+    }
+
+    auto itCert = mScCerts.find(scid);
+    if (itCert != mScCerts.end() )
+    {
+        wCertHash = itCert->second;
+    }
+
+    const uint256& txsHash = Hash(
+        BEGIN(ftHash),    END(ftHash),
+        BEGIN(btrHash),   END(btrHash) );
+
+    const uint256& scHash = Hash(
+        BEGIN(txsHash),   END(txsHash),
+        BEGIN(wCertHash), END(wCertHash),
+        BEGIN(scid),      END(scid) );
+
+#ifdef DEBUG_SC_COMMITMENT_HASH
+    std::cout << " -------------------------------------------" << std::endl;
+    std::cout << "  FtHash:  " << ftHash.ToString() << std::endl;
+    std::cout << "  BtrHash: " << btrHash.ToString() << std::endl;
+    std::cout << "  => TxsHash:   " << txsHash.ToString() << std::endl;
+    std::cout << "     WCertHash: " << wCertHash.ToString() << std::endl;
+    std::cout << "     scid:      " << scid.ToString() << std::endl;
+    std::cout << "     => ScsHash:  " << scHash.ToString() << std::endl;
+#endif
+    return scHash;
+}
+
 uint256 SidechainTxsCommitmentBuilder::getCommitment()
 {
     std::vector<uint256> vSortedScLeaves;
@@ -253,49 +298,50 @@ uint256 SidechainTxsCommitmentBuilder::getCommitment()
     // set of scid is ordered
     for (const auto& scid : sScIds)
     {
-        uint256 ftHash(getCrossChainNullHash());
-        uint256 btrHash(getCrossChainNullHash());
-        uint256 wCertHash(getCrossChainNullHash());
+        uint256 ftHash, btrHash, wCertHash;
+        vSortedScLeaves.push_back(getScLeaf(scid, ftHash, btrHash, wCertHash));
+    }
 
-        auto itFt = mScMerkleTreeLeavesFt.find(scid);
-        if (itFt != mScMerkleTreeLeavesFt.end() )
-        {
-            ftHash = getMerkleRootHash(itFt->second);
-        }
+    return getMerkleRootHash(vSortedScLeaves);
+}
+
+bool SidechainTxsCommitmentBuilder::getScMerklePath(const uint256& scid, uint256& ftHash, uint256& btrHash, uint256& wCertHash,
+                                                    int& nLeafIndex, std::vector<uint256>& vMerkleBranch) const
+{
+    vMerkleBranch.clear();
+    nLeafIndex = -1;
 
-        auto itBtr = mScMerkleTreeLeavesBtr.find(scid);
-        if (itBtr != mScMerkleTreeLeavesBtr.end() )
+    std::vector<uint256> vMerkleTree;
+    vMerkleTree.reserve(sScIds.size() * 2 + 16);
+
+    // set of scid is ordered, leaves are the same as in getCommitment()
+    for (const auto& id : sScIds)
+    {
+        uint256 h1, h2, h3;
+        if (id == scid)
         {
-            btrHash = getMerkleRootHash(itBtr->second);
+            nLeafIndex = vMerkleTree.size();
+            vMerkleTree.push_back(getScLeaf(id, ftHash, btrHash, wCertHash));
         }
-
-        auto itCert = mScCerts.find(scid);
-        if (itCert != mScCerts.end() )
+        else
         {
-            wCertHash = itCert->second;
+            vMerkleTree.push_back(getScLeaf(id, h1, h2, h3));
         }
+    }
 
-        const uint256& txsHash = Hash(
-            BEGIN(ftHash),    END(ftHash),
-            BEGIN(btrHash),   END(btrHash) );
+    if (nLeafIndex == -1)
+        return false;
 
-        const uint256& scHash = Hash(
-            BEGIN(txsHash),   END(txsHash),
-            BEGIN(wCertHash), END(wCertHash),
-            BEGIN(scid),      END(scid) );
+    CBlock::BuildMerkleTree(vMerkleTree, sScIds.size());
 
-#ifdef DEBUG_SC_COMMITMENT_HASH
-        std::cout << " -------------------------------------------" << std::endl;
-        std::cout << "  FtHash:  " << ftHash.ToString() << std::endl;
-        std::cout << "  BtrHash: " << btrHash.ToString() << std::endl;
-        std::cout << "  => TxsHash:   " << txsHash.ToString() << std::endl;
-        std::cout << "     WCertHash: " << wCertHash.ToString() << std::endl;
-        std::cout << "     scid:      " << scid.ToString() << std::endl;
-        std::cout << "     => ScsHash:  " << scHash.ToString() << std::endl;
-#endif
-        vSortedScLeaves.push_back(scHash);
+    int nIndex = nLeafIndex;
+    int j = 0;
+    for (int nSize = sScIds.size(); nSize > 1; nSize = (nSize + 1) / 2)
+    {
+        int i = std::min(nIndex^1, nSize-1);
+        vMerkleBranch.push_back(vMerkleTree[j+i]);
+        nIndex >>= 1;
+        j += nSize;
     }
-
-    return getMerkleRootHash(vSortedScLeaves);
+    return true;
 }
-
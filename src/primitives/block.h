@@ -277,11 +277,20 @@ private:
 
     // return the merkle root hash of the input leaves. The merkle tree is not saved.
     static uint256 getMerkleRootHash(const std::vector<uint256>& vInputLeaves);
+
+    // return the leaf of the given scid, together with the hashes it is made of
+    uint256 getScLeaf(const uint256& scid, uint256& ftHash, uint256& btrHash, uint256& wCertHash) const;
 public:
     void add(const CTransaction& tx);
     void add(const CScCertificate& cert);
     uint256 getCommitment();
 
+    // fill the data proving the contribution of the given scid to the commitment: the hashes its leaf is
+    // made of, the position of the leaf and its merkle branch, which can be checked with
+    // CBlock::CheckMerkleBranch(). Return false if nothing has been added for this scid.
+    bool getScMerklePath(const uint256& scid, uint256& ftHash, uint256& btrHash, uint256& wCertHash,
+                         int& nLeafIndex, std::vector<uint256>& vMerkleBranch) const;
+
     // return the hash of a well known string (MAGIC_SC_STRING declared above) which can be used
     // as a null-semantic value
     static const uint256& getCrossChainNullHash();
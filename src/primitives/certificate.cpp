@@ -220,7 +220,7 @@ bool CScCertificate::ContextualCheck(CValidationState& state, int nHeight, int d
 // need linking all of the related symbols. We use this macro as it is already defined with a similar purpose
 // in zen-tx binary build configuration
 #ifdef BITCOIN_TX
-std::shared_ptr<BaseSignatureChecker> CScCertificate::MakeSignatureChecker(unsigned int nIn, const CChain* chain, bool cacheStore) const
+std::shared_ptr<BaseSignatureChecker> CScCertificate::MakeSignatureChecker(unsigned int nIn, const CChain* chain, bool cacheStore, const PrecomputedTransactionData* txdata) const
 {
     return std::shared_ptr<BaseSignatureChecker>(NULL);
 }
@@ -232,9 +232,9 @@ std::shared_ptr<const CTransactionBase> CScCertificate::MakeShared() const
 }
 #else
 
-std::shared_ptr<BaseSignatureChecker> CScCertificate::MakeSignatureChecker(unsigned int nIn, const CChain* chain, bool cacheStore) const
+std::shared_ptr<BaseSignatureChecker> CScCertificate::MakeSignatureChecker(unsigned int nIn, const CChain* chain, bool cacheStore, const PrecomputedTransactionData* txdata) const
 {
-    return std::shared_ptr<BaseSignatureChecker>(new CachingCertificateSignatureChecker(this, nIn, chain, cacheStore));
+    return std::shared_ptr<BaseSignatureChecker>(new CachingCertificateSignatureChecker(this, nIn, chain, cacheStore, txdata));
 }
 
 void CScCertificate::Relay() const { ::Relay(*this); }
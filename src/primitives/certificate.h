@@ -187,7 +187,7 @@ public:
     bool ContextualCheck(CValidationState& state, int nHeight, int dosLevel) const override;
 
     std::shared_ptr<BaseSignatureChecker> MakeSignatureChecker(
-        unsigned int nIn, const CChain* chain, bool cacheStore) const override;
+        unsigned int nIn, const CChain* chain, bool cacheStore, const PrecomputedTransactionData* txdata = nullptr) const override;
 };
 
 /** A mutable version of CScCertificate. */
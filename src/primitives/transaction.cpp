@@ -766,7 +766,7 @@ bool CTransaction::ContextualCheckInputs(CValidationState &state, const CCoinsVi
           const CChain& chain, unsigned int flags, bool cacheStore, const Consensus::Params& consensusParams,
           std::vector<CScriptCheck> *pvChecks) const { return true;}
 std::string CTransaction::EncodeHex() const { return ""; }
-std::shared_ptr<BaseSignatureChecker> CTransaction::MakeSignatureChecker(unsigned int nIn, const CChain* chain, bool cacheStore) const
+std::shared_ptr<BaseSignatureChecker> CTransaction::MakeSignatureChecker(unsigned int nIn, const CChain* chain, bool cacheStore, const PrecomputedTransactionData* txdata) const
 {
     return std::shared_ptr<BaseSignatureChecker>();
 }
@@ -951,7 +951,7 @@ void CTransaction::AddSidechainOutsToJSON(UniValue& entry) const
 
 bool CTransactionBase::VerifyScript(
         const CScript& scriptPubKey, unsigned int nFlags, unsigned int nIn, const CChain* chain,
-        bool cacheStore, ScriptError* serror) const
+        bool cacheStore, ScriptError* serror, const PrecomputedTransactionData* txdata) const
 {
     if (nIn >= GetVin().size() )
         return ::error("%s:%d can not verify Signature: nIn too large for vin size %d",
@@ -961,7 +961,7 @@ bool CTransactionBase::VerifyScript(
 
     if (!::VerifyScript(scriptSig, scriptPubKey, nFlags,
                       //CachingTransactionSignatureChecker(this, nIn, chain, cacheStore),
-                      *MakeSignatureChecker(nIn, chain, cacheStore),
+                      *MakeSignatureChecker(nIn, chain, cacheStore, txdata),
                       serror))
     {
         return ::error("%s:%d VerifySignature failed: %s", GetHash().ToString(), nIn, ScriptErrorString(*serror));
@@ -970,9 +970,9 @@ bool CTransactionBase::VerifyScript(
     return true;
 }
 
-std::shared_ptr<BaseSignatureChecker> CTransaction::MakeSignatureChecker(unsigned int nIn, const CChain* chain, bool cacheStore) const
+std::shared_ptr<BaseSignatureChecker> CTransaction::MakeSignatureChecker(unsigned int nIn, const CChain* chain, bool cacheStore, const PrecomputedTransactionData* txdata) const
 {
-    return std::shared_ptr<BaseSignatureChecker>(new CachingTransactionSignatureChecker(this, nIn, chain, cacheStore));
+    return std::shared_ptr<BaseSignatureChecker>(new CachingTransactionSignatureChecker(this, nIn, chain, cacheStore, txdata));
 }
 
 bool CTransaction::ContextualCheckInputs(CValidationState &state, const CCoinsViewCache &view, bool fScriptChecks,
@@ -571,6 +571,7 @@ namespace Sidechain { class ScCoinsViewCache; }
 
 class BaseSignatureChecker;
 class CMutableTransactionBase;
+class PrecomputedTransactionData;
 
 // abstract interface for CTransaction and CScCertificate
 class CTransactionBase
@@ -673,10 +674,10 @@ public:
 
     bool VerifyScript(
         const CScript& scriptPubKey, unsigned int flags, unsigned int nIn, const CChain* chain,
-        bool cacheStore, ScriptError* serror) const;
+        bool cacheStore, ScriptError* serror, const PrecomputedTransactionData* txdata = nullptr) const;
 
     virtual std::shared_ptr<BaseSignatureChecker> MakeSignatureChecker(
-        unsigned int nIn, const CChain* chain, bool cacheStore) const = 0;
+        unsigned int nIn, const CChain* chain, bool cacheStore, const PrecomputedTransactionData* txdata = nullptr) const = 0;
 
     //-----------------
     // default values for derived classes which do not support specific data structures
@@ -945,7 +946,7 @@ public:
                            std::vector<CScriptCheck> *pvChecks = NULL) const override;
 
     std::shared_ptr<BaseSignatureChecker> MakeSignatureChecker(
-        unsigned int nIn, const CChain* chain, bool cacheStore) const override;
+        unsigned int nIn, const CChain* chain, bool cacheStore, const PrecomputedTransactionData* txdata = nullptr) const override;
 };
 
 /** A mutable hierarchy version of CTransaction. */
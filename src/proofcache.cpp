@@ -0,0 +1,103 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "proofcache.h"
+
+#include "crypto/sha256.h"
+#include "memusage.h"
+#include "random.h"
+#include "util.h"
+
+#include <set>
+
+#include <boost/thread.hpp>
+
+namespace {
+
+/**
+ * Set of salted hashes of verified proofs. Entries only tell a proof verified once, hence
+ * the cache never needs to be cleared: a transaction is identified by a hash committing to
+ * its proofs, and a certificate entry also commits to everything else its proof depends on.
+ */
+class CProofCache
+{
+private:
+    //! salt, so that entries cannot be predicted (and targeted for eviction) by an attacker
+    uint256 nonce;
+    std::set<uint256> setValid;
+    boost::shared_mutex cs_proofcache;
+
+    uint256 ComputeEntry(unsigned char tag, const uint256& a, const uint256& b = uint256(), const uint256& c = uint256()) const
+    {
+        uint256 entry;
+        CSHA256().Write(nonce.begin(), 32).Write(&tag, 1).
+            Write(a.begin(), 32).Write(b.begin(), 32).Write(c.begin(), 32).Finalize(entry.begin());
+        return entry;
+    }
+
+public:
+    CProofCache(): nonce(GetRandHash()) {}
+
+    bool Get(unsigned char tag, const uint256& a, const uint256& b = uint256(), const uint256& c = uint256())
+    {
+        const uint256 entry = ComputeEntry(tag, a, b, c);
+
+        boost::shared_lock<boost::shared_mutex> lock(cs_proofcache);
+        return setValid.count(entry) != 0;
+    }
+
+    void Set(unsigned char tag, const uint256& a, const uint256& b = uint256(), const uint256& c = uint256())
+    {
+        static const size_t nEntryUsage = memusage::MallocUsage(sizeof(memusage::stl_tree_node<uint256>));
+        int64_t nMaxCacheSize = GetArg("-maxproofcachesize", DEFAULT_MAX_PROOF_CACHE_SIZE) * ((size_t) 1 << 20);
+        if (nMaxCacheSize <= 0) return;
+        const size_t nMaxEntries = nMaxCacheSize / nEntryUsage;
+
+        const uint256 entry = ComputeEntry(tag, a, b, c);
+
+        boost::unique_lock<boost::shared_mutex> lock(cs_proofcache);
+
+        while (setValid.size() >= nMaxEntries)
+        {
+            // Evict a random entry, see CSignatureCache
+            std::set<uint256>::iterator it = setValid.lower_bound(GetRandHash());
+            if (it == setValid.end())
+                it = setValid.begin();
+            setValid.erase(it);
+        }
+
+        setValid.insert(entry);
+    }
+};
+
+static const unsigned char JOINSPLIT_PROOFS_TAG = 'j';
+static const unsigned char CERT_PROOF_TAG = 'c';
+
+CProofCache& GetProofCache()
+{
+    static CProofCache proofCache;
+    return proofCache;
+}
+
+}
+
+bool IsJoinSplitProofsCached(const uint256& txHash)
+{
+    return GetProofCache().Get(JOINSPLIT_PROOFS_TAG, txHash);
+}
+
+void CacheJoinSplitProofs(const uint256& txHash)
+{
+    GetProofCache().Set(JOINSPLIT_PROOFS_TAG, txHash);
+}
+
+bool IsCertProofCached(const uint256& certHash, const uint256& vkDataHash, const uint256& prevEndEpochBlockHash)
+{
+    return GetProofCache().Get(CERT_PROOF_TAG, certHash, vkDataHash, prevEndEpochBlockHash);
+}
+
+void CacheCertProof(const uint256& certHash, const uint256& vkDataHash, const uint256& prevEndEpochBlockHash)
+{
+    GetProofCache().Set(CERT_PROOF_TAG, certHash, vkDataHash, prevEndEpochBlockHash);
+}
@@ -0,0 +1,32 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PROOFCACHE_H
+#define BITCOIN_PROOFCACHE_H
+
+#include "uint256.h"
+
+/** Default for -maxproofcachesize, the memory (in MiB) the verified proofs cache can use */
+static const unsigned int DEFAULT_MAX_PROOF_CACHE_SIZE = 4;
+
+/**
+ * Valid proof cache, to avoid doing expensive zk-SNARK verification twice for every
+ * transaction and certificate (once when accepted into memory pool, and again when
+ * accepted into the block chain).
+ */
+
+/** Returns true if the JoinSplit proofs of the transaction with the given hash have already been verified */
+bool IsJoinSplitProofsCached(const uint256& txHash);
+/** Records that the JoinSplit proofs of the transaction with the given hash are valid */
+void CacheJoinSplitProofs(const uint256& txHash);
+
+/**
+ * Returns true if the proof of the certificate with the given hash has already been verified against
+ * the given sidechain verification data (see libzendoomc::CScVkCache::DataHash) and previous end epoch block
+ */
+bool IsCertProofCached(const uint256& certHash, const uint256& vkDataHash, const uint256& prevEndEpochBlockHash);
+/** Records that the proof of the certificate is valid for the given verification data and previous end epoch block */
+void CacheCertProof(const uint256& certHash, const uint256& vkDataHash, const uint256& prevEndEpochBlockHash);
+
+#endif // BITCOIN_PROOFCACHE_H
@@ -4,6 +4,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "base58.h"
+#include "blockcache.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -11,6 +13,7 @@
 #include "main.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
+#include "scindex.h"
 #include "streams.h"
 #include "sync.h"
 #include "util.h"
@@ -424,6 +427,37 @@ UniValue getblockhash(const UniValue& params, bool fHelp)
     return pblockindex->GetBlockHash().GetHex();
 }
 
+UniValue getblockhashes(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw runtime_error(
+            "getblockhashes high low\n"
+            "\nReturns the hashes of the best-block-chain blocks with timestamps from low (included) to high (excluded)"
+            " (requires -timestampindex).\n"
+            "\nArguments:\n"
+            "1. high         (numeric, required) The newer block timestamp\n"
+            "2. low          (numeric, required) The older block timestamp\n"
+            "\nResult:\n"
+            "[\n"
+            "  \"hash\"         (string) The block hash\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockhashes", "1231614698 1231024505")
+            + HelpExampleRpc("getblockhashes", "1231614698, 1231024505")
+        );
+
+    unsigned int high = params[0].get_int();
+    unsigned int low = params[1].get_int();
+    std::vector<uint256> blockHashes;
+    if (!GetTimestampIndex(high, low, blockHashes))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for block hashes");
+
+    UniValue result(UniValue::VARR);
+    for (const uint256& hash : blockHashes)
+        result.push_back(hash.GetHex());
+    return result;
+}
+
 UniValue getblockheader(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -553,14 +587,15 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if (mapBlockIndex.count(hash) == 0)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
     CBlockIndex* pblockindex = mapBlockIndex[hash];
 
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
 
-    if(!ReadBlockFromDisk(block, pblockindex))
+    std::shared_ptr<const CBlock> pblock = GetCachedBlock(pblockindex);
+    if (!pblock)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    const CBlock& block = *pblock;
 
     if (!fVerbose)
     {
@@ -927,6 +962,9 @@ UniValue mempoolInfoToJSON()
     ret.push_back(Pair("size", (int64_t) mempool.size()));
     ret.push_back(Pair("bytes", (int64_t) mempool.GetTotalSize()));
     ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
+    size_t maxmempool = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+    ret.push_back(Pair("maxmempool", (int64_t) maxmempool));
+    ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
 
     if (Params().NetworkIDString() == "regtest") {
         ret.push_back(Pair("fullyNotified", mempool.IsFullyNotified()));
@@ -946,6 +984,8 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
             "  \"usage\": xxxxx               (numeric) Total memory usage for the mempool\n"
+            "  \"maxmempool\": xxxxx          (numeric) Maximum memory usage for the mempool\n"
+            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee for tx to be accepted\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
@@ -1201,14 +1241,15 @@ UniValue getscgenesisinfo(const UniValue& params, bool fHelp)
 
     assert(mapBlockIndex.count(blockHash) != 0);
 
-    CBlock block;
     CBlockIndex* pblockindex = mapBlockIndex[blockHash];
 
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
 
-    if(!ReadBlockFromDisk(block, pblockindex))
+    std::shared_ptr<const CBlock> pblock = GetCachedBlock(pblockindex);
+    if (!pblock)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    const CBlock& block = *pblock;
 
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
 
@@ -1259,6 +1300,144 @@ UniValue getscgenesisinfo(const UniValue& params, bool fHelp)
    
 }
 
+static uint256 ParseScId(const UniValue& value)
+{
+    string inputString = value.get_str();
+    if (inputString.find_first_not_of("0123456789abcdefABCDEF", 0) != std::string::npos)
+        throw JSONRPCError(RPC_TYPE_ERROR, "Invalid scid format: not an hex");
+
+    uint256 scId;
+    scId.SetHex(inputString);
+    return scId;
+}
+
+static UniValue ScIndexEntryToJSON(const CScIndexKey& key, const CScIndexValue& value)
+{
+    static const char* kinds[] = { "creation", "forwardtransfer", "certificate", "backwardtransfer" };
+
+    UniValue entry(UniValue::VOBJ);
+    entry.push_back(Pair("kind", key.kind < sizeof(kinds) / sizeof(kinds[0]) ? kinds[key.kind] : "unknown"));
+    entry.push_back(Pair("height", key.nHeight));
+    entry.push_back(Pair("txid", key.txid.GetHex()));
+    entry.push_back(Pair("n", (int)key.n));
+    entry.push_back(Pair("amount", ValueFromAmount(value.nValue)));
+    if (value.nEpoch != -1)
+        entry.push_back(Pair("epoch", value.nEpoch));
+    if (key.kind == SC_INDEX_CREATION || key.kind == SC_INDEX_FORWARD_TRANSFER)
+        entry.push_back(Pair("address", value.address.GetHex()));
+    if (key.kind == SC_INDEX_BACKWARD_TRANSFER) {
+        CTxDestination dest;
+        if (ExtractDestination(value.script, dest))
+            entry.push_back(Pair("address", CBitcoinAddress(dest).ToString()));
+        entry.push_back(Pair("scriptPubKey", HexStr(value.script.begin(), value.script.end())));
+    }
+    return entry;
+}
+
+UniValue getscactivity(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw runtime_error(
+            "getscactivity \"scid\" ( start end )\n"
+            "\nReturns the creation, forward transfers, certificates and backward transfers of a sidechain,"
+            " in chain order (requires -scindex).\n"
+            "\nArguments:\n"
+            "1. \"scid\"       (string, required) The sidechain ID\n"
+            "2. start        (numeric, optional) The first block height\n"
+            "3. end          (numeric, optional) The last block height\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"kind\": \"xxxx\",      (string)  creation, forwardtransfer, certificate or backwardtransfer\n"
+            "    \"height\": n,         (numeric) the block height\n"
+            "    \"txid\": \"xxxx\",      (string)  the transaction or certificate\n"
+            "    \"n\": n,              (numeric) index of the output among the creations, forward transfers or outputs\n"
+            "    \"amount\": x.xxx,     (numeric) the amount; for certificates, the total of their backward transfers\n"
+            "    \"epoch\": n,          (numeric, optional) for certificates and backward transfers, the epoch of the certificate\n"
+            "    \"address\": \"xxxx\",   (string, optional) the receiver in the sidechain, or in the mainchain for backward transfers\n"
+            "    \"scriptPubKey\": \"xx\" (string, optional) for backward transfers, the hex encoded script paying the receiver\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples\n"
+            + HelpExampleCli("getscactivity", "\"1a3e7ccbfd40c4e2304c3215f76d204e4de63c578ad835510f580d529516a874\" 100 200")
+            + HelpExampleRpc("getscactivity", "\"1a3e7ccbfd40c4e2304c3215f76d204e4de63c578ad835510f580d529516a874\", 100, 200")
+        );
+
+    uint256 scId = ParseScId(params[0]);
+    int start = params.size() > 1 ? params[1].get_int() : 0;
+    int end = params.size() > 2 ? params[2].get_int() : 0;
+    if (start < 0 || end < 0 || (end > 0 && end < start))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Start and end are expected to be a valid range of heights");
+
+    std::vector<std::pair<CScIndexKey, CScIndexValue> > scIndex;
+    if (!GetScIndex(scId, scIndex, start, end))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for sidechain");
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<CScIndexKey, CScIndexValue>& entry : scIndex)
+        result.push_back(ScIndexEntryToJSON(entry.first, entry.second));
+    return result;
+}
+
+UniValue getsccertificates(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw runtime_error(
+            "getsccertificates \"scid\" ( fromepoch toepoch )\n"
+            "\nReturns the certificates of a sidechain for the given range of epochs, with their backward transfers"
+            " (requires -scindex).\n"
+            "\nArguments:\n"
+            "1. \"scid\"       (string, required) The sidechain ID\n"
+            "2. fromepoch    (numeric, optional) The first epoch\n"
+            "3. toepoch      (numeric, optional) The last epoch\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    ...                  as returned by getscactivity, for certificates and backward transfers only\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples\n"
+            + HelpExampleCli("getsccertificates", "\"1a3e7ccbfd40c4e2304c3215f76d204e4de63c578ad835510f580d529516a874\" 2 5")
+            + HelpExampleRpc("getsccertificates", "\"1a3e7ccbfd40c4e2304c3215f76d204e4de63c578ad835510f580d529516a874\", 2, 5")
+        );
+
+    uint256 scId = ParseScId(params[0]);
+    int fromEpoch = params.size() > 1 ? params[1].get_int() : 0;
+    int toEpoch = params.size() > 2 ? params[2].get_int() : std::numeric_limits<int>::max();
+    if (fromEpoch < 0 || toEpoch < fromEpoch)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "fromepoch and toepoch are expected to be a valid range of epochs");
+
+    // the certificate for an epoch is received within the safeguard margin after its end: only scan those heights
+    int start = 0;
+    int end = 0;
+    {
+        LOCK(cs_main);
+        CCoinsViewCache scView(pcoinsTip);
+        CSidechain info;
+        if (scView.GetSidechain(scId, info) && info.SafeguardMargin() >= 0) {
+            start = info.StartHeightForEpoch(fromEpoch + 1);
+            if (toEpoch < info.EpochFor(chainActive.Height()))
+                end = info.StartHeightForEpoch(toEpoch + 1) + info.SafeguardMargin();
+        }
+    }
+
+    std::vector<std::pair<CScIndexKey, CScIndexValue> > scIndex;
+    if (!GetScIndex(scId, scIndex, start, end))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for sidechain");
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<CScIndexKey, CScIndexValue>& entry : scIndex) {
+        if (entry.first.kind != SC_INDEX_CERTIFICATE && entry.first.kind != SC_INDEX_BACKWARD_TRANSFER)
+            continue;
+        if (entry.second.nEpoch < fromEpoch || entry.second.nEpoch > toEpoch)
+            continue;
+        result.push_back(ScIndexEntryToJSON(entry.first, entry.second));
+    }
+    return result;
+}
+
 UniValue getblockfinalityindex(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
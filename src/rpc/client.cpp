@@ -46,6 +46,12 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getbalance", 1 },
     { "getbalance", 2 },
     { "getblockhash", 0 },
+    { "getblockhashes", 0 },
+    { "getblockhashes", 1 },
+    { "getscactivity", 1 },
+    { "getscactivity", 2 },
+    { "getsccertificates", 1 },
+    { "getsccertificates", 2 },
     { "move", 2 },
     { "move", 3 },
     { "sendfrom", 2 },
@@ -102,6 +108,10 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "importaddress", 2 },
     { "verifychain", 0 },
     { "verifychain", 1 },
+    { "getaddressbalance", 0 },
+    { "getaddressdeltas", 0 },
+    { "getaddressutxos", 0 },
+    { "getspentinfo", 0 },
     { "keypoolrefill", 0 },
     { "getrawmempool", 0 },
     { "estimatefee", 0 },
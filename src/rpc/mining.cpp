@@ -18,6 +18,7 @@
 #include "net.h"
 #include "pow.h"
 #include "rpc/server.h"
+#include "scheduler.h"
 #include "txmempool.h"
 #include "util.h"
 #include "validationinterface.h"
@@ -25,9 +26,12 @@
 #include "wallet/wallet.h"
 #endif
 
+#include <list>
 #include <stdint.h>
 
 #include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
+#include <boost/signals2/connection.hpp>
 
 #include <univalue.h>
 
@@ -428,6 +432,170 @@ static UniValue BIP22ValidationResult(const CValidationState& state)
     return "valid?";
 }
 
+/** Seconds after which a long poll is answered on any mempool change */
+static const int64_t LONGPOLL_MEMPOOL_TIMEOUT = 60;
+/** Mempool updates after which a long poll is answered right away */
+static const unsigned int LONGPOLL_MEMPOOL_CHANGES = 1000;
+
+/**
+ * Long polls waiting for a new block template. Instead of each holding a thread, they are
+ * kept here and resumed as soon as the best block changes, or once the mempool changed and
+ * either a minute passed since they started or LONGPOLL_MEMPOOL_CHANGES updates happened.
+ */
+class CLongPollNotifier
+{
+private:
+    struct Waiter
+    {
+        uint256 hashWatchedChain;
+        unsigned int nTransactionsUpdatedLast;
+        int64_t nStart;
+        boost::function<void(void)> resume;
+    };
+
+    boost::mutex cs;
+    std::list<Waiter> waiters;
+    //! null while stopped
+    CScheduler* scheduler;
+    bool fCheckPending;
+    boost::signals2::connection connTip;
+    boost::signals2::connection connAdded;
+    boost::signals2::connection connRemoved;
+
+    static bool IsDue(const Waiter& waiter, const uint256& hashTip, unsigned int nTransactionsUpdated, int64_t nNow)
+    {
+        if (waiter.hashWatchedChain != hashTip)
+            return true;
+        unsigned int nChanges = nTransactionsUpdated - waiter.nTransactionsUpdatedLast;
+        return nChanges != 0 && (nNow - waiter.nStart >= LONGPOLL_MEMPOOL_TIMEOUT || nChanges >= LONGPOLL_MEMPOOL_CHANGES);
+    }
+
+    //! Resume the waiters which are due, or all of them once stopped
+    void Resume(const uint256& hashTip)
+    {
+        // read before taking our lock, as the mempool calls us with its own lock held
+        unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        int64_t nNow = GetTime();
+        std::vector<boost::function<void(void)> > vResume;
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            for (std::list<Waiter>::iterator it = waiters.begin(); it != waiters.end(); ) {
+                if (!scheduler || IsDue(*it, hashTip, nTransactionsUpdated, nNow)) {
+                    vResume.push_back(it->resume);
+                    it = waiters.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (const boost::function<void(void)>& resume : vResume)
+            resume();
+    }
+
+    void Check()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            fCheckPending = false;
+            if (waiters.empty())
+                return;
+        }
+        uint256 hashTip;
+        {
+            LOCK(cs_main);
+            hashTip = chainActive.Tip()->GetBlockHash();
+        }
+        Resume(hashTip);
+    }
+
+    void UpdatedBlockTip(const CBlockIndex* pindex)
+    {
+        Resume(pindex->GetBlockHash());
+    }
+
+    void MempoolChanged(const uint256&)
+    {
+        // The mempool holds its lock and may not have counted this change yet: check from the scheduler
+        boost::lock_guard<boost::mutex> lock(cs);
+        if (scheduler && !waiters.empty() && !fCheckPending) {
+            fCheckPending = true;
+            scheduler->scheduleFromNow(boost::bind(&CLongPollNotifier::Check, this), 0);
+        }
+    }
+
+public:
+    CLongPollNotifier(): scheduler(nullptr), fCheckPending(false) {}
+
+    void Start(CScheduler& schedulerIn)
+    {
+        boost::lock_guard<boost::mutex> lock(cs);
+        scheduler = &schedulerIn;
+        connTip = GetMainSignals().UpdatedBlockTip.connect(boost::bind(&CLongPollNotifier::UpdatedBlockTip, this, _1));
+        connAdded = mempool.NotifyEntryAdded.connect(boost::bind(&CLongPollNotifier::MempoolChanged, this, _1));
+        connRemoved = mempool.NotifyEntryRemoved.connect(boost::bind(&CLongPollNotifier::MempoolChanged, this, _1));
+    }
+
+    void Stop()
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            scheduler = nullptr;
+            connTip.disconnect();
+            connAdded.disconnect();
+            connRemoved.disconnect();
+        }
+        Resume(uint256());
+    }
+
+    //! Call resume once the template of the given longpollid is outdated
+    void Subscribe(const uint256& hashWatchedChain, unsigned int nTransactionsUpdatedLast, const boost::function<void(void)>& resume)
+    {
+        bool fWaiting = false;
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            if (scheduler) {
+                waiters.push_back(Waiter{hashWatchedChain, nTransactionsUpdatedLast, GetTime(), resume});
+                scheduler->scheduleFromNow(boost::bind(&CLongPollNotifier::Check, this), LONGPOLL_MEMPOOL_TIMEOUT);
+                fWaiting = true;
+            }
+        }
+        if (fWaiting)
+            Check(); // the tip may have changed since the long poll looked at it
+        else
+            resume();
+    }
+};
+
+static CLongPollNotifier longPollNotifier;
+
+void StartLongPollNotifier(CScheduler& scheduler)
+{
+    longPollNotifier.Start(scheduler);
+}
+
+void StopLongPollNotifier()
+{
+    longPollNotifier.Stop();
+}
+
+/** Answer a long poll once resumed, as the same call without longpollid */
+static UniValue ResumeBlockTemplate(const UniValue& params)
+{
+    if (!IsRPCRunning())
+        throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Shutting down");
+    // TODO: Maybe recheck connections/IBD and (if something wrong) send an expires-immediately template to stop miners?
+
+    const UniValue& oparam = params[0].get_obj();
+    UniValue oparamNow(UniValue::VOBJ);
+    for (size_t i = 0; i < oparam.size(); i++) {
+        if (oparam.getKeys()[i] != "longpollid")
+            oparamNow.pushKV(oparam.getKeys()[i], oparam.getValues()[i]);
+    }
+    UniValue paramsNow(UniValue::VARR);
+    paramsNow.push_back(oparamNow);
+    return getblocktemplate(paramsNow, false);
+}
+
 UniValue getblocktemplate(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -571,7 +739,6 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     {
         // Wait to respond until either the best block changes, OR a minute has passed and there are more transactions
         uint256 hashWatchedChain;
-        boost::system_time checktxtime;
         unsigned int nTransactionsUpdatedLastLP;
 
         if (lpval.isStr())
@@ -589,28 +756,14 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
             nTransactionsUpdatedLastLP = nTransactionsUpdatedLast;
         }
 
-        // Release the wallet and main lock while waiting
-        LEAVE_CRITICAL_SECTION(cs_main);
-        {
-            checktxtime = boost::get_system_time() + boost::posix_time::minutes(1);
-
-            boost::unique_lock<boost::mutex> lock(csBestBlock);
-            while (chainActive.Tip()->GetBlockHash() == hashWatchedChain && IsRPCRunning())
-            {
-                if (!cvBlockChange.timed_wait(lock, checktxtime))
-                {
-                    // Timeout: Check transactions for update
-                    if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLastLP)
-                        break;
-                    checktxtime += boost::posix_time::seconds(10);
-                }
-            }
-        }
-        ENTER_CRITICAL_SECTION(cs_main);
-
         if (!IsRPCRunning())
             throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Shutting down");
-        // TODO: Maybe recheck connections/IBD and (if something wrong) send an expires-immediately template to stop miners?
+
+        // Have the request set aside, holding neither a thread nor the main lock, until the notifier resumes it
+        if (chainActive.Tip()->GetBlockHash() == hashWatchedChain)
+            throw RPCDeferral(
+                boost::bind(&CLongPollNotifier::Subscribe, &longPollNotifier, hashWatchedChain, nTransactionsUpdatedLastLP, _1),
+                boost::bind(&ResumeBlockTemplate, params));
     }
 
     // Update block
@@ -3,6 +3,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "addressindex.h"
 #include "base58.h"
 #include "clientversion.h"
 #include "init.h"
@@ -10,12 +11,14 @@
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
+#include "spentindex.h"
 #include "util.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
 #include "wallet/walletdb.h"
 #endif
 
+#include <algorithm>
 #include <stdint.h>
 
 #include <boost/assign/list_of.hpp>
@@ -466,3 +469,267 @@ UniValue setmocktime(const UniValue& params, bool fHelp)
 
     return NullUniValue;
 }
+
+static bool GetIndexKey(const CBitcoinAddress& address, uint160& hashBytes, int& type)
+{
+    CTxDestination dest = address.Get();
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        hashBytes = *keyID;
+        type = ADDRESS_INDEX_PUBKEYHASH;
+        return true;
+    }
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        hashBytes = *scriptID;
+        type = ADDRESS_INDEX_SCRIPTHASH;
+        return true;
+    }
+    return false;
+}
+
+static std::string GetAddressFromIndex(int type, const uint160& hash)
+{
+    if (type == ADDRESS_INDEX_SCRIPTHASH)
+        return CBitcoinAddress(CScriptID(hash)).ToString();
+    return CBitcoinAddress(CKeyID(hash)).ToString();
+}
+
+//! The addresses of a request, given either as a string or as an object with an "addresses" array
+static std::vector<std::pair<uint160, int> > GetAddressesFromParams(const UniValue& params)
+{
+    std::vector<std::pair<uint160, int> > addresses;
+    std::vector<UniValue> values;
+    if (params[0].isStr()) {
+        values.push_back(params[0]);
+    } else if (params[0].isObject()) {
+        UniValue addressValues = find_value(params[0].get_obj(), "addresses");
+        if (!addressValues.isArray())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Addresses is expected to be an array");
+        values = addressValues.getValues();
+    } else {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+
+    for (const UniValue& value : values) {
+        CBitcoinAddress address(value.get_str());
+        uint160 hashBytes;
+        int type = ADDRESS_INDEX_NONE;
+        if (!address.IsValid() || !GetIndexKey(address, hashBytes, type))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+        addresses.push_back(std::make_pair(hashBytes, type));
+    }
+    return addresses;
+}
+
+UniValue getaddressbalance(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressbalance\n"
+            "\nReturns the balance for one or more addresses (requires -addressindex).\n"
+            "\nArguments:\n"
+            "{\n"
+            "  \"addresses\"\n"
+            "    [\n"
+            "      \"address\"  (string) The base58check encoded address\n"
+            "      ,...\n"
+            "    ]\n"
+            "}\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\"  (numeric) The current balance in satoshis\n"
+            "  \"received\" (numeric) The total number of satoshis received (including change)\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"znXWB3XGptd6Ss4mYn7aMVNTnxcXbTZHJ9t\"]}'")
+            + HelpExampleRpc("getaddressbalance", "{\"addresses\": [\"znXWB3XGptd6Ss4mYn7aMVNTnxcXbTZHJ9t\"]}")
+        );
+
+    std::vector<std::pair<uint160, int> > addresses = GetAddressesFromParams(params);
+
+    CAmount balance = 0;
+    CAmount received = 0;
+    for (const std::pair<uint160, int>& address : addresses) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        if (!GetAddressIndex(address.first, address.second, addressIndex))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+
+        for (const std::pair<CAddressIndexKey, CAmount>& delta : addressIndex) {
+            if (delta.second > 0)
+                received += delta.second;
+            balance += delta.second;
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("balance", balance));
+    result.push_back(Pair("received", received));
+    return result;
+}
+
+UniValue getaddressdeltas(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressdeltas\n"
+            "\nReturns all changes for one or more addresses (requires -addressindex).\n"
+            "Backward transfers voided by their sidechain ceasing are reported as spent by the block they ceased at.\n"
+            "\nArguments:\n"
+            "{\n"
+            "  \"addresses\"\n"
+            "    [\n"
+            "      \"address\"  (string) The base58check encoded address\n"
+            "      ,...\n"
+            "    ],\n"
+            "  \"start\" (number) The start block height\n"
+            "  \"end\" (number) The end block height\n"
+            "}\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"satoshis\"  (number) The difference of satoshis\n"
+            "    \"txid\"  (string) The related txid\n"
+            "    \"index\"  (number) The related input or output index\n"
+            "    \"blockindex\"  (number) The position of the transaction or certificate in the block\n"
+            "    \"height\"  (number) The block height\n"
+            "    \"address\"  (string) The base58check encoded address\n"
+            "  }\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"znXWB3XGptd6Ss4mYn7aMVNTnxcXbTZHJ9t\"]}'")
+            + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"znXWB3XGptd6Ss4mYn7aMVNTnxcXbTZHJ9t\"]}")
+        );
+
+    int start = 0;
+    int end = 0;
+    if (params[0].isObject()) {
+        UniValue startValue = find_value(params[0].get_obj(), "start");
+        UniValue endValue = find_value(params[0].get_obj(), "end");
+        if (startValue.isNum() && endValue.isNum()) {
+            start = startValue.get_int();
+            end = endValue.get_int();
+            if (start <= 0 || end < start)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Start and end are expected to be a valid range of heights");
+        }
+    }
+
+    std::vector<std::pair<uint160, int> > addresses = GetAddressesFromParams(params);
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<uint160, int>& address : addresses) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        if (!GetAddressIndex(address.first, address.second, addressIndex, start, end))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+
+        std::string strAddress = GetAddressFromIndex(address.second, address.first);
+        for (const std::pair<CAddressIndexKey, CAmount>& delta : addressIndex) {
+            UniValue entry(UniValue::VOBJ);
+            entry.push_back(Pair("satoshis", delta.second));
+            entry.push_back(Pair("txid", delta.first.txid.GetHex()));
+            entry.push_back(Pair("index", (int)delta.first.n));
+            entry.push_back(Pair("blockindex", (int)delta.first.nTxIndex));
+            entry.push_back(Pair("height", delta.first.nHeight));
+            entry.push_back(Pair("address", strAddress));
+            result.push_back(entry);
+        }
+    }
+    return result;
+}
+
+UniValue getaddressutxos(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressutxos\n"
+            "\nReturns all unspent outputs for one or more addresses (requires -addressindex).\n"
+            "\nArguments:\n"
+            "{\n"
+            "  \"addresses\"\n"
+            "    [\n"
+            "      \"address\"  (string) The base58check encoded address\n"
+            "      ,...\n"
+            "    ]\n"
+            "}\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\"  (string) The address base58check encoded\n"
+            "    \"txid\"  (string) The output txid\n"
+            "    \"outputIndex\"  (number) The output index\n"
+            "    \"script\"  (string) The script hex encoded\n"
+            "    \"satoshis\"  (number) The number of satoshis of the output\n"
+            "    \"height\"  (number) The block height\n"
+            "    \"maturityHeight\"  (number, optional) For backward transfers of certificates, the height they can be spent from\n"
+            "  }\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"znXWB3XGptd6Ss4mYn7aMVNTnxcXbTZHJ9t\"]}'")
+            + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"znXWB3XGptd6Ss4mYn7aMVNTnxcXbTZHJ9t\"]}")
+        );
+
+    std::vector<std::pair<uint160, int> > addresses = GetAddressesFromParams(params);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    for (const std::pair<uint160, int>& address : addresses) {
+        if (!GetAddressUnspent(address.first, address.second, unspentOutputs))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    }
+
+    std::stable_sort(unspentOutputs.begin(), unspentOutputs.end(),
+        [](const std::pair<CAddressUnspentKey, CAddressUnspentValue>& a, const std::pair<CAddressUnspentKey, CAddressUnspentValue>& b) {
+            return a.second.nHeight < b.second.nHeight;
+        });
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<CAddressUnspentKey, CAddressUnspentValue>& unspent : unspentOutputs) {
+        UniValue output(UniValue::VOBJ);
+        output.push_back(Pair("address", GetAddressFromIndex(unspent.first.addressType, unspent.first.addressHash)));
+        output.push_back(Pair("txid", unspent.first.txid.GetHex()));
+        output.push_back(Pair("outputIndex", (int)unspent.first.n));
+        output.push_back(Pair("script", HexStr(unspent.second.script.begin(), unspent.second.script.end())));
+        output.push_back(Pair("satoshis", unspent.second.nValue));
+        output.push_back(Pair("height", unspent.second.nHeight));
+        if (unspent.second.nBwtMaturityHeight != 0)
+            output.push_back(Pair("maturityHeight", unspent.second.nBwtMaturityHeight));
+        result.push_back(output);
+    }
+    return result;
+}
+
+UniValue getspentinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1 || !params[0].isObject())
+        throw runtime_error(
+            "getspentinfo\n"
+            "\nReturns the txid and index where an output is spent (requires -spentindex).\n"
+            "\nArguments:\n"
+            "{\n"
+            "  \"txid\" (string) The hex string of the txid\n"
+            "  \"index\" (number) The output index\n"
+            "}\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\"  (string) The transaction or certificate id\n"
+            "  \"index\"  (number) The spending input index\n"
+            "  \"height\"  (number) The height of the block spending the output\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'")
+            + HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}")
+        );
+
+    UniValue txidValue = find_value(params[0].get_obj(), "txid");
+    UniValue indexValue = find_value(params[0].get_obj(), "index");
+    if (!txidValue.isStr() || !indexValue.isNum())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid txid or index");
+
+    CSpentIndexKey key(ParseHashV(txidValue, "txid"), indexValue.get_int());
+    CSpentIndexValue value;
+    if (!GetSpentIndex(key, value))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("txid", value.txid.GetHex()));
+    result.push_back(Pair("index", (int)value.nInput));
+    result.push_back(Pair("height", value.nHeight));
+    return result;
+}
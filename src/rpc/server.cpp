@@ -265,6 +265,8 @@ static const CRPCCommand vRPCCommands[] =
     { "control",            "dbg_do",                 &dbg_do,                 true  },
     { "control",            "getscinfo",              &getscinfo,              true  },
     { "control",            "getscgenesisinfo",       &getscgenesisinfo,       true  },
+    { "control",            "getscactivity",          &getscactivity,          true  },
+    { "control",            "getsccertificates",      &getsccertificates,      true  },
 
     /* P2P networking */
     { "network",            "getnetworkinfo",         &getnetworkinfo,         true  },
@@ -285,6 +287,7 @@ static const CRPCCommand vRPCCommands[] =
     { "blockchain",         "getblockcount",          &getblockcount,          true  },
     { "blockchain",         "getblock",               &getblock,               true  },
     { "blockchain",         "getblockhash",           &getblockhash,           true  },
+    { "blockchain",         "getblockhashes",         &getblockhashes,         true  },
     { "blockchain",         "getblockfinalityindex",  &getblockfinalityindex,  true  },
     { "blockchain",         "getglobaltips",          &getglobaltips,          true  },
     { "blockchain",         "getblockheader",         &getblockheader,         true  },
@@ -297,6 +300,12 @@ static const CRPCCommand vRPCCommands[] =
     { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true  },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
+    { "blockchain",         "getspentinfo",           &getspentinfo,           true  },
+
+    /* Address index */
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      true  },
+    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       true  },
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        true  },
 
     /* Mining */
     { "mining",             "getblocktemplate",       &getblocktemplate,       true  },
@@ -576,7 +585,28 @@ std::string JSONRPCExecBatch(const UniValue& vReq)
     return ret.write() + "\n";
 }
 
-UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params) const
+/** Wait in the calling thread until a deferred method is ready to answer */
+static void WaitForResume(const RPCDeferral& deferral)
+{
+    struct Resumed
+    {
+        boost::mutex cs;
+        boost::condition_variable cond;
+        bool fResumed = false;
+    };
+    // shared with the subscribed function, which may outlive this call
+    std::shared_ptr<Resumed> resumed = std::make_shared<Resumed>();
+    deferral.subscribe([resumed]() {
+        boost::lock_guard<boost::mutex> lock(resumed->cs);
+        resumed->fResumed = true;
+        resumed->cond.notify_all();
+    });
+    boost::unique_lock<boost::mutex> lock(resumed->cs);
+    while (!resumed->fResumed)
+        resumed->cond.wait(lock);
+}
+
+UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params, bool fAllowDeferral) const
 {
     // Return immediately if in warmup
     {
@@ -597,6 +627,20 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
         // Execute
         return pcmd->actor(params, false);
     }
+    catch (const RPCDeferral& deferral)
+    {
+        if (fAllowDeferral)
+            throw;
+        WaitForResume(deferral);
+        try
+        {
+            return deferral.resume();
+        }
+        catch (const std::exception& e)
+        {
+            throw JSONRPCError(RPC_MISC_ERROR, e.what());
+        }
+    }
     catch (const std::exception& e)
     {
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
@@ -22,6 +22,7 @@
 
 class AsyncRPCQueue;
 class CRPCCommand;
+class CScheduler;
 
 namespace RPCServer
 {
@@ -117,6 +118,22 @@ void RPCUnregisterTimerInterface(RPCTimerInterface *iface);
  */
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
+/**
+ * Thrown by an RPC method which cannot answer yet, such as a long poll, instead of holding
+ * the calling thread until it can. The caller passes subscribe a function, which is called
+ * once, from any thread, when resume is ready to compute the answer.
+ */
+class RPCDeferral
+{
+public:
+    boost::function<void(const boost::function<void(void)>&)> subscribe;
+    boost::function<UniValue(void)> resume;
+
+    RPCDeferral(const boost::function<void(const boost::function<void(void)>&)>& subscribe,
+                const boost::function<UniValue(void)>& resume):
+        subscribe(subscribe), resume(resume) {}
+};
+
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
 
 class CRPCCommand
@@ -144,10 +161,11 @@ public:
      * Execute a method.
      * @param method   Method to execute
      * @param params   UniValue Array of arguments (JSON objects)
+     * @param fAllowDeferral  Let the method throw RPCDeferral rather than wait in this thread
      * @returns Result of the call.
      * @throws an exception (UniValue) when an error happens.
      */
-    UniValue execute(const std::string &method, const UniValue &params) const;
+    UniValue execute(const std::string &method, const UniValue &params, bool fAllowDeferral = false) const;
 };
 
 extern const CRPCTable tableRPC;
@@ -272,6 +290,7 @@ extern UniValue settxfee(const UniValue& params, bool fHelp);
 extern UniValue getmempoolinfo(const UniValue& params, bool fHelp);
 extern UniValue getrawmempool(const UniValue& params, bool fHelp);
 extern UniValue getblockhash(const UniValue& params, bool fHelp);
+extern UniValue getblockhashes(const UniValue& params, bool fHelp);
 extern UniValue getblockheader(const UniValue& params, bool fHelp);
 extern UniValue getblock(const UniValue& params, bool fHelp);
 extern UniValue getblockfinalityindex(const UniValue& params, bool fHelp);
@@ -305,11 +324,17 @@ extern UniValue create_sidechain(const UniValue& params, bool fHelp); // in rpcw
 extern UniValue send_to_sidechain(const UniValue& params, bool fHelp); // in rpcwallet.cpp
 extern UniValue getscinfo(const UniValue& params, bool fHelp); 
 extern UniValue getscgenesisinfo(const UniValue& params, bool fHelp); 
+extern UniValue getscactivity(const UniValue& params, bool fHelp);
+extern UniValue getsccertificates(const UniValue& params, bool fHelp);
 extern UniValue z_shieldcoinbase(const UniValue& params, bool fHelp); // in rpcwallet.cpp
 extern UniValue z_getoperationstatus(const UniValue& params, bool fHelp); // in rpcwallet.cpp
 extern UniValue z_getoperationresult(const UniValue& params, bool fHelp); // in rpcwallet.cpp
 extern UniValue z_listoperationids(const UniValue& params, bool fHelp); // in rpcwallet.cpp
 extern UniValue z_validateaddress(const UniValue& params, bool fHelp); // in rpcmisc.cpp
+extern UniValue getaddressbalance(const UniValue& params, bool fHelp); // in rpcmisc.cpp
+extern UniValue getaddressdeltas(const UniValue& params, bool fHelp); // in rpcmisc.cpp
+extern UniValue getaddressutxos(const UniValue& params, bool fHelp); // in rpcmisc.cpp
+extern UniValue getspentinfo(const UniValue& params, bool fHelp); // in rpcmisc.cpp
 extern UniValue z_getpaymentdisclosure(const UniValue& params, bool fHelp); // in rpcdisclosure.cpp
 extern UniValue z_validatepaymentdisclosure(const UniValue &params, bool fHelp); // in rpcdisclosure.cpp
 
@@ -321,6 +346,10 @@ extern UniValue dbg_do(const UniValue &params, bool fHelp); // does a dbg hard c
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
+/** Resume getblocktemplate long polls on new tips and mempool changes (in rpc/mining.cpp) */
+void StartLongPollNotifier(CScheduler& scheduler);
+/** Resume all pending long polls, which then fail, and stop following the chain */
+void StopLongPollNotifier();
 std::string JSONRPCExecBatch(const UniValue& vReq);
 
 #endif // BITCOIN_RPCSERVER_H
@@ -2,7 +2,9 @@
 #include "primitives/certificate.h"
 
 #include "main.h"
+#include "proofcache.h"
 
+#include "hash.h"
 #include "util.h"
 #include "sync.h"
 #include "tinyformat.h"
@@ -65,27 +67,107 @@ namespace libzendoomc{
         return true;
     }
 
-    // Let's define a struct to hold the inputs, with a function to free the memory Rust-side
+    CScVkCache& CScVkCache::Instance()
+    {
+        static CScVkCache cache;
+        return cache;
+    }
+
+    uint256 CScVkCache::DataHash(const ScConstant& constant, const ScVk& wCertVk)
+    {
+        return Hash(wCertVk.begin(), wCertVk.end(), constant.data(), constant.data() + constant.size());
+    }
+
+    bool CScVkCache::Get(const uint256& scId, const uint256& dataHash, VkHandle& vk, FieldHandle& constant)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        auto it = mapEntries.find(scId);
+        if (it == mapEntries.end() || it->second.dataHash != dataHash)
+            return false;
+
+        lruList.splice(lruList.begin(), lruList, it->second.lruIt);
+        vk = it->second.vk;
+        constant = it->second.constant;
+        return true;
+    }
+
+    void CScVkCache::Put(const uint256& scId, const uint256& dataHash, const VkHandle& vk, const FieldHandle& constant)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        auto it = mapEntries.find(scId);
+        if (it != mapEntries.end())
+        {
+            lruList.splice(lruList.begin(), lruList, it->second.lruIt);
+        } else
+        {
+            lruList.push_front(scId);
+            it = mapEntries.insert(std::make_pair(scId, Entry())).first;
+            it->second.lruIt = lruList.begin();
+        }
+        it->second.dataHash = dataHash;
+        it->second.vk = vk;
+        it->second.constant = constant;
+        EvictExceeding();
+    }
+
+    void CScVkCache::Erase(const uint256& scId)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        auto it = mapEntries.find(scId);
+        if (it == mapEntries.end())
+            return;
+
+        LogPrint("zendoo_mc_cryptolib", "%s():%d - dropping cached vk for scId %s\n", __func__, __LINE__, scId.ToString());
+        lruList.erase(it->second.lruIt);
+        mapEntries.erase(it);
+    }
+
+    void CScVkCache::Clear()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        lruList.clear();
+        mapEntries.clear();
+    }
+
+    size_t CScVkCache::Size()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return mapEntries.size();
+    }
+
+    void CScVkCache::SetMaxEntries(size_t nMaxEntriesIn)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nMaxEntries = nMaxEntriesIn;
+        EvictExceeding();
+    }
+
+    void CScVkCache::EvictExceeding()
+    {
+        // handles still in use by a running verification are kept alive by their shared_ptr
+        while (mapEntries.size() > nMaxEntries)
+        {
+            mapEntries.erase(lruList.back());
+            lruList.pop_back();
+        }
+    }
+
+    // Let's define a struct to hold the inputs, with a function to free the memory Rust-side.
+    // Vk and constant are shared with CScVkCache, hence they are released by their handles.
     struct WCertVerifierInputs {
         std::vector<backward_transfer_t> bt_list;
-        field_t* constant;
+        CScVkCache::FieldHandle constant;
         field_t* proofdata;
         sc_proof_t* sc_proof;
-        sc_vk_t* sc_vk;
+        CScVkCache::VkHandle sc_vk;
 
         ~WCertVerifierInputs(){
 
-            zendoo_field_free(constant);
-            constant = nullptr;
-
             zendoo_field_free(proofdata);
             proofdata = nullptr;
 
             zendoo_sc_proof_free(sc_proof);
             sc_proof = nullptr;
-
-            zendoo_sc_vk_free(sc_vk);
-            sc_vk = nullptr;
         }
     };
 
@@ -99,23 +181,40 @@ namespace libzendoomc{
 
         WCertVerifierInputs inputs;
 
-        //Deserialize constant
-        if (constant.size() == 0){ //Constant can be optional
-            inputs.constant = nullptr;
-       
-        } else {
-            
-            inputs.constant = deserialize_field(constant.data()); 
-            
-            if (inputs.constant == nullptr) {
-                
+        //Retrieve constant and sc_vk from cache, deserializing them if not there
+        const uint256 vkDataHash = CScVkCache::DataHash(constant, wCertVk);
+        if (!CScVkCache::Instance().Get(scCert.GetScId(), vkDataHash, inputs.sc_vk, inputs.constant))
+        {
+            //Deserialize constant
+            if (constant.size() != 0){ //Constant can be optional
+
+                inputs.constant.reset(deserialize_field(constant.data()), zendoo_field_free);
+
+                if (inputs.constant == nullptr) {
+
+                    LogPrint("zendoo_mc_cryptolib",
+                            "%s():%d - failed to deserialize \"constant\": %s \n", 
+                            __func__, __LINE__, ToString(zendoo_get_last_error()));
+                    zendoo_clear_error();
+
+                    return false;
+                }
+            }
+
+            //Deserialize sc_vk
+            inputs.sc_vk.reset(deserialize_sc_vk(wCertVk.begin()), zendoo_sc_vk_free);
+
+            if (inputs.sc_vk == nullptr){
+
                 LogPrint("zendoo_mc_cryptolib",
-                        "%s():%d - failed to deserialize \"constant\": %s \n", 
-                        __func__, __LINE__, ToString(zendoo_get_last_error()));
+                    "%s():%d - failed to deserialize \"wCertVk\": %s \n", 
+                    __func__, __LINE__, ToString(zendoo_get_last_error()));
                 zendoo_clear_error();
 
                 return false;
             }
+
+            CScVkCache::Instance().Put(scCert.GetScId(), vkDataHash, inputs.sc_vk, inputs.constant);
         }
 
         //Initialize quality and proofdata
@@ -136,19 +235,6 @@ namespace libzendoomc{
             return false;
         }
 
-        //Deserialize sc_vk
-        inputs.sc_vk = deserialize_sc_vk(wCertVk.begin());
-
-        if (inputs.sc_vk == nullptr){
-
-            LogPrint("zendoo_mc_cryptolib",
-                "%s():%d - failed to deserialize \"wCertVk\": %s \n", 
-                __func__, __LINE__, ToString(zendoo_get_last_error()));
-            zendoo_clear_error();
-
-            return false;
-        }
-
         //Retrieve BT list
         for(int pos = scCert.nFirstBwtPos; pos < scCert.GetVout().size(); ++pos)
         {
@@ -179,7 +265,7 @@ namespace libzendoomc{
         // Call verifier
         if (!verify_sc_proof(scCert.endEpochBlockHash.begin(), prev_end_epoch_block_hash.begin(),
                             inputs.bt_list.data(), inputs.bt_list.size(), scCert.quality,
-                            inputs.constant, inputs.proofdata, inputs.sc_proof, inputs.sc_vk))
+                            inputs.constant.get(), inputs.proofdata, inputs.sc_proof, inputs.sc_vk.get()))
         {
             Error err = zendoo_get_last_error();
             if (err.category == CRYPTO_ERROR){ // Proof verification returned false due to an error, we must log it
@@ -193,16 +279,52 @@ namespace libzendoomc{
         return true;
     }
 
+    bool CScCertProofCheck::operator()()
+    {
+        if (!CScWCertProofVerification().verifyScCert(constant, wCertVk, prevEndEpochBlockHash, *pCert))
+        {
+            LogPrintf("ERROR: certificate[%s] cannot be accepted for sidechain [%s]: proof verification failed\n",
+                pCert->GetHash().ToString(), pCert->GetScId().ToString());
+            return false;
+        }
+        return true;
+    }
+
+    void CScCertProofCheck::swap(CScCertProofCheck& check)
+    {
+        constant.swap(check.constant);
+        std::swap(wCertVk, check.wCertVk);
+        std::swap(prevEndEpochBlockHash, check.prevEndEpochBlockHash);
+        std::swap(pCert, check.pCert);
+    }
+
     bool CScProofVerifier::verifyCScCertificate(
         const ScConstant& constant,
         const ScVk& wCertVk,
         const uint256& prev_end_epoch_block_hash,
-        const CScCertificate& cert
+        const CScCertificate& cert,
+        std::vector<CScCertProofCheck>* pvChecks
     ) const 
     {
         if(!perform_verification)
             return true;
-        else
-            return CScWCertProofVerification().verifyScCert(constant, wCertVk, prev_end_epoch_block_hash, cert);
+
+        const uint256 vkDataHash = CScVkCache::DataHash(constant, wCertVk);
+        if (IsCertProofCached(cert.GetHash(), vkDataHash, prev_end_epoch_block_hash))
+            return true;
+
+        if (pvChecks != nullptr)
+        {
+            pvChecks->push_back(CScCertProofCheck(constant, wCertVk, prev_end_epoch_block_hash, cert));
+            return true;
+        }
+
+        // only inline verifications (e.g. at mempool admission) populate the cache, the deferred ones
+        // are performed on block connection, when the same certificate is not expected to show up again
+        if (!CScWCertProofVerification().verifyScCert(constant, wCertVk, prev_end_epoch_block_hash, cert))
+            return false;
+
+        CacheCertProof(cert.GetHash(), vkDataHash, prev_end_epoch_block_hash);
+        return true;
     }
 }
@@ -6,6 +6,11 @@
 #include "uint256.h"
 
 #include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <boost/thread/mutex.hpp>
 #include <boost/foreach.hpp>
 #include <boost/variant.hpp>
 #include <boost/filesystem.hpp>
@@ -36,6 +41,53 @@ namespace libzendoomc{
     /* Write scVk to file in vkPath. Returns true if operation succeeds, false otherwise. */
     bool SaveScVkToFile(const boost::filesystem::path& vkPath, const ScVk& scVk);
 
+    /*
+     * Bounded, thread-safe LRU cache of the deserialized verification key and constant of sidechains,
+     * keyed by scId. They never change after sidechain creation, hence certificate verification can reuse
+     * the handles instead of deserializing them (curve points decompression) for each certificate.
+     * Each entry also stores the hash of the serialized data it was built from, so that an entry can never
+     * be used for a different vk/constant pair (e.g. a sidechain re-created after a reorg).
+     */
+    class CScVkCache {
+        public:
+            typedef std::shared_ptr<sc_vk_t> VkHandle;
+            typedef std::shared_ptr<field_t> FieldHandle;
+
+            static const size_t DEFAULT_MAX_ENTRIES = 128;
+
+            static CScVkCache& Instance();
+
+            // Hash identifying the serialized vk/constant pair an entry has been built from
+            static uint256 DataHash(const ScConstant& constant, const ScVk& wCertVk);
+
+            // Returns true and fills vk and constant handles if scId is cached with the given data hash
+            bool Get(const uint256& scId, const uint256& dataHash, VkHandle& vk, FieldHandle& constant);
+            void Put(const uint256& scId, const uint256& dataHash, const VkHandle& vk, const FieldHandle& constant);
+            void Erase(const uint256& scId);
+            void Clear();
+            size_t Size();
+            void SetMaxEntries(size_t nMaxEntriesIn);
+
+        private:
+            struct Entry {
+                uint256 dataHash;
+                VkHandle vk;
+                FieldHandle constant;
+                std::list<uint256>::iterator lruIt;
+            };
+
+            boost::mutex mutex;
+            size_t nMaxEntries;
+            // most recently used scIds at the front
+            std::list<uint256> lruList;
+            std::map<uint256, Entry> mapEntries;
+
+            CScVkCache(): nMaxEntries(DEFAULT_MAX_ENTRIES) {}
+            CScVkCache(const CScVkCache&) = delete;
+            CScVkCache& operator=(const CScVkCache&) = delete;
+            void EvictExceeding();
+    };
+
     /* Support class for WCert SNARK proof verification. */
     class CScWCertProofVerification {
         public:
@@ -87,6 +139,31 @@ namespace libzendoomc{
             }
     };
 
+    /*
+     * Closure representing one certificate SNARK proof verification, suitable for being executed
+     * later on a CCheckQueue. Note that this stores a reference to the certificate, which must
+     * outlive the check; verification key and constant are copied.
+     */
+    class CScCertProofCheck {
+        private:
+            ScConstant constant;
+            ScVk wCertVk;
+            uint256 prevEndEpochBlockHash;
+            const CScCertificate* pCert;
+
+        public:
+            CScCertProofCheck(): pCert(nullptr) {}
+            CScCertProofCheck(
+                const ScConstant& constantIn,
+                const ScVk& wCertVkIn,
+                const uint256& prevEndEpochBlockHashIn,
+                const CScCertificate& certIn
+            ): constant(constantIn), wCertVk(wCertVkIn), prevEndEpochBlockHash(prevEndEpochBlockHashIn), pCert(&certIn) {}
+
+            bool operator()();
+            void swap(CScCertProofCheck& check);
+    };
+
     /* Class for instantiating a verifier able to verify different kind of ScProof for different kind of ScProof(s) */
     class CScProofVerifier {
         protected:
@@ -110,11 +187,14 @@ namespace libzendoomc{
 
             // Returns false if proof verification has failed or deserialization of certificate's elements
             // into libzendoomc's elements has failed.
+            // If pvChecks is not null, the verification is not performed here: a CScCertProofCheck is
+            // appended to it instead, and the caller is in charge of running it (e.g. on a CCheckQueue).
             bool verifyCScCertificate(
                 const ScConstant& constant,
                 const ScVk& wCertVk,
                 const uint256& prev_end_epoch_block_hash,
-                const CScCertificate& scCert
+                const CScCertificate& scCert,
+                std::vector<CScCertProofCheck>* pvChecks = nullptr
             ) const;
     };
 }
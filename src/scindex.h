@@ -0,0 +1,108 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SCINDEX_H
+#define BITCOIN_SCINDEX_H
+
+#include "amount.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+/** Kinds of sidechain activity indexed by -scindex */
+enum ScIndexKind {
+    SC_INDEX_CREATION = 0,
+    SC_INDEX_FORWARD_TRANSFER = 1,
+    SC_INDEX_CERTIFICATE = 2,
+    SC_INDEX_BACKWARD_TRANSFER = 3,
+};
+
+/**
+ * Key of an output or certificate concerning a sidechain. Heights are stored big-endian, so that the
+ * activity of a sidechain is sorted by the order it happened in the chain.
+ */
+struct CScIndexKey
+{
+    uint256 scId;
+    int nHeight;
+    uint8_t kind;
+    //! the transaction or certificate
+    uint256 txid;
+    //! index of the output among the sidechain creations, forward transfers or outputs, 0 for certificates
+    unsigned int n;
+
+    CScIndexKey(): nHeight(0), kind(SC_INDEX_CREATION), n(0) {}
+    CScIndexKey(const uint256& scIdIn, int nHeightIn, uint8_t kindIn, const uint256& txidIn, unsigned int nIn):
+        scId(scIdIn), nHeight(nHeightIn), kind(kindIn), txid(txidIn), n(nIn) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 73;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        scId.Serialize(s, nType, nVersion);
+        ser_writedata32be(s, nHeight);
+        ser_writedata8(s, kind);
+        txid.Serialize(s, nType, nVersion);
+        ser_writedata32(s, n);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        scId.Unserialize(s, nType, nVersion);
+        nHeight = ser_readdata32be(s);
+        kind = ser_readdata8(s);
+        txid.Unserialize(s, nType, nVersion);
+        n = ser_readdata32(s);
+    }
+};
+
+/** Prefix of the keys of the activity of a sidechain, optionally from a given height on */
+struct CScIndexIteratorKey
+{
+    uint256 scId;
+    int nHeight;
+    bool fHeight;
+
+    explicit CScIndexIteratorKey(const uint256& scIdIn): scId(scIdIn), nHeight(0), fHeight(false) {}
+    CScIndexIteratorKey(const uint256& scIdIn, int nHeightIn): scId(scIdIn), nHeight(nHeightIn), fHeight(true) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return fHeight ? 36 : 32;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        scId.Serialize(s, nType, nVersion);
+        if (fHeight)
+            ser_writedata32be(s, nHeight);
+    }
+};
+
+/** What an indexed output or certificate moved */
+struct CScIndexValue
+{
+    //! the amount of the output; for certificates, the total of their backward transfers
+    CAmount nValue;
+    //! for certificates and backward transfers, the epoch the certificate is for; -1 otherwise
+    int nEpoch;
+    //! for sidechain creations and forward transfers, the receiver in the sidechain
+    uint256 address;
+    //! for backward transfers, the script paying the receiver in the mainchain
+    CScript script;
+
+    CScIndexValue(): nValue(0), nEpoch(-1) {}
+    CScIndexValue(CAmount nValueIn, int nEpochIn, const uint256& addressIn, const CScript& scriptIn):
+        nValue(nValueIn), nEpoch(nEpochIn), address(addressIn), script(scriptIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nValue);
+        READWRITE(nEpoch);
+        READWRITE(address);
+        READWRITE(script);
+    }
+};
+
+#endif // BITCOIN_SCINDEX_H
@@ -1064,21 +1064,34 @@ public:
             ::Serialize(s, txBaseTo.GetVout()[nOutput], nType, nVersion);
     }
  
-    /** Serialize txTo */
+    /** Serialize what comes before the inputs of txTo, including their number */
     template<typename S>
-    void Serialize(S &s, int nType, int nVersion) const {
+    void SerializePrefix(S &s, int nType, int nVersion) const {
 
         // Serialize nVersion for both tx and cert
         ::Serialize(s, txBaseTo.nVersion, nType, nVersion);
 
+        if (txBaseTo.IsCertificate()) {
+            const CScCertificate& certTo = dynamic_cast<const CScCertificate&>(txBaseTo);
+
+            ::Serialize(s, certTo.GetScId(), nType, nVersion);
+            ::Serialize(s, certTo.epochNumber, nType, nVersion);
+            ::Serialize(s, certTo.quality, nType, nVersion);
+            ::Serialize(s, certTo.endEpochBlockHash, nType, nVersion);
+            ::Serialize(s, certTo.scProof, nType, nVersion);
+        }
+
+        unsigned int nInputs = fAnyoneCanPay ? 1 : txBaseTo.GetVin().size();
+        ::WriteCompactSize(s, nInputs);
+    }
+
+    /** Serialize what comes after the inputs of txTo */
+    template<typename S>
+    void SerializeSuffix(S &s, int nType, int nVersion) const {
+
         if (!txBaseTo.IsCertificate() ) {
             const CTransaction& txTo = dynamic_cast<const CTransaction&>(txBaseTo);
 
-            // Serialize vin
-            unsigned int nInputs = fAnyoneCanPay ? 1 : txTo.GetVin().size();
-            ::WriteCompactSize(s, nInputs);
-            for (unsigned int nInput = 0; nInput < nInputs; nInput++)
-             SerializeInput(s, nInput, nType, nVersion);
             // Serialize vout
             unsigned int nOutputs = fHashNone ? 0 : (fHashSingle ? nIn+1 : txTo.GetVout().size());
             ::WriteCompactSize(s, nOutputs);
@@ -1126,18 +1139,6 @@ public:
         {
             const CScCertificate& certTo = dynamic_cast<const CScCertificate&>(txBaseTo);
 
-            ::Serialize(s, certTo.GetScId(), nType, nVersion);
-            ::Serialize(s, certTo.epochNumber, nType, nVersion);
-            ::Serialize(s, certTo.quality, nType, nVersion);
-            ::Serialize(s, certTo.endEpochBlockHash, nType, nVersion);
-            ::Serialize(s, certTo.scProof, nType, nVersion);
-
-            // Serialize vin
-            unsigned int nInputs = fAnyoneCanPay ? 1 : certTo.GetVin().size();
-            ::WriteCompactSize(s, nInputs);
-            for (unsigned int nInput = 0; nInput < nInputs; nInput++)
-                 SerializeInput(s, nInput, nType, nVersion);
-
             // Serialize vout
 
             // split bwd transfer and change
@@ -1165,6 +1166,19 @@ public:
                 ::Serialize(s, vbt_ccout_ser[nOutput], nType, nVersion);
         }
     }
+
+    /** Serialize txTo */
+    template<typename S>
+    void Serialize(S &s, int nType, int nVersion) const {
+        SerializePrefix(s, nType, nVersion);
+
+        // Serialize vin
+        unsigned int nInputs = fAnyoneCanPay ? 1 : txBaseTo.GetVin().size();
+        for (unsigned int nInput = 0; nInput < nInputs; nInput++)
+            SerializeInput(s, nInput, nType, nVersion);
+
+        SerializeSuffix(s, nType, nVersion);
+    }
 };
 
 } // anon namespace
@@ -1219,12 +1233,58 @@ uint256 SignatureHash(const CScript& scriptCode, const CScCertificate& certTo, u
     return ss.GetHash();
 }
 
+PrecomputedTransactionData::PrecomputedTransactionData(const CTransactionBase& txToIn): txTo(txToIn)
+{
+    // with no input being signed, every input gets its script blanked out
+    CScript scriptCode;
+    CTransactionSignatureSerializer txTmp(txTo, scriptCode, NOT_AN_INPUT, SIGHASH_ALL);
+
+    CHashWriter ss(SER_GETHASH, 0);
+    txTmp.SerializePrefix(ss, SER_GETHASH, 0);
+
+    CDataStream ssInputs(SER_GETHASH, 0);
+    vMidstates.reserve(txTo.GetVin().size());
+    vInputOffsets.reserve(txTo.GetVin().size() + 1);
+    for (unsigned int nInput = 0; nInput < txTo.GetVin().size(); nInput++) {
+        vMidstates.push_back(ss);
+        vInputOffsets.push_back(ssInputs.size());
+        size_t nOffset = ssInputs.size();
+        txTmp.SerializeInput(ssInputs, nInput, SER_GETHASH, 0);
+        ss.write(&ssInputs[nOffset], ssInputs.size() - nOffset);
+    }
+    vInputOffsets.push_back(ssInputs.size());
+    vchInputs.assign(ssInputs.begin(), ssInputs.end());
+
+    CDataStream ssSuffix(SER_GETHASH, 0);
+    txTmp.SerializeSuffix(ssSuffix, SER_GETHASH, 0);
+    vchSuffix.assign(ssSuffix.begin(), ssSuffix.end());
+}
+
+uint256 PrecomputedTransactionData::SignatureHashAll(const CScript& scriptCode, unsigned int nIn) const
+{
+    if (nIn >= vMidstates.size()) {
+        //  nIn out of range
+        throw logic_error("input index is out of range");
+    }
+
+    CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, SIGHASH_ALL);
+
+    CHashWriter ss = vMidstates[nIn];
+    txTmp.SerializeInput(ss, nIn, SER_GETHASH, 0);
+    ss.write((const char*)vchInputs.data() + vInputOffsets[nIn + 1], vchInputs.size() - vInputOffsets[nIn + 1]);
+    ss.write((const char*)vchSuffix.data(), vchSuffix.size());
+    ss << (int)SIGHASH_ALL;
+    return ss.GetHash();
+}
+
 TransactionSignatureChecker::TransactionSignatureChecker(const CTransaction* txToIn,
                                                          unsigned int nInIn,
-                                                         const CChain* chainIn):
+                                                         const CChain* chainIn,
+                                                         const PrecomputedTransactionData* txdataIn):
                                                            txTo(txToIn),
                                                            nIn(nInIn),
-                                                           chain(chainIn) {}
+                                                           chain(chainIn),
+                                                           txdata(txdataIn) {}
 
 bool TransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
@@ -1246,7 +1306,10 @@ bool TransactionSignatureChecker::CheckSig(const vector<unsigned char>& vchSigIn
 
     uint256 sighash;
     try {
-        sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType);
+        if (txdata && nHashType == SIGHASH_ALL)
+            sighash = txdata->SignatureHashAll(scriptCode, nIn);
+        else
+            sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType);
     } catch (const logic_error& ex) {
         return false;
     }
@@ -1331,10 +1394,12 @@ bool TransactionSignatureChecker::CheckBlockHash(const int32_t nHeight, const st
 
 CertificateSignatureChecker::CertificateSignatureChecker(const CScCertificate* certToIn,
                                                          unsigned int nInIn,
-                                                         const CChain* chainIn):
+                                                         const CChain* chainIn,
+                                                         const PrecomputedTransactionData* txdataIn):
                                                            certTo(certToIn),
                                                            nIn(nInIn),
-                                                           chain(chainIn) {}
+                                                           chain(chainIn),
+                                                           txdata(txdataIn) {}
 
 bool CertificateSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
@@ -1363,7 +1428,10 @@ bool CertificateSignatureChecker::CheckSig(const vector<unsigned char>& vchSigIn
 
     uint256 sighash;
     try {
-        sighash = SignatureHash(scriptCode, *certTo, nIn, nHashType);
+        if (txdata)
+            sighash = txdata->SignatureHashAll(scriptCode, nIn);
+        else
+            sighash = SignatureHash(scriptCode, *certTo, nIn, nHashType);
     } catch (const logic_error& ex) {
         return false;
     }
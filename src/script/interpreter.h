@@ -6,6 +6,7 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include "hash.h"
 #include "script_error.h"
 #include "primitives/transaction.h"
 #include "primitives/certificate.h"
@@ -98,6 +99,36 @@ static const unsigned int CONTEXTUAL_SCRIPT_VERIFY_FLAGS = SCRIPT_VERIFY_CHECKBL
 uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
 uint256 SignatureHash(const CScript &scriptCode, const CScCertificate& certTo, unsigned int nIn, int nHashType);
 
+/**
+ * The parts of the SIGHASH_ALL signature hash serialization of a transaction or certificate which do not
+ * depend on the input being signed, computed once for all its inputs. Without it the whole transaction is
+ * serialized and hashed again for every input, which is quadratic in the number of inputs.
+ * txTo must outlive this object and must not change, apart from the scriptSig of its inputs.
+ */
+class PrecomputedTransactionData
+{
+private:
+    const CTransactionBase& txTo;
+
+    //! hasher state after what comes before the inputs, then after each input with its script blanked out
+    std::vector<CHashWriter> vMidstates;
+
+    //! the inputs with their script blanked out, serialized one after the other
+    std::vector<unsigned char> vchInputs;
+
+    //! where each input starts in vchInputs, followed by the size of vchInputs
+    std::vector<size_t> vInputOffsets;
+
+    //! what comes after the inputs
+    std::vector<unsigned char> vchSuffix;
+
+public:
+    explicit PrecomputedTransactionData(const CTransactionBase& txToIn);
+
+    //! Same as SignatureHash(scriptCode, txTo, nIn, SIGHASH_ALL)
+    uint256 SignatureHashAll(const CScript& scriptCode, unsigned int nIn) const;
+};
+
 class BaseSignatureChecker
 {
 public:
@@ -125,12 +156,14 @@ private:
     const CTransaction* txTo;
     unsigned int nIn;
     const CChain* chain;
+    const PrecomputedTransactionData* txdata;
 
 protected:
     virtual bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 
 public:
-    TransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CChain* chainIn);
+    TransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CChain* chainIn,
+                                const PrecomputedTransactionData* txdataIn = nullptr);
     bool CheckSig(const std::vector<unsigned char>& scriptSig, const std::vector<unsigned char>& vchPubKey, const CScript& scriptCode) const;
     bool CheckLockTime(const CScriptNum& nLockTime) const;
     bool CheckBlockHash(const int32_t nHeight, const std::vector<unsigned char>& nBlockHash) const;
@@ -151,12 +184,14 @@ private:
     const CScCertificate* certTo;
     unsigned int nIn;
     const CChain* chain;
+    const PrecomputedTransactionData* txdata;
 
 protected:
     virtual bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 
 public:
-    CertificateSignatureChecker(const CScCertificate* certToIn, unsigned int nInIn, const CChain* chainIn);
+    CertificateSignatureChecker(const CScCertificate* certToIn, unsigned int nInIn, const CChain* chainIn,
+                                const PrecomputedTransactionData* txdataIn = nullptr);
     bool CheckSig(const std::vector<unsigned char>& scriptSig, const std::vector<unsigned char>& vchPubKey, const CScript& scriptCode) const;
     // certificate does not have it
     bool CheckLockTime(const CScriptNum& nLockTime) const { return true;}
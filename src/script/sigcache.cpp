@@ -5,14 +5,13 @@
 
 #include "sigcache.h"
 
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
 
-#include <boost/thread.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
-
 namespace {
 
 /**
@@ -23,93 +22,89 @@ namespace {
 class CSignatureCache
 {
 private:
-     //! sigdata_type is (signature hash, signature, public key):
-    typedef boost::tuple<uint256, std::vector<unsigned char>, CPubKey> sigdata_type;
-    std::set< sigdata_type> setValid;
-    boost::shared_mutex cs_sigcache;
+    //! salt, so that entries cannot be predicted (and targeted for eviction) by an attacker
+    uint256 nonce;
+    CCuckooCache setValid;
 
 public:
-    bool
-    Get(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    CSignatureCache(): nonce(GetRandHash())
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        size_t nMaxCacheSize = std::max<int64_t>(0, std::min<int64_t>(GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE), MAX_MAX_SIG_CACHE_SIZE)) * ((size_t) 1 << 20);
+        uint32_t nEntries = setValid.Setup(nMaxCacheSize);
+        LogPrintf("Using %u MiB for the signature cache, able to store %u signatures\n", nMaxCacheSize >> 20, nEntries);
+    }
 
-        sigdata_type k(hash, vchSig, pubKey);
-        std::set<sigdata_type>::iterator mi = setValid.find(k);
-        if (mi != setValid.end())
-            return true;
-        return false;
+    uint256 ComputeEntry(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey) const
+    {
+        uint256 entry;
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).
+            Write(pubKey.begin(), pubKey.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+        return entry;
     }
 
-    void Set(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    bool Get(const uint256& entry, bool fErase)
     {
-        // DoS prevention: limit cache size to less than 10MB
-        // (~200 bytes per cache entry times 50,000 entries)
-        // Since there are a maximum of 20,000 signature operations per block
-        // 50,000 is a reasonable default.
-        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
-        if (nMaxCacheSize <= 0) return;
-
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-
-        while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize)
-        {
-            // Evict a random entry. Random because that helps
-            // foil would-be DoS attackers who might try to pre-generate
-            // and re-use a set of valid signatures just-slightly-greater
-            // than our cache size.
-            uint256 randomHash = GetRandHash();
-            std::vector<unsigned char> unused;
-            std::set<sigdata_type>::iterator it =
-                setValid.lower_bound(sigdata_type(randomHash, unused, unused));
-            if (it == setValid.end())
-                it = setValid.begin();
-            setValid.erase(*it);
-        }
-
-        sigdata_type k(hash, vchSig, pubKey);
-        setValid.insert(k);
+        return setValid.Contains(entry, fErase);
+    }
+
+    void Set(const uint256& entry)
+    {
+        setValid.Insert(entry);
     }
 };
 
+CSignatureCache& GetSignatureCache()
+{
+    static CSignatureCache signatureCache;
+    return signatureCache;
 }
 
-CachingTransactionSignatureChecker::CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn,
-                                                                       const CChain* chainIn, bool storeIn):
-                                                                        TransactionSignatureChecker(txToIn, nInIn, chainIn),
-                                                                        store(storeIn) {}
-
-bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
+/**
+ * Look the signature up in the cache. Checks which do not store their results are the ones
+ * of blocks being connected, after which the same signature is not checked again: such a
+ * lookup erases the entry, so that the space goes to signatures of transactions still to come.
+ */
+template <typename VerifyFn>
+bool VerifyCached(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash, bool store, VerifyFn verify)
 {
-    static CSignatureCache signatureCache;
+    CSignatureCache& signatureCache = GetSignatureCache();
+    uint256 entry = signatureCache.ComputeEntry(sighash, vchSig, pubkey);
 
-    if (signatureCache.Get(sighash, vchSig, pubkey))
+    if (signatureCache.Get(entry, !store))
         return true;
 
-    if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
+    if (!verify())
         return false;
 
     if (store)
-        signatureCache.Set(sighash, vchSig, pubkey);
+        signatureCache.Set(entry);
     return true;
 }
 
-CachingCertificateSignatureChecker::CachingCertificateSignatureChecker(const CScCertificate* certToIn, unsigned int nInIn,
-                                                                       const CChain* chainIn, bool storeIn):
-                                                                        CertificateSignatureChecker(certToIn, nInIn, chainIn),
+}
+
+CachingTransactionSignatureChecker::CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn,
+                                                                       const CChain* chainIn, bool storeIn,
+                                                                       const PrecomputedTransactionData* txdataIn):
+                                                                        TransactionSignatureChecker(txToIn, nInIn, chainIn, txdataIn),
                                                                         store(storeIn) {}
 
-bool CachingCertificateSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
+bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
-    static CSignatureCache signatureCache;
-
-    if (signatureCache.Get(sighash, vchSig, pubkey))
-        return true;
+    return VerifyCached(vchSig, pubkey, sighash, store, [&]() {
+        return TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash);
+    });
+}
 
-    if (!CertificateSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
-        return false;
+CachingCertificateSignatureChecker::CachingCertificateSignatureChecker(const CScCertificate* certToIn, unsigned int nInIn,
+                                                                       const CChain* chainIn, bool storeIn,
+                                                                       const PrecomputedTransactionData* txdataIn):
+                                                                        CertificateSignatureChecker(certToIn, nInIn, chainIn, txdataIn),
+                                                                        store(storeIn) {}
 
-    if (store)
-        signatureCache.Set(sighash, vchSig, pubkey);
-    return true;
+bool CachingCertificateSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
+{
+    return VerifyCached(vchSig, pubkey, sighash, store, [&]() {
+        return CertificateSignatureChecker::VerifySignature(vchSig, pubkey, sighash);
+    });
 }
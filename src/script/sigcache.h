@@ -10,6 +10,11 @@
 
 #include <vector>
 
+/** Default for -maxsigcachesize, the memory (in MiB) the signature cache can use */
+static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
+/** Maximum for -maxsigcachesize */
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
+
 class CPubKey;
 
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
@@ -18,7 +23,8 @@ private:
     bool store;
 
 public:
-    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CChain* chainIn, bool storeIn=true);
+    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CChain* chainIn, bool storeIn=true,
+                                       const PrecomputedTransactionData* txdataIn = nullptr);
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
@@ -28,7 +34,8 @@ private:
     bool store;
 
 public:
-    CachingCertificateSignatureChecker(const CScCertificate* certToIn, unsigned int nInIn, const CChain* chainIn, bool storeIn=true);
+    CachingCertificateSignatureChecker(const CScCertificate* certToIn, unsigned int nInIn, const CChain* chainIn, bool storeIn=true,
+                                       const PrecomputedTransactionData* txdataIn = nullptr);
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
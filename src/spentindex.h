@@ -0,0 +1,62 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SPENTINDEX_H
+#define BITCOIN_SPENTINDEX_H
+
+#include "amount.h"
+#include "serialize.h"
+#include "uint256.h"
+
+/** Key of a spent output */
+struct CSpentIndexKey
+{
+    uint256 txid;
+    unsigned int n;
+
+    CSpentIndexKey(): n(0) {}
+    CSpentIndexKey(const uint256& txidIn, unsigned int nIn): txid(txidIn), n(nIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(txid);
+        READWRITE(n);
+    }
+};
+
+/** The input spending an output, and what the output was; a null value erases its key from the index */
+struct CSpentIndexValue
+{
+    //! the transaction or certificate spending the output
+    uint256 txid;
+    unsigned int nInput;
+    int nHeight;
+    CAmount nValue;
+    uint8_t addressType;
+    uint160 addressHash;
+
+    CSpentIndexValue(): nInput(0), nHeight(-1), nValue(0), addressType(0) {}
+    CSpentIndexValue(const uint256& txidIn, unsigned int nInputIn, int nHeightIn, CAmount nValueIn,
+                     uint8_t addressTypeIn, const uint160& addressHashIn):
+        txid(txidIn), nInput(nInputIn), nHeight(nHeightIn), nValue(nValueIn),
+        addressType(addressTypeIn), addressHash(addressHashIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(txid);
+        READWRITE(nInput);
+        READWRITE(nHeight);
+        READWRITE(nValue);
+        READWRITE(addressType);
+        READWRITE(addressHash);
+    }
+
+    bool IsNull() const { return nHeight == -1; }
+};
+
+#endif // BITCOIN_SPENTINDEX_H
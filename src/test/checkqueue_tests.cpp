@@ -0,0 +1,116 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "checkqueue.h"
+
+#include "test/test_bitcoin.h"
+
+#include <atomic>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+namespace
+{
+std::atomic<int> nChecksRun(0);
+
+//! succeeds unless its value is negative, and counts how many checks ran
+struct CountingCheck
+{
+    int nValue;
+
+    CountingCheck(): nValue(0) {}
+    explicit CountingCheck(int nValueIn): nValue(nValueIn) {}
+
+    bool operator()() {
+        nChecksRun++;
+        return nValue >= 0;
+    }
+
+    void swap(CountingCheck& check) { std::swap(nValue, check.nValue); }
+};
+
+void RunRounds(CCheckQueue<CountingCheck>& queue, int nRounds)
+{
+    for (int nRound = 0; nRound < nRounds; nRound++) {
+        nChecksRun = 0;
+        int nTotal = 0;
+        // a single failing check in some rounds, as the last one queued
+        bool fFail = nRound % 5 == 2;
+        {
+            CCheckQueueControl<CountingCheck> control(&queue);
+            int nAdds = 1 + nRound % 7;
+            for (int i = 0; i < nAdds; i++) {
+                std::vector<CountingCheck> vChecks;
+                int nChecks = 1 + (nRound * 31 + i * 17) % 300;
+                for (int j = 0; j < nChecks; j++)
+                    vChecks.push_back(CountingCheck(fFail && i == nAdds - 1 && j == nChecks - 1 ? -1 : j));
+                nTotal += nChecks;
+                control.Add(vChecks);
+            }
+            BOOST_CHECK_EQUAL(control.Wait(), !fFail);
+        }
+        // checks may be skipped after a failure, never otherwise
+        if (!fFail)
+            BOOST_CHECK_EQUAL(nChecksRun.load(), nTotal);
+        BOOST_CHECK(queue.IsIdle());
+    }
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(checkqueue_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(checkqueue_master_only)
+{
+    CCheckQueue<CountingCheck> queue(128);
+    RunRounds(queue, 50);
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_with_workers)
+{
+    // more workers than deques too, so that some of them share one
+    for (int nWorkers : {1, 3, 80}) {
+        CCheckQueue<CountingCheck> queue(128);
+        boost::thread_group workers;
+        for (int i = 0; i < nWorkers; i++)
+            workers.create_thread(boost::bind(&CCheckQueue<CountingCheck>::Thread, &queue));
+        RunRounds(queue, 200);
+        workers.interrupt_all();
+        workers.join_all();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_shared_workers)
+{
+    CCheckQueueWorkers sharedWorkers;
+    CCheckQueue<CountingCheck> queue(128, &sharedWorkers);
+    CCheckQueue<CountingCheck> proofQueue(1, &sharedWorkers);
+    boost::thread_group workers;
+    for (int i = 0; i < 3; i++)
+        workers.create_thread(boost::bind(&CCheckQueueWorkers::Thread, &sharedWorkers));
+
+    RunRounds(queue, 100);
+    RunRounds(proofQueue, 100);
+
+    // both queues in use at the same time, as scripts and proofs of a block are
+    for (int nRound = 0; nRound < 50; nRound++) {
+        nChecksRun = 0;
+        CCheckQueueControl<CountingCheck> control(&queue);
+        CCheckQueueControl<CountingCheck> proofControl(&proofQueue);
+        std::vector<CountingCheck> vChecks(200, CountingCheck(1));
+        std::vector<CountingCheck> vProofChecks(20, CountingCheck(nRound % 5 == 3 ? -1 : 1));
+        control.Add(vChecks);
+        proofControl.Add(vProofChecks);
+        BOOST_CHECK(control.Wait());
+        BOOST_CHECK_EQUAL(proofControl.Wait(), nRound % 5 != 3);
+        if (nRound % 5 != 3)
+            BOOST_CHECK_EQUAL(nChecksRun.load(), 220);
+    }
+
+    workers.interrupt_all();
+    workers.join_all();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "coins.h"
+#include "checkqueue.h"
 #include "random.h"
 #include "script/standard.h"
 #include "uint256.h"
@@ -16,7 +17,9 @@
 #include <vector>
 #include <map>
 
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 #include "zcash/IncrementalMerkleTree.hpp"
 
 namespace
@@ -145,13 +148,16 @@ public:
                      memusage::DynamicUsage(cacheAnchors) +
                      memusage::DynamicUsage(cacheNullifiers) +
                      memusage::DynamicUsage(cacheSidechains) +
-                     memusage::DynamicUsage(cacheSidechainEvents);
+                     memusage::DynamicUsage(cacheSidechainEvents) +
+                     memusage::DynamicUsage(baseScIds);
         for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); it++) {
             ret += it->second.coins.DynamicMemoryUsage();
         }
         BOOST_CHECK_EQUAL(DynamicMemoryUsage(), ret);
     }
 
+    bool IsCached(const uint256& txid) const { return cacheCoins.count(txid) != 0; }
+    bool IsDirty(const uint256& txid) const { return cacheCoins.at(txid).flags & CCoinsCacheEntry::DIRTY; }
 };
 
 }
@@ -730,6 +736,117 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(missed_an_entry);
 }
 
+BOOST_AUTO_TEST_CASE(coins_cache_sync_keeps_recently_used_entries)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+
+    // One new coin per block, connected as ConnectTip does, through a view flushed into the cache
+    std::vector<uint256> txids;
+    for (int i = 0; i < 10; i++) {
+        uint256 txid = GetRandHash();
+        CCoinsViewCache view(&cache);
+        {
+            CCoinsModifier entry = view.ModifyCoins(txid);
+            entry->nVersion = 1;
+            entry->vout.resize(1);
+            entry->vout[0].nValue = i;
+        }
+        view.SetBestBlock(GetRandHash());
+        BOOST_CHECK(view.Flush());
+        txids.push_back(txid);
+    }
+
+    // Everything is written, nothing is evicted
+    BOOST_CHECK(cache.Sync(cache.DynamicMemoryUsage()));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), txids.size());
+    BOOST_FOREACH(const uint256& txid, txids) {
+        CCoins coins;
+        BOOST_CHECK(base.GetCoins(txid, coins));
+        BOOST_CHECK(!cache.IsDirty(txid));
+    }
+    cache.SelfTest();
+
+    // The oldest coin is used again by the next block, the second one becomes the least recently used
+    {
+        CCoinsViewCache view(&cache);
+        BOOST_CHECK(view.HaveCoins(txids[0]));
+        view.SetBestBlock(GetRandHash());
+        BOOST_CHECK(view.Flush());
+    }
+    BOOST_CHECK(cache.Sync(cache.DynamicMemoryUsage() - 1));
+    BOOST_CHECK(cache.IsCached(txids[0]));
+    BOOST_CHECK(!cache.IsCached(txids[1]));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), txids.size() - 1);
+    cache.SelfTest();
+
+    // Dirty coins are never evicted
+    {
+        CCoinsViewCache view(&cache);
+        {
+            CCoinsModifier entry = view.ModifyCoins(txids[2]);
+            entry->vout[0].nValue = 100;
+        }
+        view.SetBestBlock(GetRandHash());
+        BOOST_CHECK(view.Flush());
+    }
+    cache.Trim(0);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1);
+    BOOST_CHECK(cache.IsDirty(txids[2]));
+    cache.SelfTest();
+
+    BOOST_CHECK(cache.Sync(0));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0);
+    CCoins coins;
+    BOOST_CHECK(base.GetCoins(txids[2], coins));
+    BOOST_CHECK_EQUAL(coins.vout[0].nValue, 100);
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(coins_cache_prefetch)
+{
+    CCoinsViewTest base;
+    std::vector<uint256> txids;
+    {
+        CCoinsViewCacheTest writer(&base);
+        for (int i = 0; i < 100; i++) {
+            uint256 txid = GetRandHash();
+            CCoinsModifier entry = writer.ModifyCoins(txid);
+            entry->nVersion = 1;
+            entry->vout.resize(1);
+            entry->vout[0].nValue = i;
+            txids.push_back(txid);
+        }
+        writer.SetBestBlock(GetRandHash());
+        BOOST_CHECK(writer.Flush());
+    }
+    // unknown and repeated txids are tolerated
+    txids.push_back(GetRandHash());
+    txids.push_back(txids[0]);
+
+    CCheckQueue<CCoinsFetchCheck> queue(16);
+    boost::thread_group threads;
+    for (int i = 0; i < 3; i++)
+        threads.create_thread(boost::bind(&CCheckQueue<CCoinsFetchCheck>::Thread, boost::ref(queue)));
+
+    CCoinsViewCacheTest cache(&base);
+    cache.Prefetch(txids, NULL);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0);
+
+    cache.Prefetch(txids, &queue);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 100);
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK(cache.IsCached(txids[i]));
+        BOOST_CHECK(!cache.IsDirty(txids[i]));
+        BOOST_CHECK_EQUAL(cache.AccessCoins(txids[i])->vout[0].nValue, i);
+    }
+    BOOST_CHECK(!cache.IsCached(txids[100]));
+    cache.SelfTest();
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
 BOOST_AUTO_TEST_CASE(coins_coinbase_spends)
 {
     CCoinsViewTest base;
@@ -0,0 +1,119 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+
+#include "random.h"
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(cuckoocache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(cuckoocache_empty)
+{
+    CCuckooCache cache;
+    uint256 value = GetRandHash();
+    cache.Insert(value);
+    BOOST_CHECK(!cache.Contains(value, false));
+
+    BOOST_CHECK_EQUAL(cache.Setup(0), 0);
+    cache.Insert(value);
+    BOOST_CHECK(!cache.Contains(value, false));
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_hit_rate)
+{
+    CCuckooCache cache;
+    uint32_t nSize = cache.Setup(1 << 20);
+    BOOST_CHECK(nSize > 20000);
+
+    // filled up to 90%, almost everything is kept
+    std::vector<uint256> values;
+    for (uint32_t i = 0; i < nSize / 10 * 9; i++) {
+        values.push_back(GetRandHash());
+        cache.Insert(values.back());
+    }
+    size_t nHits = 0;
+    for (const uint256& value : values)
+        nHits += cache.Contains(value, false);
+    BOOST_CHECK(nHits >= values.size() / 100 * 99);
+
+    // values never inserted are not found
+    for (int i = 0; i < 10000; i++)
+        BOOST_CHECK(!cache.Contains(GetRandHash(), false));
+
+    // filled again and again, the most recent values are mostly kept
+    for (uint32_t i = 0; i < 2 * nSize; i++) {
+        values.push_back(GetRandHash());
+        cache.Insert(values.back());
+    }
+    nHits = 0;
+    for (size_t i = values.size() - nSize / 4; i < values.size(); i++)
+        nHits += cache.Contains(values[i], false);
+    BOOST_CHECK(nHits >= nSize / 4 / 100 * 80);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_erased_entries_are_replaced_first)
+{
+    CCuckooCache cache;
+    uint32_t nSize = cache.Setup(1 << 16);
+
+    // a full cache, whose first half is then erased
+    std::vector<uint256> values;
+    for (uint32_t i = 0; i < nSize; i++) {
+        values.push_back(GetRandHash());
+        cache.Insert(values.back());
+    }
+    std::vector<uint256> kept;
+    for (uint32_t i = 0; i < nSize; i++) {
+        if (!cache.Contains(values[i], i < nSize / 2))
+            continue;
+        if (i >= nSize / 2)
+            kept.push_back(values[i]);
+    }
+
+    // new values take the erased slots and leave the others alone
+    for (uint32_t i = 0; i < nSize / 4; i++)
+        cache.Insert(GetRandHash());
+    size_t nHits = 0;
+    for (const uint256& value : kept)
+        nHits += cache.Contains(value, false);
+    BOOST_CHECK(nHits >= kept.size() / 100 * 95);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_concurrent_access)
+{
+    CCuckooCache cache;
+    cache.Setup(1 << 16);
+
+    // values are only ever found if inserted, whatever the other threads are doing
+    std::vector<std::vector<uint256>> vValues(4);
+    for (auto& values : vValues)
+        for (int i = 0; i < 20000; i++)
+            values.push_back(GetRandHash());
+    std::vector<uint256> absent;
+    for (int i = 0; i < 20000; i++)
+        absent.push_back(GetRandHash());
+
+    std::atomic<int> nFalseHits(0);
+    boost::thread_group threads;
+    for (auto& values : vValues) {
+        threads.create_thread([&cache, &values, &absent, &nFalseHits]() {
+            for (size_t i = 0; i < values.size(); i++) {
+                cache.Insert(values[i]);
+                cache.Contains(values[i / 2], i % 3 == 0);
+                if (cache.Contains(absent[i], false))
+                    nFalseHits++;
+            }
+        });
+    }
+    threads.join_all();
+    BOOST_CHECK_EQUAL(nFalseHits.load(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
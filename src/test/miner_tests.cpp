@@ -377,6 +377,48 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     delete pblocktemplate;
     mempool.clear();
 
+    // templates follow the pool as entries enter it, get prioritised and leave it
+    {
+        CMutableTransaction txA, txB, txC;
+        txA.vin.resize(1);
+        txA.vin[0].prevout.hash = txFirst[0]->GetHash();
+        txA.vin[0].prevout.n = 0;
+        txA.vin[0].scriptSig = CScript() << OP_1;
+        txA.vout.resize(1);
+        txA.vout[0].nValue = 49000LL;
+        txA.vout[0].scriptPubKey = CScript() << OP_1;
+        txB = txA;
+        txB.vin[0].prevout.hash = txFirst[1]->GetHash();
+        txC = txA;
+        txC.vin[0].prevout.hash = txB.GetHash();
+        txC.vout[0].nValue = 48000LL;
+
+        mempool.addUnchecked(txA.GetHash(), CTxMemPoolEntry(txA, 11, GetTime(), 111.0, 11));
+        BOOST_CHECK(pblocktemplate = CreateNewBlock(scriptPubKey));
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2);
+        delete pblocktemplate;
+
+        mempool.addUnchecked(txB.GetHash(), CTxMemPoolEntry(txB, 11, GetTime(), 111.0, 11));
+        mempool.PrioritiseTransaction(txB.GetHash(), txB.GetHash().ToString(), 0, 1000);
+        BOOST_CHECK(pblocktemplate = CreateNewBlock(scriptPubKey));
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3);
+        BOOST_CHECK(pblocktemplate->block.vtx[1].GetHash() == txB.GetHash());
+        BOOST_CHECK(pblocktemplate->block.vtx[2].GetHash() == txA.GetHash());
+        delete pblocktemplate;
+
+        // the child comes right after its parent, once the parent is in the block
+        std::list<CTransaction> removedTxs;
+        std::list<CScCertificate> removedCerts;
+        mempool.remove(txA, removedTxs, removedCerts);
+        mempool.addUnchecked(txC.GetHash(), CTxMemPoolEntry(txC, 11, GetTime(), 111.0, 11));
+        BOOST_CHECK(pblocktemplate = CreateNewBlock(scriptPubKey));
+        BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 3);
+        BOOST_CHECK(pblocktemplate->block.vtx[1].GetHash() == txB.GetHash());
+        BOOST_CHECK(pblocktemplate->block.vtx[2].GetHash() == txC.GetHash());
+        delete pblocktemplate;
+        mempool.clear();
+    }
+
     // subsidy changing
     int nHeight = chainActive.Height();
     // Create an actual 209999-long block chain (without valid blocks).
@@ -0,0 +1,120 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "openhashmap.h"
+
+#include "random.h"
+#include "test/test_bitcoin.h"
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+struct IntHasher
+{
+    size_t operator()(int key) const { return static_cast<size_t>(key) * 0x9E3779B9u; }
+};
+
+//! every key collides: exercises long probe sequences
+struct CollidingHasher
+{
+    size_t operator()(int key) const { return 42; }
+};
+
+template <typename Hasher>
+void CompareWithStdMap(int nOps, int nKeys)
+{
+    openhashmap<int, int, Hasher> map;
+    std::map<int, int> ref;
+
+    for (int i = 0; i < nOps; i++) {
+        int key = GetRandInt(nKeys);
+        switch (GetRandInt(4)) {
+        case 0:
+            BOOST_CHECK_EQUAL(map.insert(std::make_pair(key, i)).second, ref.insert(std::make_pair(key, i)).second);
+            break;
+        case 1:
+            BOOST_CHECK_EQUAL(map.erase(key), ref.erase(key));
+            break;
+        case 2:
+            map[key] = i;
+            ref[key] = i;
+            break;
+        default:
+            BOOST_CHECK_EQUAL(map.count(key), ref.count(key));
+            if (ref.count(key))
+                BOOST_CHECK_EQUAL(map.at(key), ref.at(key));
+        }
+
+        if (i % 1000 == 0) {
+            // erasing while iterating visits every element once
+            size_t nVisited = 0;
+            for (typename openhashmap<int, int, Hasher>::iterator it = map.begin(); it != map.end(); ) {
+                BOOST_CHECK_EQUAL(it->second, ref.at(it->first));
+                nVisited++;
+                if (it->first % 3 == 0) {
+                    ref.erase(it->first);
+                    it = map.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            BOOST_CHECK_EQUAL(map.size(), ref.size());
+            BOOST_CHECK(nVisited >= map.size());
+
+            openhashmap<int, int, Hasher> copy = map;
+            BOOST_CHECK_EQUAL(copy.size(), map.size());
+        }
+    }
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(openhashmap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(openhashmap_behaves_as_a_map)
+{
+    CompareWithStdMap<IntHasher>(50000, 5000);
+    CompareWithStdMap<CollidingHasher>(5000, 500);
+}
+
+BOOST_AUTO_TEST_CASE(openhashmap_references_survive_rehash)
+{
+    openhashmap<int, int, IntHasher> map;
+    int* pValue = &map[-1];
+    openhashmap<int, int, IntHasher>::iterator it = map.find(-1);
+    for (int i = 0; i < 100000; i++)
+        map[i] = i;
+
+    BOOST_CHECK(&map[-1] == pValue);
+    // an iterator obtained before the table grew still reaches its element
+    BOOST_CHECK(&it->second == pValue);
+    map.erase(it);
+    BOOST_CHECK_EQUAL(map.count(-1), 0);
+    BOOST_CHECK_EQUAL(map.size(), 100000);
+}
+
+BOOST_AUTO_TEST_CASE(openhashmap_memory_usage)
+{
+    openhashmap<int, int, IntHasher> map;
+    size_t nEmptyUsage = memusage::DynamicUsage(map);
+
+    for (int i = 0; i < 10000; i++)
+        map[i] = i;
+    size_t nFullUsage = memusage::DynamicUsage(map);
+    BOOST_CHECK(nFullUsage >= map.bucket_count() * 2 * sizeof(void*) + map.size() * sizeof(std::pair<const int, int>));
+
+    // erased elements are recycled, not reallocated
+    for (int i = 0; i < 10000; i++)
+        map.erase(i);
+    for (int i = 0; i < 10000; i++)
+        map[i + 10000] = i;
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), nFullUsage);
+
+    map.clear();
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), nEmptyUsage);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
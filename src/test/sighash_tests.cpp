@@ -411,6 +411,34 @@ BOOST_AUTO_TEST_CASE(sighash_from_tx)
 
 }
 
+// Goal: check that the precomputed signature hashes of every input match the ones computed from scratch
+BOOST_AUTO_TEST_CASE(sighash_precomputed)
+{
+    seed_insecure_rand(false);
+
+    for (int i=0; i<2000; i++) {
+        CMutableTransaction mtx;
+        RandomTransaction(mtx, false);
+        const CTransaction txTo(mtx);
+        PrecomputedTransactionData txdata(txTo);
+
+        CMutableScCertificate mcert;
+        RandomCertificate(mcert, false);
+        const CScCertificate certTo(mcert);
+        PrecomputedTransactionData certdata(certTo);
+
+        CScript scriptCode;
+        RandomScript(scriptCode);
+
+        for (unsigned int nIn = 0; nIn < txTo.GetVin().size(); nIn++)
+            BOOST_CHECK(txdata.SignatureHashAll(scriptCode, nIn) == SignatureHash(scriptCode, txTo, nIn, SIGHASH_ALL));
+        for (unsigned int nIn = 0; nIn < certTo.GetVin().size(); nIn++)
+            BOOST_CHECK(certdata.SignatureHashAll(scriptCode, nIn) == SignatureHash(scriptCode, certTo, nIn, SIGHASH_ALL));
+
+        BOOST_CHECK_THROW(txdata.SignatureHashAll(scriptCode, txTo.GetVin().size()), std::logic_error);
+    }
+}
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
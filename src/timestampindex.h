@@ -0,0 +1,51 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TIMESTAMPINDEX_H
+#define BITCOIN_TIMESTAMPINDEX_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+/** Key of a block of the active chain, stored big-endian so that blocks are sorted by time */
+struct CTimestampIndexKey
+{
+    unsigned int nTime;
+    uint256 blockHash;
+
+    CTimestampIndexKey(): nTime(0) {}
+    CTimestampIndexKey(unsigned int nTimeIn, const uint256& blockHashIn): nTime(nTimeIn), blockHash(blockHashIn) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 36;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata32be(s, nTime);
+        blockHash.Serialize(s, nType, nVersion);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        nTime = ser_readdata32be(s);
+        blockHash.Unserialize(s, nType, nVersion);
+    }
+};
+
+/** Prefix of the keys of the blocks from a given time on */
+struct CTimestampIndexIteratorKey
+{
+    unsigned int nTime;
+
+    explicit CTimestampIndexIteratorKey(unsigned int nTimeIn): nTime(nTimeIn) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 4;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata32be(s, nTime);
+    }
+};
+
+#endif // BITCOIN_TIMESTAMPINDEX_H
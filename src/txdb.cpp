@@ -5,10 +5,16 @@
 
 #include "txdb.h"
 
+#include "addressindex.h"
 #include "chainparams.h"
 #include "hash.h"
+#include "init.h"
 #include "main.h"
 #include "pow.h"
+#include "scindex.h"
+#include "spentindex.h"
+#include "timestampindex.h"
+#include "ui_interface.h"
 #include "uint256.h"
 
 #include <stdint.h>
@@ -21,19 +27,122 @@ using namespace std;
 
 static const char DB_ANCHOR = 'A';
 static const char DB_NULLIFIER = 's';
-static const char DB_COINS = 'c';
+static const char DB_COINS = 'c'; // legacy layout, one record per transaction: only read by CCoinsViewDB::Upgrade
+static const char DB_COIN = 'C';
 static const char DB_SIDECHAINS = 'i';
 static const char DB_CEASEDSCS = 'd';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_ADDRESSINDEX = 'x';
+static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_SPENTINDEX = 'p';
+static const char DB_TIMESTAMPINDEX = 'T';
+static const char DB_SCINDEX = 'S';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_BEST_ANCHOR = 'a';
 static const char DB_FLAG = 'F';
+static const char DB_INDEX_BEST_BLOCK = 'I';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 
+namespace {
+/** Key of an unspent output in the chainstate: the outputs of a transaction are adjacent */
+struct CCoinsOutputKey
+{
+    uint256 txid;
+    uint32_t n;
+
+    CCoinsOutputKey(): n(0) {}
+    CCoinsOutputKey(const uint256& txidIn, uint32_t nIn): txid(txidIn), n(nIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        char chType = DB_COIN;
+        READWRITE(chType);
+        READWRITE(txid);
+        READWRITE(VARINT(n));
+    }
+};
+
+/**
+ * Value of an unspent output in the chainstate. It carries the fields of the CCoins it belongs to,
+ * so that the CCoins can be rebuilt from any subset of its outputs; for outputs of certificates they
+ * include the position of the first backward transfer and the maturity height of backward transfers.
+ */
+struct CCoinsOutputRecord
+{
+    CCoins header; // the CCoins fields but vout
+    CTxOut out;
+
+    CCoinsOutputRecord() {}
+    CCoinsOutputRecord(const CCoins& coins, uint32_t n): out(coins.vout[n]) {
+        header.fCoinBase = coins.fCoinBase;
+        header.nHeight = coins.nHeight;
+        header.nVersion = coins.nVersion;
+        header.nFirstBwtPos = coins.nFirstBwtPos;
+        header.nBwtMaturityHeight = coins.nBwtMaturityHeight;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        // same encoding of the version as in CCoins, which IsFromCert relies on
+        READWRITE(VARINT(header.nVersion));
+        unsigned int nCode = header.nHeight * 2 + (header.fCoinBase ? 1 : 0);
+        READWRITE(VARINT(nCode));
+        if (ser_action.ForRead()) {
+            header.nHeight = nCode / 2;
+            header.fCoinBase = nCode & 1;
+        }
+        READWRITE(REF(CTxOutCompressor(REF(out))));
+        if (header.IsFromCert()) {
+            READWRITE(header.nFirstBwtPos);
+            READWRITE(header.nBwtMaturityHeight);
+        }
+    }
+};
+
+//! Rebuild the coins of a transaction from its outputs in the chainstate
+bool ReadCoinsOutputs(const CLevelDBWrapper& db, const uint256& txid, CCoins& coins)
+{
+    CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+    ssPrefix << make_pair(DB_COIN, txid);
+    leveldb::Slice slPrefix(&ssPrefix[0], ssPrefix.size());
+
+    std::unique_ptr<leveldb::Iterator> pcursor(db.NewLookupIterator());
+    bool fFound = false;
+    for (pcursor->Seek(slPrefix); pcursor->Valid() && pcursor->key().starts_with(slPrefix); pcursor->Next()) {
+        leveldb::Slice slKey = pcursor->key();
+        CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+        CCoinsOutputKey key;
+        ssKey >> key;
+        leveldb::Slice slValue = pcursor->value();
+        CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+        CCoinsOutputRecord record;
+        ssValue >> record;
+
+        if (!fFound) {
+            coins.Clear();
+            coins.fCoinBase = record.header.fCoinBase;
+            coins.nHeight = record.header.nHeight;
+            coins.nVersion = record.header.nVersion;
+            coins.nFirstBwtPos = record.header.nFirstBwtPos;
+            coins.nBwtMaturityHeight = record.header.nBwtMaturityHeight;
+            fFound = true;
+        }
+        if (coins.vout.size() <= key.n)
+            coins.vout.resize(key.n + 1);
+        coins.vout[key.n] = record.out;
+    }
+    HandleError(pcursor->status());
+    return fFound;
+}
+}
 
 void static BatchWriteAnchor(CLevelDBBatch &batch,
                              const uint256 &croot,
@@ -54,11 +163,30 @@ void static BatchWriteNullifier(CLevelDBBatch &batch, const uint256 &nf, const b
         batch.Write(make_pair(DB_NULLIFIER, nf), true);
 }
 
-void static BatchWriteCoins(CLevelDBBatch &batch, const uint256 &hash, const CCoins &coins) {
-    if (coins.IsPruned())
-        batch.Erase(make_pair(DB_COINS, hash));
-    else
-        batch.Write(make_pair(DB_COINS, hash), coins);
+void static BatchWriteCoins(CLevelDBBatch &batch, const CLevelDBWrapper &db, const uint256 &hash, const CCoinsCacheEntry &entry) {
+    const CCoins &coins = entry.coins;
+    const std::vector<bool>* pvStored = &entry.vBaseUnspent;
+    std::vector<bool> vStored;
+    if (pvStored->empty() && !(entry.flags & CCoinsCacheEntry::FRESH)) {
+        // not known which outputs are on disk: look them up
+        CCoins stored;
+        if (ReadCoinsOutputs(db, hash, stored)) {
+            for (const CTxOut& out: stored.vout)
+                vStored.push_back(!out.IsNull());
+        }
+        pvStored = &vStored;
+    }
+
+    // only the outputs which were spent or added since the entry was read are written
+    size_t nOutputs = std::max(coins.vout.size(), pvStored->size());
+    for (uint32_t n = 0; n < nOutputs; n++) {
+        bool fStored = n < pvStored->size() && (*pvStored)[n];
+        bool fUnspent = n < coins.vout.size() && !coins.vout[n].IsNull();
+        if (fUnspent && !fStored)
+            batch.Write(CCoinsOutputKey(hash, n), CCoinsOutputRecord(coins, n));
+        else if (!fUnspent && fStored)
+            batch.Erase(CCoinsOutputKey(hash, n));
+    }
 }
 
 void static BatchSidechains(CLevelDBBatch &batch, const uint256 &scId, const CSidechainsCacheEntry &sidechain) {
@@ -128,11 +256,19 @@ bool CCoinsViewDB::GetNullifier(const uint256 &nf) const {
 }
 
 bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(make_pair(DB_COINS, txid), coins);
+    return ReadCoinsOutputs(db, txid, coins);
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(make_pair(DB_COINS, txid));
+    CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+    ssPrefix << make_pair(DB_COIN, txid);
+    leveldb::Slice slPrefix(&ssPrefix[0], ssPrefix.size());
+
+    std::unique_ptr<leveldb::Iterator> pcursor(db.NewLookupIterator());
+    pcursor->Seek(slPrefix);
+    bool fFound = pcursor->Valid() && pcursor->key().starts_with(slPrefix);
+    HandleError(pcursor->status());
+    return fFound;
 }
 
 bool CCoinsViewDB::GetSidechain(const uint256& scId, CSidechain& info) const
@@ -158,7 +294,11 @@ bool CCoinsViewDB::GetSidechainEvents(int height, CSidechainEvents& ceasingScs)
 void CCoinsViewDB::GetScIds(std::set<uint256>& scIdsList) const
 {
     std::unique_ptr<leveldb::Iterator> it(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
-    for (it->SeekToFirst(); it->Valid(); it->Next())
+
+    // sidechain keys are contiguous, jump straight to the first one instead of scanning the whole chainstate
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair(DB_SIDECHAINS, uint256());
+    for (it->Seek(ssKeySet.str()); it->Valid(); it->Next())
     {
         boost::this_thread::interruption_point();
 
@@ -166,13 +306,13 @@ void CCoinsViewDB::GetScIds(std::set<uint256>& scIdsList) const
         CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
         char chType;
         ssKey >> chType;
-        if (chType == DB_SIDECHAINS)
-        {
-            uint256 keyScId;
-            ssKey >> keyScId;
-            scIdsList.insert(keyScId);
-            LogPrint("sc", "%s():%d - scId[%s] added in map\n", __func__, __LINE__, keyScId.ToString() );
-        }
+        if (chType != DB_SIDECHAINS)
+            break;
+
+        uint256 keyScId;
+        ssKey >> keyScId;
+        scIdsList.insert(keyScId);
+        LogPrint("sc", "%s():%d - scId[%s] added in map\n", __func__, __LINE__, keyScId.ToString() );
     }
 
     return;
@@ -199,48 +339,52 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
                               CNullifiersMap &mapNullifiers,
                               CSidechainsMap& mapSidechains,
                               CSidechainEventsMap& mapSidechainEvents) {
+    bool fOk = WriteChanges(mapCoins, hashBlock, hashAnchor, mapAnchors, mapNullifiers, mapSidechains, mapSidechainEvents);
+    mapCoins.clear();
+    mapAnchors.clear();
+    mapNullifiers.clear();
+    mapSidechains.clear();
+    mapSidechainEvents.clear();
+    return fOk;
+}
+
+bool CCoinsViewDB::WriteChanges(const CCoinsMap &mapCoins,
+                                const uint256 &hashBlock,
+                                const uint256 &hashAnchor,
+                                const CAnchorsMap &mapAnchors,
+                                const CNullifiersMap &mapNullifiers,
+                                const CSidechainsMap& mapSidechains,
+                                const CSidechainEventsMap& mapSidechainEvents) {
     CLevelDBBatch batch;
     size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            BatchWriteCoins(batch, it->first, it->second.coins);
+            BatchWriteCoins(batch, db, it->first, it->second);
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
     }
 
-    for (CAnchorsMap::iterator it = mapAnchors.begin(); it != mapAnchors.end();) {
+    for (CAnchorsMap::const_iterator it = mapAnchors.begin(); it != mapAnchors.end(); ++it) {
         if (it->second.flags & CAnchorsCacheEntry::DIRTY) {
             BatchWriteAnchor(batch, it->first, it->second.tree, it->second.entered);
             // TODO: changed++?
         }
-        CAnchorsMap::iterator itOld = it++;
-        mapAnchors.erase(itOld);
     }
 
-    for (CNullifiersMap::iterator it = mapNullifiers.begin(); it != mapNullifiers.end();) {
+    for (CNullifiersMap::const_iterator it = mapNullifiers.begin(); it != mapNullifiers.end(); ++it) {
         if (it->second.flags & CNullifiersCacheEntry::DIRTY) {
             BatchWriteNullifier(batch, it->first, it->second.entered);
             // TODO: changed++?
         }
-        CNullifiersMap::iterator itOld = it++;
-        mapNullifiers.erase(itOld);
     }
 
-    for (CSidechainsMap::iterator it = mapSidechains.begin(); it != mapSidechains.end();) {
+    for (CSidechainsMap::const_iterator it = mapSidechains.begin(); it != mapSidechains.end(); ++it)
         BatchSidechains(batch, it->first, it->second);
-        CSidechainsMap::iterator itOld = it++;
-        mapSidechains.erase(itOld);
-    }
 
-    for (CSidechainEventsMap::iterator it = mapSidechainEvents.begin(); it != mapSidechainEvents.end();) {
+    for (CSidechainEventsMap::const_iterator it = mapSidechainEvents.begin(); it != mapSidechainEvents.end(); ++it)
         BatchCeasedScs(batch, it->first, it->second);
-        CSidechainEventsMap::iterator itOld = it++;
-        mapSidechainEvents.erase(itOld);
-    }
 
     if (!hashBlock.IsNull())
         BatchWriteHashBestChain(batch, hashBlock);
@@ -251,6 +395,219 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
     return db.WriteBatch(batch);
 }
 
+CCoinsViewWriteBehind::CCoinsViewWriteBehind(CCoinsViewDB* dbIn) : CCoinsViewBacked(dbIn), db(*dbIn), fWriteFailed(false), fStop(false) {
+    writerThread = boost::thread(boost::bind(&CCoinsViewWriteBehind::ThreadWrite, this));
+}
+
+CCoinsViewWriteBehind::~CCoinsViewWriteBehind() {
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
+        cond.notify_all();
+    }
+    // the changes still queued are written before the thread exits
+    writerThread.join();
+}
+
+void CCoinsViewWriteBehind::ThreadWrite() {
+    RenameThread("horizen-coinsdb");
+
+    while (true) {
+        std::shared_ptr<const CChanges> changes;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            while (!fStop && (!pending || fWriteFailed))
+                cond.wait(lock);
+            if (!pending || fWriteFailed)
+                return;
+            changes = pending;
+        }
+
+        int64_t nTimeStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            fOk = db.WriteChanges(changes->mapCoins, changes->hashBlock, changes->hashAnchor, changes->mapAnchors,
+                                  changes->mapNullifiers, changes->mapSidechains, changes->mapSidechainEvents);
+        } catch (const std::runtime_error& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        LogPrint("bench", "%s():%d - coins database write: %.2fms\n", __func__, __LINE__, (GetTimeMicros() - nTimeStart) * 0.001);
+
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            if (fOk) {
+                pending.reset();
+            } else {
+                LogPrintf("*** Failed to write to coin database, best block %s\n", changes->hashBlock.ToString());
+                fWriteFailed = true;
+            }
+            cond.notify_all();
+        }
+    }
+}
+
+std::shared_ptr<const CCoinsViewWriteBehind::CChanges> CCoinsViewWriteBehind::GetPending() const {
+    boost::unique_lock<boost::mutex> lock(cs);
+    return pending;
+}
+
+bool CCoinsViewWriteBehind::WaitForWrite() const {
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (pending && !fWriteFailed)
+        cond.wait(lock);
+    return !fWriteFailed;
+}
+
+bool CCoinsViewWriteBehind::GetAnchorAt(const uint256 &rt, ZCIncrementalMerkleTree &tree) const {
+    std::shared_ptr<const CChanges> changes = GetPending();
+    if (changes) {
+        CAnchorsMap::const_iterator it = changes->mapAnchors.find(rt);
+        if (it != changes->mapAnchors.end() && (it->second.flags & CAnchorsCacheEntry::DIRTY)) {
+            if (!it->second.entered)
+                return false;
+            tree = it->second.tree;
+            return true;
+        }
+    }
+    return base->GetAnchorAt(rt, tree);
+}
+
+bool CCoinsViewWriteBehind::GetNullifier(const uint256 &nf) const {
+    std::shared_ptr<const CChanges> changes = GetPending();
+    if (changes) {
+        CNullifiersMap::const_iterator it = changes->mapNullifiers.find(nf);
+        if (it != changes->mapNullifiers.end() && (it->second.flags & CNullifiersCacheEntry::DIRTY))
+            return it->second.entered;
+    }
+    return base->GetNullifier(nf);
+}
+
+bool CCoinsViewWriteBehind::GetCoins(const uint256 &txid, CCoins &coins) const {
+    std::shared_ptr<const CChanges> changes = GetPending();
+    if (changes) {
+        CCoinsMap::const_iterator it = changes->mapCoins.find(txid);
+        if (it != changes->mapCoins.end() && (it->second.flags & CCoinsCacheEntry::DIRTY)) {
+            // pruned coins are erased from the database
+            if (it->second.coins.IsPruned())
+                return false;
+            coins = it->second.coins;
+            return true;
+        }
+    }
+    return base->GetCoins(txid, coins);
+}
+
+bool CCoinsViewWriteBehind::HaveCoins(const uint256 &txid) const {
+    std::shared_ptr<const CChanges> changes = GetPending();
+    if (changes) {
+        CCoinsMap::const_iterator it = changes->mapCoins.find(txid);
+        if (it != changes->mapCoins.end() && (it->second.flags & CCoinsCacheEntry::DIRTY))
+            return !it->second.coins.IsPruned();
+    }
+    return base->HaveCoins(txid);
+}
+
+bool CCoinsViewWriteBehind::GetSidechain(const uint256& scId, CSidechain& info) const {
+    std::shared_ptr<const CChanges> changes = GetPending();
+    if (changes) {
+        CSidechainsMap::const_iterator it = changes->mapSidechains.find(scId);
+        if (it != changes->mapSidechains.end() && it->second.flag != CSidechainsCacheEntry::Flags::DEFAULT) {
+            if (it->second.flag == CSidechainsCacheEntry::Flags::ERASED)
+                return false;
+            info = it->second.scInfo;
+            return true;
+        }
+    }
+    return base->GetSidechain(scId, info);
+}
+
+bool CCoinsViewWriteBehind::HaveSidechain(const uint256& scId) const {
+    std::shared_ptr<const CChanges> changes = GetPending();
+    if (changes) {
+        CSidechainsMap::const_iterator it = changes->mapSidechains.find(scId);
+        if (it != changes->mapSidechains.end() && it->second.flag != CSidechainsCacheEntry::Flags::DEFAULT)
+            return it->second.flag != CSidechainsCacheEntry::Flags::ERASED;
+    }
+    return base->HaveSidechain(scId);
+}
+
+bool CCoinsViewWriteBehind::HaveSidechainEvents(int height) const {
+    std::shared_ptr<const CChanges> changes = GetPending();
+    if (changes) {
+        CSidechainEventsMap::const_iterator it = changes->mapSidechainEvents.find(height);
+        if (it != changes->mapSidechainEvents.end() && it->second.flag != CSidechainEventsCacheEntry::Flags::DEFAULT)
+            return it->second.flag != CSidechainEventsCacheEntry::Flags::ERASED;
+    }
+    return base->HaveSidechainEvents(height);
+}
+
+bool CCoinsViewWriteBehind::GetSidechainEvents(int height, CSidechainEvents& scEvents) const {
+    std::shared_ptr<const CChanges> changes = GetPending();
+    if (changes) {
+        CSidechainEventsMap::const_iterator it = changes->mapSidechainEvents.find(height);
+        if (it != changes->mapSidechainEvents.end() && it->second.flag != CSidechainEventsCacheEntry::Flags::DEFAULT) {
+            if (it->second.flag == CSidechainEventsCacheEntry::Flags::ERASED)
+                return false;
+            scEvents = it->second.scEvents;
+            return true;
+        }
+    }
+    return base->GetSidechainEvents(height, scEvents);
+}
+
+void CCoinsViewWriteBehind::GetScIds(std::set<uint256>& scIdsList) const {
+    // a full scan of the database, let it catch up first
+    WaitForWrite();
+    base->GetScIds(scIdsList);
+}
+
+uint256 CCoinsViewWriteBehind::GetBestBlock() const {
+    std::shared_ptr<const CChanges> changes = GetPending();
+    if (changes && !changes->hashBlock.IsNull())
+        return changes->hashBlock;
+    return base->GetBestBlock();
+}
+
+uint256 CCoinsViewWriteBehind::GetBestAnchor() const {
+    std::shared_ptr<const CChanges> changes = GetPending();
+    if (changes && !changes->hashAnchor.IsNull())
+        return changes->hashAnchor;
+    return base->GetBestAnchor();
+}
+
+bool CCoinsViewWriteBehind::BatchWrite(CCoinsMap &mapCoins,
+                                       const uint256 &hashBlock,
+                                       const uint256 &hashAnchor,
+                                       CAnchorsMap &mapAnchors,
+                                       CNullifiersMap &mapNullifiers,
+                                       CSidechainsMap& mapSidechains,
+                                       CSidechainEventsMap& mapSidechainEvents) {
+    // take the changes over, the caller is done with them anyway
+    std::shared_ptr<CChanges> changes = std::make_shared<CChanges>();
+    changes->mapCoins.swap(mapCoins);
+    changes->hashBlock = hashBlock;
+    changes->hashAnchor = hashAnchor;
+    changes->mapAnchors.swap(mapAnchors);
+    changes->mapNullifiers.swap(mapNullifiers);
+    changes->mapSidechains.swap(mapSidechains);
+    changes->mapSidechainEvents.swap(mapSidechainEvents);
+
+    // one batch in flight at a time: this only waits when flushes come faster than the disk can take them
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (pending && !fWriteFailed)
+        cond.wait(lock);
+    if (fWriteFailed)
+        return false;
+    pending = changes;
+    cond.notify_all();
+    return true;
+}
+
+bool CCoinsViewWriteBehind::GetStats(CCoinsStats &stats) const {
+    WaitForWrite();
+    return base->GetStats(stats);
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
 }
 
@@ -274,17 +631,47 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
     return Read(DB_LAST_BLOCK, nFile);
 }
 
+//! Add the coins of a transaction to the UTXO set statistics
+static void AddCoinsToStats(CCoinsStats &stats, CHashWriter &ss, CAmount &nTotalAmount, const uint256 &txhash, const CCoins &coins)
+{
+    ss << txhash;
+    ss << VARINT(coins.nVersion);
+    ss << (coins.fCoinBase ? 'c' : 'n');
+    ss << VARINT(coins.nHeight);
+    stats.nTransactions++;
+    for (unsigned int i=0; i<coins.vout.size(); i++) {
+        const CTxOut &out = coins.vout[i];
+        if (!out.IsNull()) {
+            stats.nTransactionOutputs++;
+            ss << VARINT(i+1);
+            ss << out;
+            nTotalAmount += out.nValue;
+        }
+    }
+
+    if (coins.IsFromCert()) {
+        ss << coins.nBwtMaturityHeight;
+        ss << coins.nBwtMaturityHeight;;
+    }
+    ss << VARINT(0);
+}
+
 bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
-    pcursor->SeekToFirst();
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair(DB_COIN, uint256());
+    pcursor->Seek(ssKeySet.str());
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = GetBestBlock();
     ss << stats.hashBlock;
     CAmount nTotalAmount = 0;
+    // the outputs of a transaction are adjacent: gather them and hash the transaction coins as a whole
+    uint256 txhash;
+    CCoins coins;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
@@ -292,40 +679,34 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
             CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
             char chType;
             ssKey >> chType;
-            if (chType == DB_COINS) {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
-                CCoins coins;
-                ssValue >> coins;
-                uint256 txhash;
-                ssKey >> txhash;
-                ss << txhash;
-                ss << VARINT(coins.nVersion);
-                ss << (coins.fCoinBase ? 'c' : 'n');
-                ss << VARINT(coins.nHeight);
-                stats.nTransactions++;
-                for (unsigned int i=0; i<coins.vout.size(); i++) {
-                    const CTxOut &out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i+1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
-                }
-
-                if (coins.IsFromCert()) {
-                    ss << coins.nBwtMaturityHeight;
-                    ss << coins.nBwtMaturityHeight;;
-                }
-                stats.nSerializedSize += 32 + slValue.size();
-                ss << VARINT(0);
+            if (chType != DB_COIN)
+                break;
+            CDataStream ssOutputKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+            CCoinsOutputKey key;
+            ssOutputKey >> key;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+            CCoinsOutputRecord record;
+            ssValue >> record;
+
+            if (key.txid != txhash) {
+                if (!coins.IsPruned())
+                    AddCoinsToStats(stats, ss, nTotalAmount, txhash, coins);
+                txhash = key.txid;
+                coins = record.header;
+                stats.nSerializedSize += 32;
             }
+            if (coins.vout.size() <= key.n)
+                coins.vout.resize(key.n + 1);
+            coins.vout[key.n] = record.out;
+            stats.nSerializedSize += slValue.size();
             pcursor->Next();
         } catch (const std::exception& e) {
             return error("%s: Deserialize or I/O error - %s", __func__, e.what());
         }
     }
+    if (!coins.IsPruned())
+        AddCoinsToStats(stats, ss, nTotalAmount, txhash, coins);
     {
         LOCK(cs_main);
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
@@ -335,6 +716,80 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
     return true;
 }
 
+bool CCoinsViewDB::Upgrade() {
+    boost::scoped_ptr<leveldb::Iterator> pcursor(db.NewIterator());
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair(DB_COINS, uint256());
+    pcursor->Seek(ssKeySet.str());
+    if (!pcursor->Valid() || pcursor->key()[0] != DB_COINS)
+        return true;
+
+    // Every batch moves some transactions to the new layout and erases their old records atomically,
+    // so an interrupted upgrade is resumed from where it stopped at the next start.
+    LogPrintf("Upgrading the chainstate database to one record per unspent output...\n");
+    uiInterface.InitMessage(_("Upgrading chainstate database..."));
+    static const size_t BATCH_SIZE = 16 << 20;
+    CLevelDBBatch batch;
+    size_t nBatchSize = 0;
+    size_t nTransactions = 0;
+    size_t nOutputs = 0;
+    int nReportedProgress = -1;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            break;
+
+        leveldb::Slice slKey = pcursor->key();
+        CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+        char chType;
+        ssKey >> chType;
+        if (chType != DB_COINS)
+            break;
+        uint256 txid;
+        ssKey >> txid;
+        leveldb::Slice slValue = pcursor->value();
+        CCoins coins;
+        try {
+            CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> coins;
+        } catch (const std::exception& e) {
+            return error("%s: unable to parse coins of %s: %s", __func__, txid.ToString(), e.what());
+        }
+
+        for (uint32_t n = 0; n < coins.vout.size(); n++) {
+            if (coins.vout[n].IsNull())
+                continue;
+            batch.Write(CCoinsOutputKey(txid, n), CCoinsOutputRecord(coins, n));
+            nOutputs++;
+        }
+        batch.Erase(make_pair(DB_COINS, txid));
+        nTransactions++;
+        nBatchSize += slKey.size() + slValue.size();
+
+        if (nBatchSize >= BATCH_SIZE) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+            nBatchSize = 0;
+            // keys are sorted by txid, whose first byte tells how far along the upgrade is
+            int nProgress = (int)(*txid.begin()) * 100 / 256;
+            if (nProgress != nReportedProgress) {
+                uiInterface.ShowProgress(_("Upgrading chainstate database..."), nProgress);
+                LogPrintf("Upgrading the chainstate database: %d%% done\n", nProgress);
+                nReportedProgress = nProgress;
+            }
+        }
+    }
+    HandleError(pcursor->status());
+    if (!db.WriteBatch(batch))
+        return false;
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("Moved %u unspent outputs of %u transactions to the new chainstate layout\n", nOutputs, nTransactions);
+    if (ShutdownRequested())
+        LogPrintf("Chainstate database upgrade interrupted, it will be resumed at the next start\n");
+    return true;
+}
+
 void CCoinsViewDB::Dump_info()  const
 {
     // dump leveldb contents on stdout
@@ -394,6 +849,219 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >&vect) {
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >&vect) {
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressIndex(const uint160 &addressHash, uint8_t addressType,
+                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                    int nStart, int nEnd) {
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    // the changes to an address are adjacent and sorted by height: seek to the first one wanted
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    if (nStart > 0)
+        ssKeySet << make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(addressType, addressHash, nStart));
+    else
+        ssKeySet << make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(addressType, addressHash));
+
+    for (pcursor->Seek(ssKeySet.str()); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            CAddressIndexKey key;
+            // stop at the first key past the index, whose size may differ
+            ssKey >> chType;
+            if (chType != DB_ADDRESSINDEX || ssKey.size() != key.GetSerializeSize(SER_DISK, CLIENT_VERSION))
+                break;
+            ssKey >> key;
+            if (key.addressType != addressType || key.addressHash != addressHash)
+                break;
+            if (nEnd > 0 && key.nHeight > nEnd)
+                break;
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAmount nValue;
+            ssValue >> nValue;
+            addressIndex.push_back(make_pair(key, nValue));
+        } catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >&vect) {
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        else
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(const uint160 &addressHash, uint8_t addressType,
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(addressType, addressHash));
+
+    for (pcursor->Seek(ssKeySet.str()); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            CAddressUnspentKey key;
+            // stop at the first key past the index, whose size may differ
+            ssKey >> chType;
+            if (chType != DB_ADDRESSUNSPENTINDEX || ssKey.size() != key.GetSerializeSize(SER_DISK, CLIENT_VERSION))
+                break;
+            ssKey >> key;
+            if (key.addressType != addressType || key.addressHash != addressHash)
+                break;
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAddressUnspentValue value;
+            ssValue >> value;
+            unspentOutputs.push_back(make_pair(key, value));
+        } catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
+        else
+            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) {
+    return Read(make_pair(DB_SPENTINDEX, key), value);
+}
+
+bool CBlockTreeDB::WriteScIndex(const std::vector<std::pair<CScIndexKey, CScIndexValue> >&vect) {
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CScIndexKey, CScIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Write(make_pair(DB_SCINDEX, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseScIndex(const std::vector<std::pair<CScIndexKey, CScIndexValue> >&vect) {
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<CScIndexKey, CScIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Erase(make_pair(DB_SCINDEX, it->first));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadScIndex(const uint256 &scId, std::vector<std::pair<CScIndexKey, CScIndexValue> > &scIndex,
+                               int nStart, int nEnd) {
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    // the activity of a sidechain is adjacent and sorted by height: seek to the first entry wanted
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    if (nStart > 0)
+        ssKeySet << make_pair(DB_SCINDEX, CScIndexIteratorKey(scId, nStart));
+    else
+        ssKeySet << make_pair(DB_SCINDEX, CScIndexIteratorKey(scId));
+
+    for (pcursor->Seek(ssKeySet.str()); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            CScIndexKey key;
+            // stop at the first key past the index, whose size may differ
+            ssKey >> chType;
+            if (chType != DB_SCINDEX || ssKey.size() != key.GetSerializeSize(SER_DISK, CLIENT_VERSION))
+                break;
+            ssKey >> key;
+            if (key.scId != scId)
+                break;
+            if (nEnd > 0 && key.nHeight > nEnd)
+                break;
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+            CScIndexValue value;
+            ssValue >> value;
+            scIndex.push_back(make_pair(key, value));
+        } catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &key) {
+    return Write(make_pair(DB_TIMESTAMPINDEX, key), '0');
+}
+
+bool CBlockTreeDB::EraseTimestampIndex(const CTimestampIndexKey &key) {
+    return Erase(make_pair(DB_TIMESTAMPINDEX, key));
+}
+
+bool CBlockTreeDB::ReadTimestampIndex(unsigned int nHigh, unsigned int nLow, std::vector<uint256> &hashes) {
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(nLow));
+
+    for (pcursor->Seek(ssKeySet.str()); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            CTimestampIndexKey key;
+            // stop at the first key past the index, whose size may differ
+            ssKey >> chType;
+            if (chType != DB_TIMESTAMPINDEX || ssKey.size() != key.GetSerializeSize(SER_DISK, CLIENT_VERSION))
+                break;
+            ssKey >> key;
+            if (key.nTime >= nHigh)
+                break;
+            hashes.push_back(key.blockHash);
+        } catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::WriteBestIndexBlock(const std::string &name, const CBlockLocator &locator) {
+    return Write(std::make_pair(DB_INDEX_BEST_BLOCK, name), locator);
+}
+
+bool CBlockTreeDB::ReadBestIndexBlock(const std::string &name, CBlockLocator &locator) {
+    return Read(std::make_pair(DB_INDEX_BEST_BLOCK, name), locator);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
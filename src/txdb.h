@@ -10,13 +10,25 @@
 #include "leveldbwrapper.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <boost/thread.hpp>
+
 class CBlockFileInfo;
 class CBlockIndex;
+struct CBlockLocator;
+struct CAddressIndexKey;
+struct CAddressUnspentKey;
+struct CAddressUnspentValue;
 struct CDiskTxPos;
+struct CScIndexKey;
+struct CScIndexValue;
+struct CSpentIndexKey;
+struct CSpentIndexValue;
+struct CTimestampIndexKey;
 class uint256;
 
 //! -dbcache default (MiB)
@@ -55,6 +67,87 @@ public:
                     CSidechainEventsMap& mapSidechainEvents)                 override;
     bool GetStats(CCoinsStats &stats)                                  const override;
     void Dump_info() const;
+
+    /**
+     * Move the coins stored by older versions, one record per transaction, to one record per unspent output,
+     * so that spending an output no longer rewrites all the other outputs of its transaction.
+     * It can be interrupted by a shutdown request and is resumed at the next call. Return false on error.
+     */
+    bool Upgrade();
+
+    //! Write the dirty entries of the given maps as BatchWrite does, but leave the maps untouched
+    bool WriteChanges(const CCoinsMap &mapCoins,
+                      const uint256 &hashBlock,
+                      const uint256 &hashAnchor,
+                      const CAnchorsMap &mapAnchors,
+                      const CNullifiersMap &mapNullifiers,
+                      const CSidechainsMap& mapSidechains,
+                      const CSidechainEventsMap& mapSidechainEvents);
+};
+
+/**
+ * CCoinsView between the coins cache and the coin database, which writes to the database in a
+ * background thread: BatchWrite just queues the changes, and they are served to readers from memory
+ * until they are on disk. Only one batch is in flight at a time and batches are written in order,
+ * each one atomically together with its best block, so the chainstate on disk is always consistent
+ * and never goes backwards. As BatchWrite is called only after the block index has been written,
+ * the best block on disk is never ahead of the block index.
+ */
+class CCoinsViewWriteBehind : public CCoinsViewBacked
+{
+private:
+    struct CChanges
+    {
+        CCoinsMap mapCoins;
+        uint256 hashBlock;
+        uint256 hashAnchor;
+        CAnchorsMap mapAnchors;
+        CNullifiersMap mapNullifiers;
+        CSidechainsMap mapSidechains;
+        CSidechainEventsMap mapSidechainEvents;
+    };
+
+    CCoinsViewDB& db;
+
+    mutable boost::mutex cs;
+    mutable boost::condition_variable cond;
+    //! changes queued or being written, immutable so that readers can look them up without locking
+    std::shared_ptr<const CChanges> pending;
+    //! the last write failed: its changes stay pending, so that readers keep seeing them, and no more are accepted
+    bool fWriteFailed;
+    bool fStop;
+
+    boost::thread writerThread;
+
+    std::shared_ptr<const CChanges> GetPending() const;
+    void ThreadWrite();
+
+public:
+    explicit CCoinsViewWriteBehind(CCoinsViewDB* dbIn);
+    ~CCoinsViewWriteBehind();
+
+    bool GetAnchorAt(const uint256 &rt, ZCIncrementalMerkleTree &tree) const override;
+    bool GetNullifier(const uint256 &nf)                               const override;
+    bool GetCoins(const uint256 &txid, CCoins &coins)                  const override;
+    bool HaveCoins(const uint256 &txid)                                const override;
+    bool GetSidechain(const uint256& scId, CSidechain& info)           const override;
+    bool HaveSidechain(const uint256& scId)                            const override;
+    bool HaveSidechainEvents(int height)                               const override;
+    bool GetSidechainEvents(int height, CSidechainEvents& scEvents)    const override;
+    void GetScIds(std::set<uint256>& scIdsList)                        const override;
+    uint256 GetBestBlock()                                             const override;
+    uint256 GetBestAnchor()                                            const override;
+    bool BatchWrite(CCoinsMap &mapCoins,
+                    const uint256 &hashBlock,
+                    const uint256 &hashAnchor,
+                    CAnchorsMap &mapAnchors,
+                    CNullifiersMap &mapNullifiers,
+                    CSidechainsMap& mapSidechains,
+                    CSidechainEventsMap& mapSidechainEvents)                 override;
+    bool GetStats(CCoinsStats &stats)                                  const override;
+
+    //! Wait until the queued changes are on disk, return false if writing them failed
+    bool WaitForWrite() const;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -73,6 +166,31 @@ public:
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    //! Read the changes to the balance of an address, in chain order, between the given heights if nEnd is not 0
+    bool ReadAddressIndex(const uint160 &addressHash, uint8_t addressType,
+                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                          int nStart = 0, int nEnd = 0);
+    //! Write the given unspent outputs, erasing those whose value is null
+    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+    bool ReadAddressUnspentIndex(const uint160 &addressHash, uint8_t addressType,
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+    //! Write the given spent outputs, erasing those whose value is null
+    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &vect);
+    bool ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value);
+    bool WriteScIndex(const std::vector<std::pair<CScIndexKey, CScIndexValue> > &vect);
+    bool EraseScIndex(const std::vector<std::pair<CScIndexKey, CScIndexValue> > &vect);
+    //! Read the activity of a sidechain, in chain order, between the given heights if nEnd is not 0
+    bool ReadScIndex(const uint256 &scId, std::vector<std::pair<CScIndexKey, CScIndexValue> > &scIndex,
+                     int nStart = 0, int nEnd = 0);
+    bool WriteTimestampIndex(const CTimestampIndexKey &key);
+    bool EraseTimestampIndex(const CTimestampIndexKey &key);
+    //! Read the hashes of the blocks with nLow <= time < nHigh, sorted by time
+    bool ReadTimestampIndex(unsigned int nHigh, unsigned int nLow, std::vector<uint256> &hashes);
+    //! Locator of the last block indexed by a background index
+    bool WriteBestIndexBlock(const std::string &name, const CBlockLocator &locator);
+    bool ReadBestIndexBlock(const std::string &name, CBlockLocator &locator);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts();
@@ -0,0 +1,177 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txindex.h"
+
+#include "chain.h"
+#include "main.h"
+#include "txdb.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/bind.hpp>
+
+/** How often, in seconds, the locator is saved while catching up */
+static const int64_t LOCATOR_WRITE_INTERVAL = 30;
+
+CBaseIndex::CBaseIndex(): fTipChanged(false), fStop(false), pindexBest(NULL) {}
+
+CBaseIndex::~CBaseIndex()
+{
+    Stop();
+}
+
+bool CBaseIndex::WriteBestBlock(const CBlockIndex* pindex)
+{
+    CBlockLocator locator;
+    {
+        LOCK(cs_main);
+        locator = chainActive.GetLocator(pindex);
+    }
+    if (!pblocktree->WriteBestIndexBlock(GetName(), locator))
+        return error("%s: failed to write the locator of the %s", __func__, GetName());
+    return true;
+}
+
+void CBaseIndex::ChainTip(const CBlockIndex *pindex, const CBlock *pblock, ZCIncrementalMerkleTree tree, bool added)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    fTipChanged = true;
+    cond.notify_all();
+}
+
+void CBaseIndex::ThreadSync()
+{
+    RenameThread(("horizen-" + GetName()).c_str());
+
+    const CBlockIndex* pindexWritten = pindexBest;
+    int64_t nLastWrite = GetTime();
+    try {
+        while (true) {
+            const CBlockIndex* pindexNext;
+            CDiskBlockPos pos;
+            {
+                LOCK(cs_main);
+                // after a reorganization, resume after the fork point: the blocks before it are indexed already
+                if (pindexBest && !chainActive.Contains(pindexBest))
+                    pindexBest = chainActive.FindFork(pindexBest);
+                pindexNext = pindexBest ? chainActive.Next(pindexBest) : chainActive.Genesis();
+                if (pindexNext) {
+                    if (!(pindexNext->nStatus & BLOCK_HAVE_DATA)) {
+                        LogPrintf("%s: block %s of the %s is not available\n", __func__, pindexNext->GetBlockHash().ToString(), GetName());
+                        break;
+                    }
+                    pos = pindexNext->GetBlockPos();
+                }
+            }
+
+            if (pindexBest != pindexWritten && (!pindexNext || GetTime() - nLastWrite >= LOCATOR_WRITE_INTERVAL)) {
+                if (!WriteBestBlock(pindexBest))
+                    break;
+                pindexWritten = pindexBest;
+                nLastWrite = GetTime();
+            }
+
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                if (!pindexNext) {
+                    LogPrint("bench", "%s():%d - %s synced to %s\n", __func__, __LINE__, GetName(),
+                        pindexBest ? pindexBest->GetBlockHash().ToString() : "null");
+                    while (!fStop && !fTipChanged)
+                        cond.wait(lock);
+                    fTipChanged = false;
+                }
+                if (fStop)
+                    break;
+                if (!pindexNext)
+                    continue;
+            }
+
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pos) || block.GetHash() != pindexNext->GetBlockHash()) {
+                LogPrintf("%s: failed to read block %s for the %s\n", __func__, pindexNext->GetBlockHash().ToString(), GetName());
+                break;
+            }
+            if (!WriteBlock(block, pindexNext)) {
+                LogPrintf("%s: failed to write block %s to the %s\n", __func__, pindexNext->GetBlockHash().ToString(), GetName());
+                break;
+            }
+            pindexBest = pindexNext;
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+
+    if (pindexBest != pindexWritten)
+        WriteBestBlock(pindexBest);
+    LogPrintf("%s: %s stopped at %s\n", __func__, GetName(), pindexBest ? pindexBest->GetBlockHash().ToString() : "null");
+}
+
+void CBaseIndex::Start()
+{
+    {
+        LOCK(cs_main);
+        CBlockLocator locator;
+        if (pblocktree->ReadBestIndexBlock(GetName(), locator))
+            pindexBest = locator.IsNull() ? NULL : FindForkInGlobalIndex(chainActive, locator);
+        else
+            pindexBest = GetLegacyBestBlock();
+        LogPrintf("%s: %s resuming after height %d\n", __func__, GetName(), pindexBest ? pindexBest->nHeight : -1);
+    }
+    if (pindexBest)
+        WriteBestBlock(pindexBest);
+
+    RegisterValidationInterface(this);
+    thread = boost::thread(boost::bind(&CBaseIndex::ThreadSync, this));
+}
+
+void CBaseIndex::Stop()
+{
+    UnregisterValidationInterface(this);
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
+        cond.notify_all();
+    }
+    if (thread.joinable())
+        thread.join();
+}
+
+bool CTxIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+    GetTxIndexPositions(block, pindex->GetBlockPos(), vPos);
+    return pblocktree->WriteTxIndex(vPos);
+}
+
+const CBlockIndex* CTxIndex::GetLegacyBestBlock()
+{
+    // older versions wrote the index as blocks were connected, and only kept a flag
+    bool fLegacy = false;
+    if (pblocktree->ReadFlag("txindex", fLegacy) && fLegacy)
+        return chainActive.Tip();
+    return NULL;
+}
+
+static CTxIndex* ptxindex = NULL;
+
+void StartTxIndex()
+{
+    if (!fTxIndex) {
+        // the index is not maintained anymore: the blocks connected from now on will be missing
+        pblocktree->WriteFlag("txindex", false);
+        return;
+    }
+    ptxindex = new CTxIndex();
+    ptxindex->Start();
+}
+
+void StopTxIndex()
+{
+    if (ptxindex) {
+        ptxindex->Stop();
+        delete ptxindex;
+        ptxindex = NULL;
+    }
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The Zen Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXINDEX_H
+#define BITCOIN_TXINDEX_H
+
+#include "validationinterface.h"
+
+#include <string>
+
+#include <boost/thread.hpp>
+
+class CBlock;
+class CBlockIndex;
+
+/**
+ * Index of the active chain built by a background thread, off the validation path. It keeps the
+ * locator of the last block it indexed in the block tree database, catches up from the block files
+ * when started behind the tip, and then follows the tip as blocks are connected. When the chain is
+ * reorganized, it resumes after the fork point. Since it does not depend on the chainstate, it can
+ * be turned on and off without reindexing.
+ */
+class CBaseIndex : public CValidationInterface
+{
+private:
+    boost::mutex cs;
+    boost::condition_variable cond;
+    //! the tip changed since the thread last looked at it
+    bool fTipChanged;
+    bool fStop;
+    boost::thread thread;
+
+    //! the last block indexed, only used by the thread once started
+    const CBlockIndex* pindexBest;
+
+    void ThreadSync();
+    bool WriteBestBlock(const CBlockIndex* pindex);
+
+protected:
+    void ChainTip(const CBlockIndex *pindex, const CBlock *pblock, ZCIncrementalMerkleTree tree, bool added) override;
+
+    //! Index a block of the active chain, return false on error
+    virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) = 0;
+
+    //! Name of the index, in logs and as the key of its locator
+    virtual std::string GetName() const = 0;
+
+    //! Where to resume when the index has no locator yet; NULL to start from the genesis block
+    virtual const CBlockIndex* GetLegacyBestBlock() { return NULL; }
+
+public:
+    CBaseIndex();
+    virtual ~CBaseIndex();
+
+    //! Start following the active chain from the stored locator, once the block index is loaded
+    void Start();
+    //! Stop the thread, saving the locator of the last block indexed
+    void Stop();
+};
+
+/** Index of the position on disk of each transaction and certificate of the active chain, for -txindex */
+class CTxIndex : public CBaseIndex
+{
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+    std::string GetName() const override { return "txindex"; }
+    const CBlockIndex* GetLegacyBestBlock() override;
+};
+
+/** Start building the transaction index in the background if -txindex is set */
+void StartTxIndex();
+/** Stop building the transaction index, before the block tree database is closed */
+void StopTxIndex();
+
+#endif // BITCOIN_TXINDEX_H
@@ -92,7 +92,8 @@ CCertificateMemPoolEntry::GetPriority(unsigned int currentHeight) const
 }
 
 CTxMemPool::CTxMemPool(const CFeeRate& _minRelayFee) :
-    nTransactionsUpdated(0), nCertificatesUpdated(0), cachedInnerUsage(0)
+    nTransactionsUpdated(0), nCertificatesUpdated(0), cachedInnerUsage(0), minReasonableRelayFee(_minRelayFee),
+    lastRollingFeeUpdate(GetTime()), blockSinceLastRollingFeeBump(false), rollingMinimumFeeRate(0)
 {
     // Sanity checks off by default for performance, because otherwise
     // accepting transactions becomes O(N^2) where N is the number
@@ -165,12 +166,16 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
         mapSidechains[fwd.scId].fwdTransfersSet.insert(hash);
     }
 
+    setTxByFeeRate.insert(std::make_pair(GetModifiedFeeRate(hash, entry), hash));
+    setTxByTime.insert(std::make_pair(entry.GetTime(), hash));
+
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
     cachedInnerUsage += entry.DynamicMemoryUsage();
     minerPolicyEstimator->processTransaction(entry, fCurrentEstimate);
     LogPrint("sc", "%s():%d - tx [%s] added in mempool\n", __func__, __LINE__, hash.ToString() );
 
+    NotifyEntryAdded(hash);
     return true;
 }
 
@@ -195,6 +200,8 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CCertificateMemPoolEntr
     // TODO cert: for the time being skip the part on policy estimator, certificates currently have maximum priority
     // minerPolicyEstimator->processTransaction(entry, fCurrentEstimate);
     LogPrint("mempool", "%s():%d - cert [%s] added in mempool\n", __func__, __LINE__, hash.ToString() );
+
+    NotifyEntryAdded(hash);
     return true;
 }
 
@@ -299,7 +306,10 @@ void CTxMemPool::remove(const CTransactionBase& origTx, std::list<CTransaction>&
                 totalTxSize -= mapTx[hash].GetTxSize();
                 cachedInnerUsage -= mapTx[hash].DynamicMemoryUsage();
  
+                setTxByFeeRate.erase(std::make_pair(GetModifiedFeeRate(hash, mapTx[hash]), hash));
+                setTxByTime.erase(std::make_pair(mapTx[hash].GetTime(), hash));
                 LogPrint("mempool", "%s():%d - removing tx [%s] from mempool\n", __func__, __LINE__, hash.ToString() );
+                NotifyEntryRemoved(hash);
                 mapTx.erase(hash);
  
                 nTransactionsUpdated++;
@@ -334,6 +344,7 @@ void CTxMemPool::remove(const CTransactionBase& origTx, std::list<CTransaction>&
                 totalCertificateSize -= mapCertificate[hash].GetCertificateSize();
                 cachedInnerUsage -= mapCertificate[hash].DynamicMemoryUsage();
                 LogPrint("mempool", "%s():%d - removing cert [%s] from mempool\n", __func__, __LINE__, hash.ToString() );
+                NotifyEntryRemoved(hash);
                 mapCertificate.erase(hash);
                 nCertificatesUpdated++;
             }
@@ -600,6 +611,8 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
     }
     // After the txs in the new block have been removed from the mempool, update policy estimates
     minerPolicyEstimator->processBlock(nBlockHeight, entries, fCurrentEstimate);
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = true;
 }
 
 void CTxMemPool::removeConflicts(const CScCertificate &cert,std::list<CTransaction>& removedTxs, std::list<CScCertificate>& removedCerts) {
@@ -646,11 +659,17 @@ void CTxMemPool::removeForBlock(const std::vector<CScCertificate>& vcert, unsign
 void CTxMemPool::clear()
 {
     LOCK(cs);
+    for (const auto& entry : mapTx)
+        NotifyEntryRemoved(entry.first);
+    for (const auto& entry : mapCertificate)
+        NotifyEntryRemoved(entry.first);
     mapTx.clear();
     mapCertificate.clear();
     mapDeltas.clear();
     mapNextTx.clear();
     mapSidechains.clear();
+    setTxByFeeRate.clear();
+    setTxByTime.clear();
     totalTxSize = 0;
     totalCertificateSize = 0;
     cachedInnerUsage = 0;
@@ -891,6 +910,14 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         assert(&tx == it->second);
     }
 
+    assert(setTxByFeeRate.size() == mapTx.size());
+    assert(setTxByTime.size() == mapTx.size());
+    for (std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.begin(); it != mapTx.end(); it++)
+    {
+        assert(setTxByFeeRate.count(std::make_pair(GetModifiedFeeRate(it->first, it->second), it->first)));
+        assert(setTxByTime.count(std::make_pair(it->second.GetTime(), it->first)));
+    }
+
     assert((totalTxSize+totalCertificateSize) == checkTotal);
     assert(innerUsage == cachedInnerUsage);
 }
@@ -975,9 +1002,19 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const std::string& s
 {
     {
         LOCK(cs);
+        // the fee rate index is keyed on the modified fee, re-insert the tx if it is in the pool
+        std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.find(hash);
+        if (it != mapTx.end())
+            setTxByFeeRate.erase(std::make_pair(GetModifiedFeeRate(hash, it->second), hash));
+
         std::pair<double, CAmount> &deltas = mapDeltas[hash];
         deltas.first += dPriorityDelta;
         deltas.second += nFeeDelta;
+
+        if (it != mapTx.end())
+            setTxByFeeRate.insert(std::make_pair(GetModifiedFeeRate(hash, it->second), hash));
+
+        NotifyEntryPrioritised(hash);
     }
     LogPrintf("PrioritiseTransaction: %s priority += %f, fee += %d\n", strHash, dPriorityDelta, FormatMoney(nFeeDelta));
 }
@@ -996,7 +1033,205 @@ void CTxMemPool::ApplyDeltas(const uint256& hash, double &dPriorityDelta, CAmoun
 void CTxMemPool::ClearPrioritisation(const uint256& hash)
 {
     LOCK(cs);
+    std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.find(hash);
+    if (it != mapTx.end())
+        setTxByFeeRate.erase(std::make_pair(GetModifiedFeeRate(hash, it->second), hash));
+
     mapDeltas.erase(hash);
+
+    if (it != mapTx.end())
+        setTxByFeeRate.insert(std::make_pair(GetModifiedFeeRate(hash, it->second), hash));
+
+    NotifyEntryPrioritised(hash);
+}
+
+CFeeRate CTxMemPool::GetModifiedFeeRate(const uint256& hash, const CTxMemPoolEntry& entry) const
+{
+    CAmount nFee = entry.GetFee();
+    std::map<uint256, std::pair<double, CAmount> >::const_iterator pos = mapDeltas.find(hash);
+    if (pos != mapDeltas.end())
+        nFee += pos->second.second;
+    return CFeeRate(nFee, entry.GetTxSize());
+}
+
+void CTxMemPool::CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const
+{
+    LOCK(cs);
+    std::deque<uint256> objToVisit;
+    objToVisit.push_back(hash);
+
+    while (!objToVisit.empty())
+    {
+        const uint256 objHash = objToVisit.front();
+        objToVisit.pop_front();
+
+        const CTransactionBase* pObj = nullptr;
+        std::map<uint256, CTxMemPoolEntry>::const_iterator itTx = mapTx.find(objHash);
+        if (itTx != mapTx.end())
+        {
+            pObj = &itTx->second.GetTx();
+
+            // forward transfers to a sidechain created by this tx depend on it as well
+            for(const auto& sc: itTx->second.GetTx().GetVscCcOut()) {
+                std::map<uint256, CSidechainMemPoolEntry>::const_iterator itSc = mapSidechains.find(sc.GetScId());
+                if (itSc == mapSidechains.end())
+                    continue;
+                for(const auto& fwdTxHash : itSc->second.fwdTransfersSet)
+                    objToVisit.push_back(fwdTxHash);
+            }
+        }
+        else
+        {
+            std::map<uint256, CCertificateMemPoolEntry>::const_iterator itCert = mapCertificate.find(objHash);
+            if (itCert == mapCertificate.end())
+                continue;
+            pObj = &itCert->second.GetCertificate();
+        }
+
+        if (!setDescendants.insert(objHash).second)
+            continue;
+
+        for (unsigned int i = 0; i < pObj->GetVout().size(); i++) {
+            std::map<COutPoint, CInPoint>::const_iterator it = mapNextTx.find(COutPoint(objHash, i));
+            if (it == mapNextTx.end())
+                continue;
+            objToVisit.push_back(it->second.ptx->GetHash());
+        }
+    }
+}
+
+CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const
+{
+    LOCK(cs);
+    if (!blockSinceLastRollingFeeBump || rollingMinimumFeeRate == 0)
+        return CFeeRate((CAmount)rollingMinimumFeeRate);
+
+    int64_t time = GetTime();
+    if (time > lastRollingFeeUpdate + 10) {
+        // decay faster when the pool has plenty of room
+        double halflife = ROLLING_FEE_HALFLIFE;
+        if (DynamicMemoryUsage() < sizelimit / 4)
+            halflife /= 4;
+        else if (DynamicMemoryUsage() < sizelimit / 2)
+            halflife /= 2;
+
+        rollingMinimumFeeRate = rollingMinimumFeeRate / pow(2.0, (time - lastRollingFeeUpdate) / halflife);
+        lastRollingFeeUpdate = time;
+
+        if (rollingMinimumFeeRate < minReasonableRelayFee.GetFeePerK() / 2) {
+            rollingMinimumFeeRate = 0;
+            return CFeeRate(0);
+        }
+    }
+    return std::max(CFeeRate((CAmount)rollingMinimumFeeRate), minReasonableRelayFee);
+}
+
+void CTxMemPool::trackPackageRemoved(const CFeeRate& rate)
+{
+    AssertLockHeld(cs);
+    if (rate.GetFeePerK() > rollingMinimumFeeRate) {
+        rollingMinimumFeeRate = rate.GetFeePerK();
+        blockSinceLastRollingFeeBump = false;
+    }
+}
+
+void CTxMemPool::TrimToSize(size_t sizelimit)
+{
+    LOCK(cs);
+
+    unsigned int nTxnRemoved = 0;
+    CFeeRate maxFeeRateRemoved(0);
+    std::set<std::pair<CFeeRate, uint256> >::const_iterator it = setTxByFeeRate.begin();
+    while (it != setTxByFeeRate.end() && DynamicMemoryUsage() > sizelimit)
+    {
+        const std::pair<CFeeRate, uint256> key = *it;
+
+        std::set<uint256> setDescendants;
+        CalculateDescendants(key.second, setDescendants);
+
+        bool fProtected = false;
+        CAmount nPackageFees = 0;
+        size_t nPackageSize = 0;
+        for (const uint256& hash : setDescendants)
+        {
+            std::map<uint256, CTxMemPoolEntry>::const_iterator itTx = mapTx.find(hash);
+            if (itTx == mapTx.end())
+            {
+                // a certificate depends on this tx
+                fProtected = true;
+                break;
+            }
+            nPackageFees += itTx->second.GetFee();
+            nPackageSize += itTx->second.GetTxSize();
+        }
+
+        if (fProtected)
+        {
+            LogPrint("mempool", "%s():%d - not evicting tx [%s]: a certificate depends on it\n",
+                __func__, __LINE__, key.second.ToString());
+            ++it;
+            continue;
+        }
+
+        // the pool must then require a fee rate strictly higher than the one of the evicted package
+        CFeeRate removed(nPackageFees, nPackageSize);
+        removed = CFeeRate(removed.GetFeePerK() + minReasonableRelayFee.GetFeePerK());
+        trackPackageRemoved(removed);
+        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+
+        std::list<CTransaction> removedTxs;
+        std::list<CScCertificate> removedCerts;
+        remove(mapTx[key.second].GetTx(), removedTxs, removedCerts, true);
+        nTxnRemoved += removedTxs.size();
+
+        // the entries skipped so far rank before this one and, being protected, are not among its descendants
+        it = setTxByFeeRate.upper_bound(key);
+    }
+
+    if (maxFeeRateRemoved > CFeeRate(0))
+        LogPrint("mempool", "Removed %u txn, rolling minimum fee bumped to %s\n", nTxnRemoved, maxFeeRateRemoved.ToString());
+}
+
+int CTxMemPool::Expire(int64_t time)
+{
+    LOCK(cs);
+
+    int nRemoved = 0;
+    std::set<std::pair<int64_t, uint256> >::const_iterator it = setTxByTime.begin();
+    while (it != setTxByTime.end() && it->first < time)
+    {
+        const std::pair<int64_t, uint256> key = *it;
+
+        std::set<uint256> setDescendants;
+        CalculateDescendants(key.second, setDescendants);
+
+        bool fProtected = false;
+        for (const uint256& hash : setDescendants)
+        {
+            if (mapCertificate.count(hash))
+            {
+                fProtected = true;
+                break;
+            }
+        }
+
+        if (fProtected)
+        {
+            LogPrint("mempool", "%s():%d - not expiring tx [%s]: a certificate depends on it\n",
+                __func__, __LINE__, key.second.ToString());
+            ++it;
+            continue;
+        }
+
+        LogPrint("mempool", "%s():%d - expiring tx [%s] entered at %d\n", __func__, __LINE__, key.second.ToString(), key.first);
+        std::list<CTransaction> removedTxs;
+        std::list<CScCertificate> removedCerts;
+        remove(mapTx[key.second].GetTx(), removedTxs, removedCerts, true);
+        nRemoved += removedTxs.size();
+
+        it = setTxByTime.upper_bound(key);
+    }
+    return nRemoved;
 }
 
 bool CTxMemPool::HasNoInputsOf(const CTransaction &tx) const
@@ -1147,6 +1382,8 @@ size_t CTxMemPool::DynamicMemoryUsage() const {
           memusage::DynamicUsage(mapDeltas) +
           memusage::DynamicUsage(mapCertificate) +
           memusage::DynamicUsage(mapSidechains) +
+          memusage::DynamicUsage(setTxByFeeRate) +
+          memusage::DynamicUsage(setTxByTime) +
           cachedInnerUsage);
 }
 
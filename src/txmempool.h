@@ -14,6 +14,8 @@
 #include "primitives/certificate.h"
 #include "sync.h"
 
+#include <boost/signals2/signal.hpp>
+
 class CAutoFile;
 
 inline double AllowFreeThreshold()
@@ -151,7 +153,25 @@ private:
     uint64_t nRecentlyAddedSequence = 0;
     uint64_t nNotifiedSequence = 0;
 
+    //! transactions ordered by fee rate (including prioritisation deltas), lowest first: the eviction order
+    //! when the pool exceeds its size limit. Certificates are not evicted and thus not indexed.
+    std::set<std::pair<CFeeRate, uint256> > setTxByFeeRate;
+
+    //! transactions ordered by the time they entered the pool, oldest first: the expiry order
+    std::set<std::pair<int64_t, uint256> > setTxByTime;
+
+    CFeeRate minReasonableRelayFee;
+
+    mutable int64_t lastRollingFeeUpdate;
+    mutable bool blockSinceLastRollingFeeBump;
+    mutable double rollingMinimumFeeRate; //! minimum fee to get into the pool, decreases exponentially
+
+    CFeeRate GetModifiedFeeRate(const uint256& hash, const CTxMemPoolEntry& entry) const;
+    void trackPackageRemoved(const CFeeRate& rate);
+
 public:
+    static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; // public only for testing
+
     mutable CCriticalSection cs;
     std::map<uint256, CTxMemPoolEntry> mapTx;
     std::map<uint256, CCertificateMemPoolEntry> mapCertificate;
@@ -195,6 +215,25 @@ public:
                         std::list<CTransaction>& removedTxs, std::list<CScCertificate>& removedCerts);
 
     void clear();
+
+    /** Fill setDescendants with the hashes of the pool entries spending the outputs of the given tx or cert,
+     *  recursively, together with the forward transfers to the sidechains it creates (as remove() does).
+     *  setDescendants also includes the hash given in input, if it is in the pool. */
+    void CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const;
+
+    /** The minimum fee to get into the mempool, which may itself not be enough
+     *  for larger-sized transactions. */
+    CFeeRate GetMinFee(size_t sizelimit) const;
+
+    /** Remove transactions from the mempool until its dynamic size is <= sizelimit, lowest fee rate first
+     *  together with their descendants. Transactions having a certificate among their descendants are never
+     *  evicted, so that certificates due within their submission window are not lost. */
+    void TrimToSize(size_t sizelimit);
+
+    /** Remove transactions which entered the pool before time, together with their descendants. As for
+     *  TrimToSize(), transactions certificates depend on are kept. Return the number of removed transactions. */
+    int Expire(int64_t time);
+
     void queryHashes(std::vector<uint256>& vtxid);
     void pruneSpent(const uint256& hash, CCoins &coins);
     unsigned int GetTransactionsUpdated() const;
@@ -213,6 +252,13 @@ public:
     void NotifyRecentlyAdded();
     bool IsFullyNotified();
 
+    /** Fired, with cs held, once a transaction or certificate is in the pool */
+    boost::signals2::signal<void (const uint256& hash)> NotifyEntryAdded;
+    /** Fired, with cs held, when a transaction or certificate is about to leave the pool */
+    boost::signals2::signal<void (const uint256& hash)> NotifyEntryRemoved;
+    /** Fired, with cs held, when the prioritisation deltas of a transaction or certificate change */
+    boost::signals2::signal<void (const uint256& hash)> NotifyEntryPrioritised;
+
     unsigned long sizeTx()
     {
         LOCK(cs);
@@ -3711,6 +3711,16 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp)
             }
         } else if (benchmarktype == "verifyjoinsplit") {
             sample_times.push_back(benchmark_verify_joinsplit(samplejoinsplit));
+        } else if (benchmarktype == "verifyblockjoinsplits") {
+            // one running time per number of verification threads, from 1 to the number of cores
+            int nJoinSplits = params[2].get_int();
+            std::vector<double> vals = benchmark_verify_joinsplits_threaded(nJoinSplits);
+            sample_times.insert(sample_times.end(), vals.begin(), vals.end());
+        } else if (benchmarktype == "checkqueue") {
+            // one running time per number of verification threads, from 1 to the number of cores
+            int nChecks = params[2].get_int();
+            std::vector<double> vals = benchmark_checkqueue_threaded(nChecks);
+            sample_times.insert(sample_times.end(), vals.begin(), vals.end());
 #ifdef ENABLE_MINING
         } else if (benchmarktype == "solveequihash") {
             if (params.size() < 3) {
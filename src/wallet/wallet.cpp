@@ -6,6 +6,7 @@
 #include "wallet/wallet.h"
 
 #include "base58.h"
+#include "blockcache.h"
 #include "checkpoints.h"
 #include "coincontrol.h"
 #include "consensus/validation.h"
@@ -724,10 +725,12 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
         }
 
         const CBlock* pblock {pblockIn};
-        CBlock block;
+        std::shared_ptr<const CBlock> pblockRead;
         if (!pblock) {
-            ReadBlockFromDisk(block, pindex);
-            pblock = &block;
+            pblockRead = GetCachedBlock(pindex);
+            if (!pblockRead)
+                pblockRead = std::make_shared<const CBlock>();
+            pblock = pblockRead.get();
         }
 
         for (const CTransaction& tx : pblock->vtx) {
@@ -3367,13 +3370,14 @@ bool CWallet::CreateTransaction(
                 // Sign
                 int nIn = 0;
                 CTransaction txNewConst(txNew);
+                PrecomputedTransactionData txdata(txNewConst);
                 for (const auto& coin : setCoins)
                 {
                     bool signSuccess;
                     const CScript& scriptPubKey = coin.first->getTxBase()->GetVout()[coin.second].scriptPubKey;
                     CScript& scriptSigRes = txNew.vin[nIn].scriptSig;
                     if (sign)
-                        signSuccess = ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, SIGHASH_ALL), scriptPubKey, scriptSigRes);
+                        signSuccess = ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, SIGHASH_ALL, &txdata), scriptPubKey, scriptSigRes);
                     else
                         signSuccess = ProduceSignature(DummySignatureCreator(this), scriptPubKey, scriptSigRes);
 
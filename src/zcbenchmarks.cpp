@@ -4,6 +4,7 @@
 #include <thread>
 #include <unistd.h>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 
 #include "coins.h"
 #include "util.h"
@@ -13,6 +14,7 @@
 #include "crypto/equihash.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "checkqueue.h"
 #include "consensus/validation.h"
 #include "main.h"
 #include "miner.h"
@@ -161,6 +163,108 @@ double benchmark_verify_joinsplit(const JSDescription &joinsplit)
     return timer_stop(tv_start);
 }
 
+std::vector<double> benchmark_verify_joinsplits_threaded(size_t nJoinSplits)
+{
+    // A block worth of valid joinsplits: the same one is verified nJoinSplits times
+    uint256 pubKeyHash;
+    uint256 anchor = ZCIncrementalMerkleTree().root();
+    JSDescription jsdesc(true,
+                         *pzcashParams,
+                         pubKeyHash,
+                         anchor,
+                         {JSInput(), JSInput()},
+                         {JSOutput(), JSOutput()},
+                         0,
+                         0);
+    auto verifier = libzcash::ProofVerifier::Strict();
+
+    // Verify them on a check queue as ConnectBlock does, with 1 up to nproc threads (master included)
+    std::vector<double> ret;
+    for (int nThreads = 1; nThreads <= GetNumCores(); nThreads++) {
+        CCheckQueue<CJoinSplitCheck> queue(1);
+        boost::thread_group workers;
+        for (int i = 0; i < nThreads - 1; i++)
+            workers.create_thread(boost::bind(&CCheckQueue<CJoinSplitCheck>::Thread, &queue));
+
+        std::vector<CJoinSplitCheck> vChecks;
+        for (size_t i = 0; i < nJoinSplits; i++)
+            vChecks.push_back(CJoinSplitCheck(jsdesc, pubKeyHash, verifier));
+
+        struct timeval tv_start;
+        timer_start(tv_start);
+        {
+            CCheckQueueControl<CJoinSplitCheck> control(&queue);
+            control.Add(vChecks);
+            assert(control.Wait());
+        }
+        ret.push_back(timer_stop(tv_start));
+
+        workers.interrupt_all();
+        workers.join_all();
+    }
+    return ret;
+}
+
+namespace {
+//! Verification of one signature, about the cost of a script check
+class CSignatureCheck
+{
+private:
+    const CPubKey* pubkey;
+    const uint256* hash;
+    const std::vector<unsigned char>* vchSig;
+
+public:
+    CSignatureCheck(): pubkey(NULL), hash(NULL), vchSig(NULL) {}
+    CSignatureCheck(const CPubKey& pubkeyIn, const uint256& hashIn, const std::vector<unsigned char>& vchSigIn):
+        pubkey(&pubkeyIn), hash(&hashIn), vchSig(&vchSigIn) {}
+
+    bool operator()() { return pubkey->Verify(*hash, *vchSig); }
+
+    void swap(CSignatureCheck& check) {
+        std::swap(pubkey, check.pubkey);
+        std::swap(hash, check.hash);
+        std::swap(vchSig, check.vchSig);
+    }
+};
+}
+
+std::vector<double> benchmark_checkqueue_threaded(size_t nChecks)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    uint256 hash = GetRandHash();
+    std::vector<unsigned char> vchSig;
+    assert(key.Sign(hash, vchSig));
+
+    // Queue the checks two at a time, as ConnectBlock does for small transactions,
+    // and run them with 1 up to nproc threads (master included)
+    std::vector<double> ret;
+    for (int nThreads = 1; nThreads <= GetNumCores(); nThreads++) {
+        CCheckQueue<CSignatureCheck> queue(128);
+        boost::thread_group workers;
+        for (int i = 0; i < nThreads - 1; i++)
+            workers.create_thread(boost::bind(&CCheckQueue<CSignatureCheck>::Thread, &queue));
+
+        struct timeval tv_start;
+        timer_start(tv_start);
+        {
+            CCheckQueueControl<CSignatureCheck> control(&queue);
+            for (size_t i = 0; i < nChecks; i += 2) {
+                std::vector<CSignatureCheck> vChecks(std::min<size_t>(2, nChecks - i), CSignatureCheck(pubkey, hash, vchSig));
+                control.Add(vChecks);
+            }
+            assert(control.Wait());
+        }
+        ret.push_back(timer_stop(tv_start));
+
+        workers.interrupt_all();
+        workers.join_all();
+    }
+    return ret;
+}
+
 #ifdef ENABLE_MINING
 double benchmark_solve_equihash()
 {
@@ -11,6 +11,8 @@ extern std::vector<double> benchmark_create_joinsplit_threaded(int nThreads);
 extern double benchmark_solve_equihash();
 extern std::vector<double> benchmark_solve_equihash_threaded(int nThreads);
 extern double benchmark_verify_joinsplit(const JSDescription &joinsplit);
+extern std::vector<double> benchmark_verify_joinsplits_threaded(size_t nJoinSplits);
+extern std::vector<double> benchmark_checkqueue_threaded(size_t nChecks);
 extern double benchmark_verify_equihash();
 extern double benchmark_large_tx();
 extern double benchmark_try_decrypt_notes(size_t nAddrs);
@@ -5,6 +5,8 @@
 #include <boost/beast/websocket.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
@@ -12,17 +14,22 @@
 #include <thread>
 #include <boost/thread.hpp>
 #include <boost/asio.hpp>
-#include <boost/lockfree/queue.hpp>
-#include <boost/lockfree/spsc_queue.hpp>
-#include <queue>
+#include <boost/asio/strand.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/make_shared.hpp>
+#include <deque>
+#include <memory>
+#include "websocket_server.h"
 #include "validationinterface.h"
 #include "main.h"
+#include "blockcache.h"
 #include "consensus/validation.h"
 #include <univalue.h>
 #include "uint256.h"
 
 extern UniValue send_certificate(const UniValue& params, bool fHelp);
 extern CAmount AmountFromValue(const UniValue& value);
+extern UniValue ValueFromAmount(const CAmount& amount);
 
 using tcp = boost::asio::ip::tcp;
 
@@ -30,23 +37,38 @@ namespace websocket = boost::beast::websocket;
 namespace http = boost::beast::http;
 
 namespace net = boost::asio;
-net::io_context ioc;
 
 static int MAX_BLOCKS_REQUEST = 100;
+static int MAX_SUBSCRIBED_SIDECHAINS = 100;
 static int tot_connections = 0;
+static int max_connections = DEFAULT_WS_MAX_CONNECTIONS;
+// seconds given to the clients to answer the close handshake at shutdown
+static int WS_CLOSE_TIMEOUT = 5;
 
 class WsNotificationInterface;
 class WsHandler;
+class WsListener;
 
 static int getblock(const CBlockIndex *pindex, std::string& blockHexStr);
 static void ws_updatetip(const CBlockIndex *pindex);
+static void ws_sendtip(int height, const uint256& hash, const CDiskBlockPos& pos);
 
 static boost::shared_ptr<WsNotificationInterface> wsNotificationInterface;
 static std::list< boost::shared_ptr<WsHandler> > listWsHandler;
 
-std::atomic<bool> exit_ws_thread{false};
-boost::thread ws_thread;
+// all the websocket i/o is multiplexed on this io_context, which is run by a fixed pool of threads
+static std::unique_ptr<net::io_context> ws_ioc;
+// the client requests and the tip updates, which wait on cs_main, the block files or the certificate
+// submission, are served by threads of their own, so that the i/o of the other sessions goes on meanwhile
+static std::unique_ptr<net::io_context> ws_req_ioc;
+static std::unique_ptr<net::executor_work_guard<net::io_context::executor_type> > ws_req_work;
+// tip updates are built off the validation thread, in order
+static std::unique_ptr<net::strand<net::io_context::executor_type> > ws_tip_strand;
+static boost::shared_ptr<WsListener> wsListener;
+static boost::thread_group ws_threads;
 std::mutex wsmtx;
+// notified when a connection is closed
+static std::condition_variable wscond;
 
 static void dumpUniValueError(const UniValue& error, std::string& outMsg)
 {
@@ -91,6 +113,7 @@ class WsEvent
 public:
     enum WsEventType {
         UPDATE_TIP = 0,
+        UPDATE_SC_TIP = 1,
         EVT_UNDEFINED = 0xff
     };
     enum WsRequestType {
@@ -98,6 +121,7 @@ public:
         GET_MULTIPLE_BLOCK_HASHES = 1,
         GET_NEW_BLOCK_HASHES = 2,
         SEND_CERTIFICATE = 3,
+        SUBSCRIBE_SIDECHAINS = 4,
         REQ_UNDEFINED = 0xff
     };
     
@@ -119,6 +143,9 @@ public:
     UniValue* getPayload() {
         return &payload;
     }
+    const UniValue* getPayload() const {
+        return &payload;
+    }
 
 private:
     WsMsgType type;
@@ -127,53 +154,51 @@ private:
 
 
 
-class WsHandler
+class WsHandler : public boost::enable_shared_from_this<WsHandler>
 {
 private:
-    boost::shared_ptr< websocket::stream<tcp::socket>> localWs;
-    boost::lockfree::queue<WsEvent*, boost::lockfree::capacity<1024>> wsq;
-    std::atomic<bool> exit_rwhandler_thread_flag { false };
-
-    void sendBlockEvent(int height, const std::string& strHash, const std::string& blockHex, WsEvent::WsEventType eventType)
+    websocket::stream<tcp::socket> localWs;
+    // every handler and every access to the members below is serialized on this strand
+    net::strand<net::io_context::executor_type> strand;
+    boost::beast::flat_buffer readBuffer;
+    std::deque<std::shared_ptr<const std::string> > writeQueue;
+    bool fAccepted = false;
+    bool fClosing = false;
+    // the server is stopping: the close handshake follows the write in progress, if any
+    bool fShutdown = false;
+
+    // the sidechains this client has subscribed to, if empty it receives the whole blocks.
+    // Written on the strand, read by the thread building the tip updates
+    std::mutex mtxScFilter;
+    std::set<uint256> scFilter;
+
+    void sendEvent(const WsEvent& wse)
     {
-        // Send a message to the client:  type = eventType
-        WsEvent* wse = new WsEvent(WsEvent::MSG_EVENT);
-        LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
-        UniValue rspPayload(UniValue::VOBJ);
-        rspPayload.push_back(Pair("height", height));
-        rspPayload.push_back(Pair("hash", strHash));
-        rspPayload.push_back(Pair("block", blockHex));
-
-        UniValue* rv = wse->getPayload();
-        rv->push_back(Pair("eventType", eventType));
-        rv->push_back(Pair("eventPayload", rspPayload));
-        wsq.push(wse);
+        send(std::make_shared<const std::string>(wse.getPayload()->write()));
     }
 
     void sendBlock(int height, const std::string& strHash, const std::string& blockHex,
             WsEvent::WsMsgType msgType, std::string clientRequestId = "")
     {
         // Send a message to the client:  type = eventType
-        WsEvent* wse = new WsEvent(msgType);
-        LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
+        WsEvent wse(msgType);
         UniValue rspPayload(UniValue::VOBJ);
         rspPayload.push_back(Pair("height", height));
         rspPayload.push_back(Pair("hash", strHash));
         rspPayload.push_back(Pair("block", blockHex));
 
-        UniValue* rv = wse->getPayload();
+        UniValue* rv = wse.getPayload();
         if (!clientRequestId.empty())
             rv->push_back(Pair("requestId", clientRequestId));
         rv->push_back(Pair("responsePayload", rspPayload));
-        wsq.push(wse);
+        sendEvent(wse);
     }
 
     void sendHashes(int height, std::list<CBlockIndex*>& listBlock,
             WsEvent::WsMsgType msgType, std::string clientRequestId = "")
     {
         // Send a message to the client:  type = eventType
-        WsEvent* wse = new WsEvent(msgType);
-        LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
+        WsEvent wse(msgType);
         UniValue rspPayload(UniValue::VOBJ);
         rspPayload.push_back(Pair("height", height));
 
@@ -186,27 +211,26 @@ private:
         }
         rspPayload.push_back(Pair("hashes", hashes));
 
-        UniValue* rv = wse->getPayload();
+        UniValue* rv = wse.getPayload();
         if (!clientRequestId.empty())
             rv->push_back(Pair("requestId", clientRequestId));
         rv->push_back(Pair("responsePayload", rspPayload));
-        wsq.push(wse);
+        sendEvent(wse);
     }
 
     void sendCertificateHash(const UniValue& retCert, WsEvent::WsMsgType msgType, std::string clientRequestId = "")
     {
         // Send a message to the client:  type = eventType
-        WsEvent* wse = new WsEvent(msgType);
-        LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
+        WsEvent wse(msgType);
         UniValue rspPayload(UniValue::VOBJ);
 
         rspPayload.push_back(Pair("certificateHash", retCert));
 
-        UniValue* rv = wse->getPayload();
+        UniValue* rv = wse.getPayload();
         if (!clientRequestId.empty())
             rv->push_back(Pair("requestId", clientRequestId));
         rv->push_back(Pair("responsePayload", rspPayload));
-        wsq.push(wse);
+        sendEvent(wse);
     }
 
     int getHashByHeight(std::string height, std::string& strHash)
@@ -402,6 +426,48 @@ private:
         return OK;
     }
 
+    int subscribeSidechains(const UniValue& scIds, const std::string& clientRequestId, std::string& outMsg)
+    {
+        if (scIds.size() > (size_t)MAX_SUBSCRIBED_SIDECHAINS)
+        {
+            outMsg = strprintf("too many scIds (max is %d)", MAX_SUBSCRIBED_SIDECHAINS);
+            LogPrint("ws", "%s():%d - %s\n", __func__, __LINE__, outMsg);
+            return INVALID_PARAMETER;
+        }
+
+        std::set<uint256> newFilter;
+        for (const UniValue& o : scIds.getValues())
+        {
+            if (!o.isStr() || o.get_str().size() != 64 || !IsHex(o.get_str()))
+            {
+                outMsg = "invalid scId: " + o.write();
+                LogPrint("ws", "%s():%d - %s\n", __func__, __LINE__, outMsg);
+                return INVALID_PARAMETER;
+            }
+            newFilter.insert(uint256S(o.get_str()));
+        }
+
+        UniValue subscribed(UniValue::VARR);
+        for (const uint256& scId : newFilter)
+            subscribed.push_back(scId.GetHex());
+
+        {
+            std::unique_lock<std::mutex> lck(mtxScFilter);
+            scFilter.swap(newFilter);
+        }
+        LogPrint("ws", "%s():%d - connection[%u] subscribed to %d sidechains\n", __func__, __LINE__, t_id, subscribed.size());
+
+        WsEvent wse(WsEvent::MSG_RESPONSE);
+        UniValue rspPayload(UniValue::VOBJ);
+        rspPayload.push_back(Pair("scIds", subscribed));
+
+        UniValue* rv = wse.getPayload();
+        rv->push_back(Pair("requestId", clientRequestId));
+        rv->push_back(Pair("responsePayload", rspPayload));
+        sendEvent(wse);
+        return OK;
+    }
+
     int sendCertificate(const UniValue& cmdParams, const std::string& clientRequestId, std::string& outMsg) {
         UniValue ret;
         try {
@@ -432,85 +498,188 @@ private:
         wsq->push(wse);
     }*/
 
-    void writeLoop()
+    void doWrite()
     {
-        localWs->text(localWs->got_text());
+        // the front element is kept in the queue, and thus alive, until the write completes
+        localWs.async_write(net::buffer(*writeQueue.front()),
+            net::bind_executor(strand,
+                boost::bind(&WsHandler::onWrite, shared_from_this(),
+                    net::placeholders::error, net::placeholders::bytes_transferred)));
+    }
 
-        while (!exit_rwhandler_thread_flag)
+    void onWrite(boost::beast::error_code ec, std::size_t bytes)
+    {
+        if (ec)
         {
-            if (!wsq.empty())
-            {
-                WsEvent* wse;
-                if (wsq.pop(wse) && wse != NULL)
-                {
-                    std::string msg = wse->getPayload()->write();
-                    LogPrint("ws", "%s():%d - deleting %p\n", __func__, __LINE__, wse);
-                    delete wse;
-                    if (localWs->is_open())
-                    {
-                        boost::beast::error_code ec;
-                        localWs->write(boost::asio::buffer(msg), ec);
-
-                        if (ec == websocket::error::closed)
-                        {
-                            LogPrint("ws", "%s():%d - err[%d]: %s\n", __func__, __LINE__,ec.value(), ec.message());
-                            break;
-                        }
-                        else
-                        if (ec.value() != boost::system::errc::success)
-                        {
-                            LogPrint("ws", "%s():%d - err[%d]: %s\n", __func__, __LINE__, ec.value(), ec.message());
-                            break;
-                        }
-                        LogPrint("ws", "%s():%d - msg[%s] written on client socket\n", __func__, __LINE__, msg);
-                    }
-                    else
-                    {
-                        LogPrint("ws", "%s():%d - ws is closed\n", __func__, __LINE__);
-                        break;
-                    }
-                }
-                else
-                {
-                    // should never happen because pop is false only when queue is empty
-                    LogPrint("ws", "%s():%d - could not pop!\n", __func__, __LINE__);
-                }
-            }
-            else
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            }
+            if (ec != net::error::operation_aborted)
+                LogPrint("ws", "%s():%d - err[%d]: %s\n", __func__, __LINE__, ec.value(), ec.message());
+            close();
+            return;
+        }
+        LogPrint("ws", "%s():%d - msg of size=%d written on client socket\n", __func__, __LINE__, bytes);
+
+        writeQueue.pop_front();
+        if (!writeQueue.empty())
+            doWrite();
+        else if (fShutdown)
+            doClose();
+    }
+
+    void onSend(const std::shared_ptr<const std::string>& msg)
+    {
+        if (fClosing || fShutdown)
+            return;
+
+        if (writeQueue.size() >= MAX_WS_WRITE_QUEUE)
+        {
+            // the client does not keep up with the events we are sending, drop it rather than buffering forever
+            LogPrint("ws", "%s():%d - connection[%u] write queue full (%d msgs), closing\n",
+                __func__, __LINE__, t_id, writeQueue.size());
+            close();
+            return;
+        }
+
+        writeQueue.push_back(msg);
+
+        // if a write is already in progress the new message will be chained by onWrite()
+        if (fAccepted && writeQueue.size() == 1)
+            doWrite();
+    }
+
+    void doRead()
+    {
+        localWs.async_read(readBuffer,
+            net::bind_executor(strand,
+                boost::bind(&WsHandler::onRead, shared_from_this(),
+                    net::placeholders::error, net::placeholders::bytes_transferred)));
+    }
+
+    void onRead(boost::beast::error_code ec, std::size_t bytes)
+    {
+        if (ec == websocket::error::closed || ec == websocket::error::no_connection)
+        {
+            // graceful disconnection
+            LogPrint("ws", "%s():%d - err[%d]: %s\n", __func__, __LINE__,ec.value(), ec.message());
+            close();
+            return;
+        }
+        else
+        if (ec)
+        {
+            // any other error but success
+            if (ec != net::error::operation_aborted)
+                LogPrint("ws", "%s():%d - connection is open[%s], err[%d]: %s\n", __func__, __LINE__,
+                    (localWs.is_open()?"Y":"N") , ec.value(), ec.message());
+            close();
+            return;
+        }
+        LogPrint("ws", "%s():%d - client message received of size=%d\n", __func__, __LINE__, bytes);
+
+        std::string msg = boost::beast::buffers_to_string(readBuffer.data());
+        readBuffer.consume(readBuffer.size());
+
+        // the next request is read once this one is answered, so they are served in order
+        net::post(*ws_req_ioc, boost::bind(&WsHandler::onRequest, shared_from_this(), msg));
+    }
+
+    // called on a request thread
+    void onRequest(const std::string& msg)
+    {
+        processClientMessage(msg);
+        net::post(strand, boost::bind(&WsHandler::onRequestDone, shared_from_this()));
+    }
+
+    void onRequestDone()
+    {
+        if (!fClosing && !fShutdown)
+            doRead();
+    }
+
+    void onAccept(boost::beast::error_code ec)
+    {
+        if (ec)
+        {
+            LogPrint("ws", "%s():%d - handshake failed on connection[%u], err[%d]: %s\n",
+                __func__, __LINE__, t_id, ec.value(), ec.message());
+            close();
+            return;
+        }
+
+        localWs.text(true);
+        fAccepted = true;
+
+        // flush whatever has been queued while the handshake was in progress
+        if (!writeQueue.empty())
+            doWrite();
+        doRead();
+    }
+
+    // must be called on the strand, once no write is in progress
+    void doClose()
+    {
+        localWs.async_close(websocket::close_reason(websocket::close_code::going_away),
+            net::bind_executor(strand,
+                boost::bind(&WsHandler::onClose, shared_from_this(), net::placeholders::error)));
+    }
+
+    void onClose(boost::beast::error_code ec)
+    {
+        if (ec && ec != net::error::operation_aborted)
+            LogPrint("ws", "%s():%d - close handshake failed on connection[%u], err[%d]: %s\n",
+                __func__, __LINE__, t_id, ec.value(), ec.message());
+        close();
+    }
+
+    void onShutdown()
+    {
+        if (fClosing || fShutdown)
+            return;
+        if (!fAccepted)
+        {
+            close();
+            return;
         }
-        LogPrint("ws", "%s():%d - write thread exit (this=%p)\n", __func__, __LINE__, this);
+        fShutdown = true;
+        // only the message being written, at the front, is still sent
+        if (writeQueue.size() > 1)
+            writeQueue.resize(1);
+        if (writeQueue.empty())
+            doClose();
     }
 
-    int parseClientMessage(WsEvent::WsRequestType& reqType, std::string& clientRequestId, std::string& outMsg) 
+    // must be called on the strand
+    void close()
+    {
+        if (fClosing)
+            return;
+        fClosing = true;
+        writeQueue.clear();
+
+        boost::system::error_code ec;
+        LogPrint("ws", "%s():%d - closing socket\n", __func__, __LINE__);
+        // any pending async operation completes with operation_aborted
+        localWs.next_layer().shutdown(tcp::socket::shutdown_both, ec);
+        localWs.next_layer().close(ec);
+
+        std::unique_lock<std::mutex> lck(wsmtx);
+        auto it = std::find(listWsHandler.begin(), listWsHandler.end(), shared_from_this());
+        if (it != listWsHandler.end())
+        {
+            LogPrint("ws", "%s():%d - removing handler obj from list\n", __func__, __LINE__);
+            listWsHandler.erase(it);
+            tot_connections--;
+            wscond.notify_all();
+        }
+        LogPrint("ws", "%s():%d - connection[%u] closed: tot[%d]\n", __func__, __LINE__, t_id, tot_connections);
+    }
+
+    int parseClientMessage(const std::string& msg, WsEvent::WsRequestType& reqType, std::string& clientRequestId, std::string& outMsg)
     {
         try
         {
             std::string msgType;
             std::string requestType;
-            boost::beast::multi_buffer buffer;
-            boost::beast::error_code ec;
 
-            localWs->read(buffer, ec);
-            if (ec == websocket::error::closed || ec == websocket::error::no_connection)
-            {
-                // graceful disconnection
-                LogPrint("ws", "%s():%d - err[%d]: %s\n", __func__, __LINE__,ec.value(), ec.message());
-                return READ_ERROR;
-            }
-            else
-            if (ec.value() != boost::system::errc::success)
-            {
-                // any other error but success
-                LogPrint("ws", "%s():%d - connection is open[%s], err[%d]: %s\n", __func__, __LINE__,
-                    (localWs->is_open()?"Y":"N") , ec.value(), ec.message());
-                return READ_ERROR;
-            }
-            LogPrint("ws", "%s():%d - client message received of size=%d\n", __func__, __LINE__, buffer.size());
-
-            std::string msg = boost::beast::buffers_to_string(buffer.data());
             UniValue request;
             if (!request.read(msg)) {
                 LogPrint("ws", "%s():%d - error parsing message from websocket: [%s]\n", __func__, __LINE__, msg);
@@ -730,6 +899,28 @@ private:
                 return sendCertificate(cmdParams, clientRequestId, outMsg);
             }
 
+            if (requestType == std::to_string(WsEvent::SUBSCRIBE_SIDECHAINS))
+            {
+                reqType = WsEvent::SUBSCRIBE_SIDECHAINS;
+                if (clientRequestId.empty()) {
+                    LogPrint("ws", "%s():%d - clientRequestId empty: msg[%s]\n", __func__, __LINE__, msg);
+                    return MISSING_REQID;
+                }
+                const UniValue& reqPayload = find_value(request, "requestPayload");
+                if (reqPayload.isNull() || !reqPayload.isObject()) {
+                    LogPrint("ws", "%s():%d - requestPayload invalid or missing: msg[%s]\n", __func__, __LINE__, msg);
+                    return INVALID_JSON_FORMAT;
+                }
+
+                // an empty array cancels the subscription, and whole blocks are sent again
+                const UniValue& scIdArray = find_value(reqPayload, "scIds");
+                if (!scIdArray.isArray()) {
+                    LogPrint("ws", "%s():%d - scIds missing: msg[%s]\n", __func__, __LINE__, msg);
+                    return MISSING_PARAMETER;
+                }
+                return subscribeSidechains(scIdArray, clientRequestId, outMsg);
+            }
+
             // if we are here that means it is no valid request type, and reqType is an enum defaulting to 255
             *((int*)(&reqType)) = std::stoi(requestType);
 
@@ -753,58 +944,54 @@ private:
         }
     }
 
-    void readLoop()
+    void processClientMessage(const std::string& msg)
     {
-        while (!exit_rwhandler_thread_flag)
+        WsEvent::WsRequestType reqType = WsEvent::REQ_UNDEFINED;
+        std::string clientRequestId = "";
+        std::string outMsg;
+        int res = parseClientMessage(msg, reqType, clientRequestId, outMsg);
+        if (res == READ_ERROR)
         {
-            WsEvent::WsRequestType reqType = WsEvent::REQ_UNDEFINED;
-            std::string clientRequestId = "";
-            std::string outMsg;
-            int res = parseClientMessage(reqType, clientRequestId, outMsg);
-            if (res == READ_ERROR)
-            {
-                LogPrint("ws", "%s():%d - websocket closed exit reading loop\n", __func__, __LINE__);
-                break;
-            }
+            LogPrint("ws", "%s():%d - read error, closing websocket\n", __func__, __LINE__);
+            net::post(strand, boost::bind(&WsHandler::close, shared_from_this()));
+            return;
+        }
 
-            if (res != OK)
+        if (res != OK)
+        {
+            std::string msgError = "On requestType[" + std::to_string(reqType) + "]: ";
+            switch (res)
             {
-                std::string msgError = "On requestType[" + std::to_string(reqType) + "]: ";
-                switch (res)
-                {
-                case INVALID_PARAMETER:
-                    msgError += "Invalid parameter";
-                    break;
-                case MISSING_PARAMETER:
-                    msgError += "Missing parameter";
-                    break;
-                case MISSING_REQID:
-                    msgError += "Missing requestId";
-                    break;
-                case INVALID_COMMAND:
-                    msgError += "Invalid command";
-                    break;
-                case INVALID_JSON_FORMAT:
-                    msgError += "Invalid JSON format";
-                    break;
-                default:
-                    msgError += "Generic error";
-                }
-                if (!outMsg.empty())
-                    msgError += " - Details: " + outMsg;
-
-                // Send a message error to the client:  type = -1
-                WsEvent* wse = new WsEvent(WsEvent::MSG_ERROR);
-                LogPrint("ws", "%s():%d - allocated %p\n", __func__, __LINE__, wse);
-                UniValue* rv = wse->getPayload();
-                if (!clientRequestId.empty())
-                    rv->push_back(Pair("requestId", clientRequestId));
-                rv->push_back(Pair("errorCode", res));
-                rv->push_back(Pair("message", msgError));
-                wsq.push(wse);
+            case INVALID_PARAMETER:
+                msgError += "Invalid parameter";
+                break;
+            case MISSING_PARAMETER:
+                msgError += "Missing parameter";
+                break;
+            case MISSING_REQID:
+                msgError += "Missing requestId";
+                break;
+            case INVALID_COMMAND:
+                msgError += "Invalid command";
+                break;
+            case INVALID_JSON_FORMAT:
+                msgError += "Invalid JSON format";
+                break;
+            default:
+                msgError += "Generic error";
             }
+            if (!outMsg.empty())
+                msgError += " - Details: " + outMsg;
+
+            // Send a message error to the client:  type = -1
+            WsEvent wse(WsEvent::MSG_ERROR);
+            UniValue* rv = wse.getPayload();
+            if (!clientRequestId.empty())
+                rv->push_back(Pair("requestId", clientRequestId));
+            rv->push_back(Pair("errorCode", res));
+            rv->push_back(Pair("message", msgError));
+            sendEvent(wse);
         }
-        LogPrint("ws", "%s():%d - exit reading loop\n", __func__, __LINE__);
     }
 
 public:
@@ -821,7 +1008,8 @@ public:
 
     unsigned int t_id = 0;
 
-    WsHandler() {}
+    WsHandler(tcp::socket socket, net::io_context& ioc, unsigned int t_id):
+        localWs(std::move(socket)), strand(ioc.get_executor()), t_id(t_id) {}
     ~WsHandler() {
         LogPrint("ws", "%s():%d - called this=%p\n", __func__, __LINE__, this);
     }
@@ -831,221 +1019,383 @@ public:
 
     static void getPeerIdentity(const tcp::socket& socket, std::string& id)
     { 
-        auto peer = socket.remote_endpoint();
+        boost::system::error_code ec;
+        auto peer = socket.remote_endpoint(ec);
         std::string addr = peer.address().to_string();
         std::string port = std::to_string(peer.port());
         id = addr + ":" + port;
     }
 
-    void do_session(tcp::socket& socket, unsigned int t_id)
+    void run()
     {
-        // will be referenced when shutting down in order not destroying ptr while executing this thread
-        boost::shared_ptr<WsHandler> thisRef;
-
-        this->t_id = t_id;
+        localWs.set_option(
+            websocket::stream_base::decorator(
+                [](websocket::response_type& res)
+                    {
+                        res.set(http::field::server,
+                        std::string(BOOST_BEAST_VERSION_STRING) + " Horizen-sidechain-connector");
+                    }));
 
-        try
-        {
-            localWs.reset(new websocket::stream<tcp::socket> { std::move(socket) });
-            LogPrint("ws", "%s():%d - allocated localWs %p\n", __func__, __LINE__, localWs.get());
-
-            localWs->set_option(
-                websocket::stream_base::decorator(
-                    [](websocket::response_type& res)
-                        {
-                            res.set(http::field::server,
-                            std::string(BOOST_BEAST_VERSION_STRING) + " Horizen-sidechain-connector");
-                        }));
-
-            localWs->control_callback(
-                [](websocket::frame_type kind, boost::string_view payload)
+        localWs.control_callback(
+            [](websocket::frame_type kind, boost::string_view payload)
+            {
+                if (kind == websocket::frame_type::ping)
                 {
-                    if (kind == websocket::frame_type::ping)
-                    {
-                        std::string payl(payload);
-                        LogPrint("ws", "%s():%d - ping received... payload[%s]\n", __func__, __LINE__, payl);
-                    }
-                    // Do something with the payload
-                    boost::ignore_unused(kind, payload);
-                });
+                    std::string payl(payload);
+                    LogPrint("ws", "%s():%d - ping received... payload[%s]\n", __func__, __LINE__, payl);
+                }
+                // Do something with the payload
+                boost::ignore_unused(kind, payload);
+            });
 
-            localWs->accept();
+        localWs.async_accept(
+            net::bind_executor(strand,
+                boost::bind(&WsHandler::onAccept, shared_from_this(), net::placeholders::error)));
+    }
 
-            std::thread write_t(&WsHandler::writeLoop, this);
-            readLoop();
-            exit_rwhandler_thread_flag = true;
-            write_t.join();
-            socket.close();
-        }
-        catch (boost::system::system_error const& se)
+    /** Queue a message for this client, thread safe. The writer is woken up immediately. */
+    void send(const std::shared_ptr<const std::string>& msg)
+    {
+        net::post(strand, boost::bind(&WsHandler::onSend, shared_from_this(), msg));
+    }
+
+    std::set<uint256> getScFilter()
+    {
+        std::unique_lock<std::mutex> lck(mtxScFilter);
+        return scFilter;
+    }
+
+    /** Close the connection with a close handshake, thread safe */
+    void shutdown()
+    {
+        net::post(strand, boost::bind(&WsHandler::onShutdown, shared_from_this()));
+    }
+};
+
+
+class WsListener : public boost::enable_shared_from_this<WsListener>
+{
+private:
+    net::io_context& ioc;
+    tcp::acceptor acceptor;
+    tcp::socket socket;
+    unsigned int t_id = 0;
+
+    void doAccept()
+    {
+        acceptor.async_accept(socket,
+            boost::bind(&WsListener::onAccept, shared_from_this(), net::placeholders::error));
+    }
+
+    void onAccept(boost::system::error_code ec)
+    {
+        if (ec == net::error::operation_aborted)
         {
-            if (se.code() != websocket::error::closed)
-            {
-                LogPrint("ws", "%s():%d - boost error %s\n", __func__, __LINE__, se.code().message());
-            }
-            LogPrint("ws", "%s():%d - websocket close\n", __func__, __LINE__);
+            LogPrint("ws", "%s():%d - websocket service stop\n", __func__, __LINE__);
+            return;
         }
-        catch (std::exception const& e)
+
+        if (ec)
         {
-            LogPrint("ws", "%s():%d - error: %s\n", __func__, __LINE__, std::string(e.what()));
+            LogPrint("ws", "%s():%d - accept error[%d]: %s\n", __func__, __LINE__, ec.value(), ec.message());
         }
-        LogPrint("ws", "%s():%d - exit thread final\n", __func__, __LINE__);
+        else
         {
-            std::unique_lock<std::mutex> lck(wsmtx);
-            this->shutdown();
-            tot_connections--;
-            LogPrint("ws", "%s():%d - connection[%u] closed: tot[%d]\n", __func__, __LINE__, t_id, tot_connections);
+            std::string peerId;
+            WsHandler::getPeerIdentity(socket, peerId);
 
-            auto it = listWsHandler.begin();
-            while (it != listWsHandler.end())
+            std::unique_lock<std::mutex> lck(wsmtx);
+            if (tot_connections >= max_connections)
             {
-                if (this == (*it).get() )
-                {
-                    thisRef = (*it);
-                    LogPrint("ws", "%s():%d - removing handler obj from list\n", __func__, __LINE__);
-                    listWsHandler.erase(it++);
-                }
-                else
-                {
-                    ++it;
-                }
+                LogPrint("ws", "%s():%d - connection limit reached (%d), rejecting connection from %s\n",
+                    __func__, __LINE__, max_connections, peerId);
+                boost::system::error_code ignored;
+                socket.close(ignored);
+            }
+            else
+            {
+                boost::shared_ptr<WsHandler> w(new WsHandler(std::move(socket), ioc, t_id));
+                LogPrint("ws", "%s():%d - allocated ws handler %p\n", __func__, __LINE__, w.get());
+                listWsHandler.push_back(w);
+                tot_connections++;
+                w->run();
+
+                LogPrint("ws", "%s():%d - new connection[%u] received from %s: tot[%d]\n",
+                    __func__, __LINE__, t_id, peerId, tot_connections);
+                t_id++;
             }
         }
+        doAccept();
     }
 
-    void send_tip_update(int height, const std::string& strHash, const std::string& blockHex)
+public:
+    WsListener(net::io_context& ioc, const tcp::endpoint& endpoint):
+        ioc(ioc), acceptor(ioc), socket(ioc)
     {
-        sendBlockEvent(height, strHash, blockHex, WsEvent::UPDATE_TIP);
+        acceptor.open(endpoint.protocol());
+        acceptor.set_option(net::socket_base::reuse_address(true));
+        acceptor.bind(endpoint);
+        acceptor.listen(net::socket_base::max_listen_connections);
     }
 
-    void shutdown()
+    void run()
     {
-        try
-        {
-            exit_rwhandler_thread_flag = true;
-            if (this->localWs)
-            {
-                LogPrint("ws", "%s():%d - closing socket\n", __func__, __LINE__);
-                this->localWs->next_layer().close();
-            }
-        }
-        catch (std::exception const& e)
-        {
-            LogPrint("ws", "%s():%d - error: %s\n", __func__, __LINE__, e.what());
-        }
+        LogPrint("ws", "%s():%d - waiting for new connections\n", __func__, __LINE__);
+        doAccept();
+    }
+
+    void stop()
+    {
+        net::post(ioc, boost::bind(&WsListener::doStop, shared_from_this()));
+    }
+
+    void doStop()
+    {
+        boost::system::error_code ec;
+        acceptor.close(ec);
     }
 };
 
 
 static int getblock(const CBlockIndex *pindex, std::string& strHex)
 {
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if (!ReadBlockFromDisk(block, pindex)) {
-            LogPrint("ws", "%s():%d - error: could not read block from disk\n", __func__, __LINE__);
-            return WsHandler::READ_ERROR;
-        }
-        ss << block;
-        strHex = HexStr(ss.begin(), ss.end());
+    std::shared_ptr<const CBlock> pblock = GetCachedBlock(pindex);
+    if (!pblock) {
+        LogPrint("ws", "%s():%d - error: could not read block from disk\n", __func__, __LINE__);
+        return WsHandler::READ_ERROR;
     }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << *pblock;
+    strHex = HexStr(ss.begin(), ss.end());
     return WsHandler::OK;
 }
 
+/**
+ * Build the UPDATE_TIP event frame. The block is hex encoded straight into the frame, which is
+ * byte for byte what WsEvent would produce, so that the (possibly large) payload is neither copied
+ * into a UniValue nor serialized again for every client.
+ */
+static std::shared_ptr<const std::string> buildTipFrame(const CBlock& block, int height, const uint256& hash)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
 
+    const std::string prefix = strprintf("{\"msgType\":%d,\"eventType\":%d,\"eventPayload\":{\"height\":%d,\"hash\":\"%s\",\"block\":\"",
+        WsEvent::MSG_EVENT, WsEvent::UPDATE_TIP, height, hash.GetHex());
+    const std::string suffix = "\"}}";
 
-
-static void ws_updatetip(const CBlockIndex *pindex)
-{
-    std::string strHex;
-    int ret = getblock(pindex, strHex);
-    if (ret != WsHandler::OK)
+    static const char hexmap[] = "0123456789abcdef";
+    std::shared_ptr<std::string> frame = std::make_shared<std::string>();
+    frame->reserve(prefix.size() + 2 * ss.size() + suffix.size());
+    frame->append(prefix);
+    for (CDataStream::const_iterator it = ss.begin(); it != ss.end(); ++it)
     {
-        // should not happen
-        LogPrint("ws", "%s():%d - ERROR: can not update tip\n", __func__, __LINE__);
-        return;
+        unsigned char c = (unsigned char)*it;
+        frame->push_back(hexmap[c >> 4]);
+        frame->push_back(hexmap[c & 15]);
     }
+    frame->append(suffix);
+    return frame;
+}
+
+template <typename T>
+static std::string serializeToHex(const T& obj)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << obj;
+    return HexStr(ss.begin(), ss.end());
+}
+
+template <typename T>
+static UniValue crosschainOutputToUniValue(const T& ccout, const uint256& txHash, unsigned int n)
+{
+    UniValue o(UniValue::VOBJ);
+    o.push_back(Pair("txid", txHash.GetHex()));
+    o.push_back(Pair("n", (int)n));
+    o.push_back(Pair("amount", ValueFromAmount(ccout.nValue)));
+    o.push_back(Pair("address", ccout.address.GetHex()));
+    o.push_back(Pair("hex", serializeToHex(ccout)));
+    return o;
+}
+
+/**
+ * Build the UPDATE_SC_TIP event frame for clients subscribed to the given sidechains: the block header
+ * and, for each of the sidechains the block contains something for, its crosschain outputs, its
+ * certificate and the merkle path of its leaf up to the hashScTxsCommitment of the header.
+ * The crosschain outputs are listed with the index n used for their leaf, so that the ft hash can be
+ * recomputed as well.
+ */
+static std::shared_ptr<const std::string> buildScTipFrame(const CBlock& block, const SidechainTxsCommitmentBuilder& scCommitmentBuilder,
+    int height, const uint256& hash, const std::set<uint256>& scIds)
+{
+    UniValue sidechains(UniValue::VARR);
+    for (const uint256& scId : scIds)
     {
-        std::unique_lock<std::mutex> lck(wsmtx);
-        if (listWsHandler.size() )
+        uint256 ftHash, btrHash, wCertHash;
+        int nLeafIndex = -1;
+        std::vector<uint256> vMerkleBranch;
+        if (!scCommitmentBuilder.getScMerklePath(scId, ftHash, btrHash, wCertHash, nLeafIndex, vMerkleBranch))
+            continue;
+
+        UniValue creations(UniValue::VARR);
+        UniValue fwdTransfers(UniValue::VARR);
+        for (const CTransaction& tx : block.vtx)
         {
-            LogPrint("ws", "%s():%d - update tip loop on ws clients\n", __func__, __LINE__);
-            auto it = listWsHandler.begin();
-            while (it != listWsHandler.end())
+            if (!tx.IsScVersion())
+                continue;
+
+            // same indexing as in CTransaction::fillCrosschainOutput()
+            unsigned int n = 0;
+            for (const CTxScCreationOut& ccout : tx.GetVscCcOut())
+            {
+                if (ccout.GetScId() == scId)
+                    creations.push_back(crosschainOutputToUniValue(ccout, tx.GetHash(), n));
+                n++;
+            }
+            for (const CTxForwardTransferOut& ccout : tx.GetVftCcOut())
             {
-                LogPrint("ws", "%s():%d - call wshandler_send_tip_update to connection[%u]\n", __func__, __LINE__, (*it)->t_id);
-                (*it)->send_tip_update(pindex->nHeight, pindex->GetBlockHash().GetHex(), strHex);
-                ++it;
+                if (ccout.GetScId() == scId)
+                    fwdTransfers.push_back(crosschainOutputToUniValue(ccout, tx.GetHash(), n));
+                n++;
             }
         }
-        else
+
+        UniValue certs(UniValue::VARR);
+        for (const CScCertificate& cert : block.vcert)
         {
-            LogPrint("ws", "%s():%d - there are no connected ws clients\n", __func__, __LINE__);
+            if (cert.GetScId() == scId)
+                certs.push_back(serializeToHex(cert));
         }
-    }
-}
 
+        UniValue branch(UniValue::VARR);
+        for (const uint256& h : vMerkleBranch)
+            branch.push_back(h.GetHex());
+
+        UniValue merklePath(UniValue::VOBJ);
+        merklePath.push_back(Pair("ftHash", ftHash.GetHex()));
+        merklePath.push_back(Pair("btrHash", btrHash.GetHex()));
+        merklePath.push_back(Pair("certHash", wCertHash.GetHex()));
+        merklePath.push_back(Pair("leafIndex", nLeafIndex));
+        merklePath.push_back(Pair("branch", branch));
+
+        UniValue sc(UniValue::VOBJ);
+        sc.push_back(Pair("scid", scId.GetHex()));
+        sc.push_back(Pair("scCreations", creations));
+        sc.push_back(Pair("forwardTransfers", fwdTransfers));
+        sc.push_back(Pair("certificates", certs));
+        sc.push_back(Pair("merklePath", merklePath));
+        sidechains.push_back(sc);
+    }
 
-//------------------------------------------------------------------------------
+    UniValue evtPayload(UniValue::VOBJ);
+    evtPayload.push_back(Pair("height", height));
+    evtPayload.push_back(Pair("hash", hash.GetHex()));
+    evtPayload.push_back(Pair("header", serializeToHex(block.GetBlockHeader())));
+    evtPayload.push_back(Pair("sidechains", sidechains));
+
+    WsEvent wse(WsEvent::MSG_EVENT);
+    UniValue* rv = wse.getPayload();
+    rv->push_back(Pair("eventType", WsEvent::UPDATE_SC_TIP));
+    rv->push_back(Pair("eventPayload", evtPayload));
+    return std::make_shared<const std::string>(rv->write());
+}
 
-static tcp::acceptor* acceptor = NULL;
-void ws_main(std::string strAddressWs, int portWs)
+static void ws_sendtip(int height, const uint256& hash, const CDiskBlockPos& pos)
 {
-    std::string peerId;
+    // clients are grouped by subscription, every group shares the same frame
+    std::map<std::set<uint256>, std::vector<boost::shared_ptr<WsHandler> > > mapClients;
+    {
+        std::unique_lock<std::mutex> lck(wsmtx);
+        for (const boost::shared_ptr<WsHandler>& w : listWsHandler)
+            mapClients[w->getScFilter()].push_back(w);
+    }
+    if (mapClients.empty())
+        return;
 
-    try {
-        LogPrint("ws", "start websocket service address: %s \n", strAddressWs);
-        LogPrint("ws", "start websocket service port: %s \n", portWs);
+    std::shared_ptr<const CBlock> pblock = GetCachedBlock(hash, pos);
+    if (!pblock)
+    {
+        // should not happen
+        LogPrint("ws", "%s():%d - ERROR: can not update tip, could not read block from disk\n", __func__, __LINE__);
+        return;
+    }
+    const CBlock& block = *pblock;
 
-        auto const address = boost::asio::ip::make_address(strAddressWs);
-        auto const port = static_cast<unsigned short>(portWs);
+    SidechainTxsCommitmentBuilder scCommitmentBuilder;
+    if (mapClients.size() > 1 || !mapClients.begin()->first.empty())
+    {
+        for (const CTransaction& tx : block.vtx)
+            scCommitmentBuilder.add(tx);
+        for (const CScCertificate& cert : block.vcert)
+            scCommitmentBuilder.add(cert);
+    }
 
-        net::io_context ioc { 1 };
-        tcp::acceptor _acceptor = tcp::acceptor { ioc, { address, port } };
-        acceptor = &_acceptor;
-        LogPrint("ws", "%s():%d - assigned %p\n", __func__, __LINE__, acceptor);
-        unsigned int t_id = 0;
+    for (const auto& entry : mapClients)
+    {
+        std::shared_ptr<const std::string> frame = entry.first.empty() ?
+            buildTipFrame(block, height, hash) :
+            buildScTipFrame(block, scCommitmentBuilder, height, hash, entry.first);
 
-        while (!exit_ws_thread)
+        LogPrint("ws", "%s():%d - update tip loop on %d ws clients (%d sidechains filter)\n",
+            __func__, __LINE__, entry.second.size(), entry.first.size());
+        for (const boost::shared_ptr<WsHandler>& w : entry.second)
         {
-            tcp::socket socket { ioc };
+            LogPrint("ws", "%s():%d - sending tip update to connection[%u]\n", __func__, __LINE__, w->t_id);
+            w->send(frame);
+        }
+    }
+}
 
-            // TODO //  - possible DoS, limit number of connections
-            LogPrint("ws", "%s():%d - waiting to get a new connection\n", __func__, __LINE__);
-            acceptor->accept(socket);
-            WsHandler::getPeerIdentity(socket, peerId);
+static void ws_updatetip(const CBlockIndex *pindex)
+{
+    {
+        std::unique_lock<std::mutex> lck(wsmtx);
+        if (listWsHandler.empty() || !ws_tip_strand)
+        {
+            LogPrint("ws", "%s():%d - there are no connected ws clients\n", __func__, __LINE__);
+            return;
+        }
+    }
 
-            boost::shared_ptr<WsHandler> w(new WsHandler());
-            LogPrint("ws", "%s():%d - allocated ws handler %p\n", __func__, __LINE__, w.get());
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        pos = pindex->GetBlockPos();
+    }
+    int height = pindex->nHeight;
+    uint256 hash = pindex->GetBlockHash();
 
-            std::thread { std::bind(&WsHandler::do_session, w.get(),
-                    std::move(socket), t_id) }.detach();
-            {
-                std::unique_lock<std::mutex> lck(wsmtx);
-                listWsHandler.push_back(w);
-                tot_connections++;
-            }
-            t_id++;
+    // reading and encoding the block is left to the websocket threads, not to the validation one
+    std::unique_lock<std::mutex> lck(wsmtx);
+    if (ws_tip_strand)
+        net::post(*ws_tip_strand, boost::bind(&ws_sendtip, height, hash, pos));
+}
 
-            LogPrint("ws", "%s():%d - new connection[%u] received from %s: tot[%d]\n",
-                __func__, __LINE__, t_id, peerId, tot_connections);
-        }
+
+//------------------------------------------------------------------------------
+
+static void ws_thread_main(net::io_context* ioc, const char* name)
+{
+    RenameThread(name);
+    try
+    {
+        ioc->run();
     }
     catch (const std::exception& e)
     {
         LogPrint("ws", "%s():%d - error: %s\n", __func__, __LINE__, std::string(e.what()));
     }
-    LogPrint("ws", "%s():%d - websocket service stop\n", __func__, __LINE__);
+    LogPrint("ws", "%s():%d - websocket thread exit\n", __func__, __LINE__);
 }
 
 static void shutdown()
 {
+    std::unique_lock<std::mutex> lck(wsmtx);
     if (listWsHandler.size() != 0)
     {
         // list objects are smart_ptrs and will clean up when they go out of scope
-        LogPrint("ws", "%s():%d - shutdown %d threads/sockets thread... \n", __func__, __LINE__, listWsHandler.size());
-        std::unique_lock<std::mutex> lck(wsmtx);
+        LogPrint("ws", "%s():%d - shutdown %d sockets... \n", __func__, __LINE__, listWsHandler.size());
         auto it = listWsHandler.begin();
         while (it != listWsHandler.end())
         {
@@ -1064,9 +1414,27 @@ bool StartWsServer()
         //std::string strAddress = GetArg("-wsaddress", "127.0.0.1");
         std::string strAddress = "127.0.0.1";
         int port = GetArg("-wsport", 8888);
-
-        ws_thread = boost::thread(ws_main, strAddress, port);
-        ws_thread.detach();
+        int nThreads = std::max((int)GetArg("-wsthreads", DEFAULT_WS_THREADS), 1);
+        max_connections = std::max((int)GetArg("-wsmaxconnections", DEFAULT_WS_MAX_CONNECTIONS), 1);
+
+        LogPrint("ws", "start websocket service address: %s \n", strAddress);
+        LogPrint("ws", "start websocket service port: %s \n", port);
+
+        auto const address = boost::asio::ip::make_address(strAddress);
+        ws_ioc.reset(new net::io_context(nThreads));
+        ws_req_ioc.reset(new net::io_context(nThreads));
+        ws_req_work.reset(new net::executor_work_guard<net::io_context::executor_type>(ws_req_ioc->get_executor()));
+        ws_tip_strand.reset(new net::strand<net::io_context::executor_type>(ws_req_ioc->get_executor()));
+        wsListener.reset(new WsListener(*ws_ioc, tcp::endpoint(address, static_cast<unsigned short>(port))));
+        wsListener->run();
+
+        LogPrint("ws", "%s():%d - starting %d websocket threads, max %d connections\n",
+            __func__, __LINE__, nThreads, max_connections);
+        for (int i = 0; i < nThreads; i++)
+        {
+            ws_threads.create_thread(boost::bind(&ws_thread_main, ws_ioc.get(), "horizen-ws"));
+            ws_threads.create_thread(boost::bind(&ws_thread_main, ws_req_ioc.get(), "horizen-wsreq"));
+        }
 
         wsNotificationInterface.reset(new WsNotificationInterface());
         LogPrint("ws", "%s():%d - starting server at %s:%d, allocated notif if %p\n",
@@ -1075,7 +1443,12 @@ bool StartWsServer()
     }
     catch (const std::exception& e)
     {
-        LogPrint("ws", "%s():%d - error: %s\n", __func__, __LINE__, std::string(e.what()));
+        LogPrintf("%s():%d - error: could not start websocket server: %s\n", __func__, __LINE__, std::string(e.what()));
+        wsListener.reset();
+        ws_tip_strand.reset();
+        ws_req_work.reset();
+        ws_req_ioc.reset();
+        ws_ioc.reset();
         return false;
     }
     return true;
@@ -1085,18 +1458,42 @@ bool StopWsServer()
 {
     try
     {
-        shutdown();
-        exit_ws_thread = true;
-        if (acceptor != NULL)
-        {
-            LogPrint("ws", "%s():%d - closing static acceptor %p\n", __func__, __LINE__, acceptor);
-            acceptor->close();
-            acceptor = NULL;
-        }
         if (wsNotificationInterface.get() != NULL)
         {
             UnregisterValidationInterface(wsNotificationInterface.get());
         }
+        if (ws_ioc)
+        {
+            if (wsListener)
+                wsListener->stop();
+            shutdown();
+
+            // let the close handshakes complete before stopping the i/o
+            {
+                std::unique_lock<std::mutex> lck(wsmtx);
+                if (!wscond.wait_for(lck, std::chrono::seconds(WS_CLOSE_TIMEOUT), []{ return listWsHandler.empty(); }))
+                    LogPrint("ws", "%s():%d - %d connections not closed in time, dropping them\n",
+                        __func__, __LINE__, listWsHandler.size());
+            }
+
+            // handlers still pending are destroyed along with the io_contexts, releasing their connections
+            ws_req_work.reset();
+            ws_req_ioc->stop();
+            ws_ioc->stop();
+            LogPrint("ws", "%s():%d - waiting for websocket threads to exit\n", __func__, __LINE__);
+            ws_threads.join_all();
+
+            {
+                std::unique_lock<std::mutex> lck(wsmtx);
+                listWsHandler.clear();
+                tot_connections = 0;
+                ws_tip_strand.reset();
+            }
+            wsListener.reset();
+            // the requests still queued hold handlers whose sockets belong to ws_ioc
+            ws_req_ioc.reset();
+            ws_ioc.reset();
+        }
     }
     catch (const std::exception& e)
     {
@@ -1105,6 +1502,3 @@ bool StopWsServer()
     }
     return true;
 }
-
-
-
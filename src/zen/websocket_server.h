@@ -9,11 +9,20 @@
 
 //------------------------------------------------------------------------------
 //
-// Example: WebSocket server, synchronous
+// Example: WebSocket server, asynchronous
 //
 //------------------------------------------------------------------------------
 
 
 
+#include <cstddef>
+
+/** Default number of threads serving the websocket io_context */
+static const int DEFAULT_WS_THREADS = 4;
+/** Default maximum number of simultaneous websocket clients */
+static const int DEFAULT_WS_MAX_CONNECTIONS = 256;
+/** Maximum number of messages queued for a client before it is disconnected */
+static const size_t MAX_WS_WRITE_QUEUE = 1024;
+
 bool StartWsServer();
 bool StopWsServer();